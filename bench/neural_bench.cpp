@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////
+// Throughput of z::CNeuralBridge in samples per second: LEARN collection with and without a
+// reserved training matrix, CSV parsing of a TRAIN blob, and batched against single prediction.
+// Standalone program; it needs no host, the bar number is set in a local GLOBALS.
+//
+//   cl /O2 /EHsc /std:c++17 /I..\include neural_bench.cpp
+//   g++ -O2 -std=c++14 -pthread -I../include neural_bench.cpp
+//   neural_bench 200000                                  // number of samples, default 100000
+///////////////////////////////////////////////////////
+
+#include "zorro.h"
+#include "zorro/neural.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+
+namespace
+{
+enum { Signals = 8, BatchRows = 500, BatchBars = 2000, Singles = 200000 };
+
+GLOBALS s_globals;
+
+double seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const char* name, double samples, double sec)
+{
+	printf("%-24s %8.2f M samples/s\n", name, samples/sec/1e6);
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	const int samples = argc > 1 ? atoi(argv[1]) : 100000;
+	g = &s_globals;
+	g->nBar = 1;
+
+	// signals and objective, f.i. sin(s0) + s1*s2/2
+	std::mt19937 rng(5);
+	std::normal_distribution<double> normal;
+	std::vector<double> data(static_cast<size_t>(samples)*(Signals + 1));
+	std::string csv;
+	for (int i = 0; i < samples; i++) {
+		double* s = &data[static_cast<size_t>(i)*(Signals + 1)];
+		for (int k = 0; k < Signals; k++) s[k] = normal(rng);
+		s[Signals] = sin(s[0]) + 0.5*s[1]*s[2];
+		char line[512];
+		int n = 0;
+		for (int k = 0; k <= Signals; k++) n += sprintf(line + n, k ? ",%g" : "%g", s[k]);
+		csv += line;
+		csv += '\n';
+	}
+
+	z::CMlpBackend Mlp(16);
+	{
+		z::CNeuralBridge Bridge(Mlp, 512, Signals);
+		std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+		for (int i = 0; i < samples; i++) Bridge.neural(ENeuralMode::LEARN, 0, Signals, &data[static_cast<size_t>(i)*(Signals + 1)]);
+		report("learn", samples, seconds(t));
+	}
+	{
+		z::CNeuralBridge Bridge(Mlp, 512, Signals);
+		Bridge.reserve(0, samples, Signals);
+		std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+		for (int i = 0; i < samples; i++) Bridge.neural(ENeuralMode::LEARN, 0, Signals, &data[static_cast<size_t>(i)*(Signals + 1)]);
+		report("learn, reserved", samples, seconds(t));
+	}
+
+	z::CNeuralBridge Bridge(Mlp, 512, Signals);
+	std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+	Bridge.neural(ENeuralMode::TRAIN, 0, Signals, csv.c_str());
+	const double sec = seconds(t);
+	if (Bridge.samples(0) != samples) {
+		printf("parsed %d of %d samples\n", Bridge.samples(0), samples);
+		return 1;
+	}
+	report("parse and train", samples, sec);
+
+	// all assets of a bar in one batch, against one PREDICT call per asset
+	t = std::chrono::steady_clock::now();
+	for (int bar = 0; bar < BatchBars; bar++) {
+		g->nBar = 10 + bar;
+		for (int a = 0; a < BatchRows; a++) {
+			float* row = Bridge.queue(0, Signals);
+			const double* s = &data[static_cast<size_t>(a % samples)*(Signals + 1)];
+			for (int k = 0; k < Signals; k++) row[k] = static_cast<float>(s[k]);
+		}
+		Bridge.flush();
+	}
+	report("batched predict", static_cast<double>(BatchBars)*BatchRows, seconds(t));
+
+	volatile double sum = 0;
+	t = std::chrono::steady_clock::now();
+	for (int i = 0; i < Singles; i++) {
+		g->nBar = 100000 + i;
+		sum += Bridge.predict(0, &data[static_cast<size_t>(i % samples)*(Signals + 1)], Signals);
+	}
+	report("single predict", Singles, seconds(t));
+	return 0;
+}
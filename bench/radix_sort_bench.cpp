@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////
+// z::radixSort() and z::radixSortIdx() against std::sort and std::stable_sort, in nanoseconds per
+// element, for prices in a narrow range like a sortData() call on a price series. The parallel
+// sort is measured separately on arrays above its threshold with the given number of pool threads.
+// Standalone program; it needs no host.
+//
+//   cl /O2 /EHsc /std:c++17 /I..\include radix_sort_bench.cpp
+//   g++ -O2 -std=c++14 -pthread -I../include radix_sort_bench.cpp
+//   radix_sort_bench 4                                   // pool threads, default: the pool default
+///////////////////////////////////////////////////////
+
+#include "zorro.h"
+#include "zorro/radix_sort.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <chrono>
+
+namespace
+{
+enum { Elements = 20000000 };
+
+GLOBALS s_globals;
+
+double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	g = &s_globals;
+	if (argc > 1) z::threadPool().resize(atoi(argv[1]));
+	std::mt19937_64 rng(7);
+	std::normal_distribution<double> normal;
+
+	printf("%9s %12s %12s %14s %12s\n", "n", "std::sort", "radixSort", "stable_sort", "radixSortIdx");
+	const int sizes[] = { 16, 100, 1000, 10000, 100000, 1000000 };
+	for (size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++) {
+		const int n = sizes[s];
+		std::vector<var> data(n), work(n);
+		for (int i = 0; i < n; i++) data[i] = 1.1 + 0.01*normal(rng);
+		std::vector<int> index(n);
+		const int reps = Elements/n;
+		double tSort = 0, tRadix = 0, tStable = 0, tRadixIdx = 0;
+		for (int k = 0; k < reps; k++) {
+			work = data;
+			double t0 = now();
+			std::sort(work.begin(), work.end());
+			tSort += now() - t0;
+
+			work = data;
+			t0 = now();
+			z::radixSort(&work[0], n, false);
+			tRadix += now() - t0;
+
+			for (int i = 0; i < n; i++) index[i] = i;
+			t0 = now();
+			std::stable_sort(index.begin(), index.end(), [&data](int a, int b) { return data[a] < data[b]; });
+			tStable += now() - t0;
+
+			t0 = now();
+			z::radixSortIdx(&data[0], n, &index[0], false);
+			tRadixIdx += now() - t0;
+		}
+		const double scale = 1e9/reps/n;
+		printf("%9d %12.2f %12.2f %14.2f %12.2f\n", n, tSort*scale, tRadix*scale, tStable*scale, tRadixIdx*scale);
+	}
+
+	// parallel histograms and scatters
+	const int n = 4000000;
+	std::vector<var> data(n), work(n);
+	for (int i = 0; i < n; i++) data[i] = 1.1 + 0.01*normal(rng);
+	double tSerial = 0, tParallel = 0;
+	for (int k = 0; k < 5; k++) {
+		work = data;
+		double t0 = now();
+		z::radixSort(&work[0], n, false);
+		tSerial += now() - t0;
+		work = data;
+		t0 = now();
+		z::radixSort(&work[0], n, true);
+		tParallel += now() - t0;
+	}
+	printf("%9d serial %.2f ns/element, parallel %.2f ns/element with %d pool threads\n", n, tSerial*1e9/5/n, tParallel*1e9/5/n, z::threadPool().size());
+	return 0;
+}
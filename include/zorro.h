@@ -38,6 +38,7 @@ ZORRO_DEFINE_GLOBAL_A(GLOBALS*, g, =0)
 
 #ifdef ZORRO_CPP
 #include "zorro/litec/default.h"
+#include "zorro/hot_path.h"
 #endif
 
 #ifdef ZORRO_USE_EVENT_CLASS
@@ -0,0 +1,239 @@
+
+#ifndef ZORRO_ARENA_H_
+#define ZORRO_ARENA_H_
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+#include <mutex>
+#include <type_traits>
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Bump allocator for scratch memory.
+// allocate() only moves a pointer; reset() makes all memory available again but keeps the
+// chunks, so after the first bars an arena serves every request without touching the heap.
+// Memory is never freed individually and destructors are not called, so only use it for
+// trivially destructible data or STL containers that live no longer than the arena scope.
+//
+//   var* Sorted = z::barArena().allocArray<var>(Period);   // valid until the next bar
+//   z::TArenaVector<int> Index(z::barArena());             // STL container on the bar arena
+//
+// With ZORRO_ARENA_DEBUG defined, an arena that has to grow from the heap after its first
+// reset prints a warning to the log, which marks heap use in the hot path.
+class CArena
+{
+	struct SChunk
+	{
+		char* data;
+		size_t size;
+	};
+
+public:
+	// position for rewinding nested scopes
+	struct SMark
+	{
+		int chunk;
+		size_t offset;
+	};
+
+	explicit CArena(size_t chunkSize = 256*1024, const char* name = "arena") :
+		m_chunkSize(chunkSize), m_name(name), m_chunk(0), m_offset(0), m_growths(0), m_resets(0), m_bar(-1), m_cycle(-1) {}
+
+	~CArena() {
+		for (size_t i = 0; i < m_chunks.size(); i++) free(m_chunks[i].data);
+	}
+
+	void* allocate(size_t bytes, size_t align = 16) {
+		if (bytes == 0) bytes = 1;
+		for (;;) {
+			if (m_chunk < static_cast<int>(m_chunks.size())) {
+				SChunk& chunk = m_chunks[m_chunk];
+				size_t base = reinterpret_cast<size_t>(chunk.data);
+				size_t offset = ((base + m_offset + align - 1) & ~(align - 1)) - base;
+				if (offset + bytes <= chunk.size) {
+					m_offset = offset + bytes;
+					return chunk.data + offset;
+				}
+				if (m_chunk + 1 < static_cast<int>(m_chunks.size())) {
+					m_chunk++;
+					m_offset = 0;
+					continue;
+				}
+			}
+			grow(bytes + align);
+		}
+	}
+
+	// array of n value-initialized elements
+	template <typename T>
+	T* allocArray(size_t n) {
+		static_assert(std::is_trivially_destructible<T>::value, "arena memory is released without destructor calls");
+		T* p = static_cast<T*>(allocate(n*sizeof(T), alignof(T) > 16 ? alignof(T) : 16));
+		for (size_t i = 0; i < n; i++) new (p + i) T();
+		return p;
+	}
+
+	inline void reset() { m_chunk = 0; m_offset = 0; m_resets++; }
+
+	inline SMark mark() const { SMark m; m.chunk = m_chunk; m.offset = m_offset; return m; }
+	inline void rewind(const SMark& m) { m_chunk = m.chunk; m_offset = m.offset; }
+
+	// resets once per bar, and when a new run starts
+	inline void updateBar() {
+		if (g->nBar == m_bar && g->nTotalCycle == m_cycle) return;
+		m_bar = g->nBar;
+		m_cycle = g->nTotalCycle;
+		reset();
+	}
+	// resets once per run, f.i. per training cycle
+	inline void updateRun() {
+		if (g->nTotalCycle == m_cycle) return;
+		m_cycle = g->nTotalCycle;
+		reset();
+	}
+
+	size_t used() const {
+		size_t n = m_offset;
+		for (int i = 0; i < m_chunk; i++) n += m_chunks[i].size;
+		return n;
+	}
+	size_t capacity() const {
+		size_t n = 0;
+		for (size_t i = 0; i < m_chunks.size(); i++) n += m_chunks[i].size;
+		return n;
+	}
+	// number of heap allocations the arena made so far
+	inline int growths() const { return m_growths; }
+	inline int resets() const { return m_resets; }
+
+private:
+	CArena(const CArena&);
+	CArena& operator=(const CArena&);
+
+	void grow(size_t minSize) {
+		SChunk chunk;
+		chunk.size = minSize > m_chunkSize ? minSize : m_chunkSize;
+		chunk.data = static_cast<char*>(malloc(chunk.size));
+		if (!chunk.data) throw std::bad_alloc();
+#ifdef ZORRO_ARENA_DEBUG
+		if (m_resets > 0 && g)
+			print(EPrintMode::TO_LOG, "\n%s grows by %u bytes at bar %d", m_name, static_cast<unsigned>(chunk.size), g->nBar);
+#endif
+		m_chunks.push_back(chunk);
+		m_chunk = static_cast<int>(m_chunks.size()) - 1;
+		m_offset = 0;
+		m_growths++;
+	}
+
+	size_t m_chunkSize;
+	const char* m_name;
+	std::vector<SChunk> m_chunks;
+	int m_chunk;
+	size_t m_offset;
+	int m_growths, m_resets;
+	int m_bar, m_cycle;
+};
+
+// Rewinds an arena at the end of a scope, for scratch memory inside a function
+class CArenaScope
+{
+public:
+	explicit CArenaScope(CArena& arena) : m_arena(arena), m_mark(arena.mark()) {}
+	~CArenaScope() { m_arena.rewind(m_mark); }
+
+private:
+	CArenaScope(const CArenaScope&);
+	CArenaScope& operator=(const CArenaScope&);
+
+	CArena& m_arena;
+	CArena::SMark m_mark;
+};
+
+// STL allocator on an arena; deallocation is a no-op
+template <typename T>
+class CArenaAllocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+	template <typename U> struct rebind { typedef CArenaAllocator<U> other; };
+
+	CArenaAllocator(CArena& arena) : m_arena(&arena) {}
+	template <typename U> CArenaAllocator(const CArenaAllocator<U>& other) : m_arena(other.arena()) {}
+
+	inline T* allocate(size_t n) { return static_cast<T*>(m_arena->allocate(n*sizeof(T), alignof(T) > 16 ? alignof(T) : 16)); }
+	inline void deallocate(T*, size_t) {}
+
+	inline CArena* arena() const { return m_arena; }
+	template <typename U> bool operator==(const CArenaAllocator<U>& other) const { return m_arena == other.arena(); }
+	template <typename U> bool operator!=(const CArenaAllocator<U>& other) const { return m_arena != other.arena(); }
+
+private:
+	CArena* m_arena;
+};
+
+template <typename T>
+using TArenaVector = std::vector<T, CArenaAllocator<T> >;
+
+///////////////////////////////////////////////////////
+// Arenas per GLOBALS, so every host instance using this DLL gets its own memory.
+// The bar arena is reset at the first access of every bar, the run arena at the first access
+// of every run; the persistent arena is never reset.
+struct SArenas
+{
+	GLOBALS* owner;
+	CArena bar, run, persistent;
+
+	explicit SArenas(GLOBALS* pGlobals) : owner(pGlobals), bar(256*1024, "bar arena"), run(1024*1024, "run arena"), persistent(1024*1024, "persistent arena") {}
+};
+
+inline SArenas& arenas(GLOBALS* pGlobals)
+{
+	static thread_local SArenas* s_last = 0;
+	if (s_last && s_last->owner == pGlobals) return *s_last;
+	static std::mutex s_mutex;
+	static std::vector<SArenas*> s_list;
+	std::lock_guard<std::mutex> lock(s_mutex);
+	for (size_t i = 0; i < s_list.size(); i++)
+		if (s_list[i]->owner == pGlobals) return *(s_last = s_list[i]);
+	s_list.push_back(new SArenas(pGlobals));
+	return *(s_last = s_list.back());
+}
+
+inline CArena& barArena()
+{
+	CArena& arena = arenas(g).bar;
+	arena.updateBar();
+	return arena;
+}
+
+inline CArena& runArena()
+{
+	CArena& arena = arenas(g).run;
+	arena.updateRun();
+	return arena;
+}
+
+inline CArena& persistentArena()
+{
+	return arenas(g).persistent;
+}
+
+// arena of the calling thread, for scratch memory in thread pool jobs; not reset automatically,
+// so use it with a CArenaScope
+inline CArena& threadArena()
+{
+	static thread_local CArena s_arena(64*1024, "thread arena");
+	return s_arena;
+}
+} // namespace z
+
+#endif // ZORRO_ARENA_H_
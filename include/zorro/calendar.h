@@ -0,0 +1,254 @@
+
+#ifndef ZORRO_CALENDAR_H_
+#define ZORRO_CALENDAR_H_
+
+#include <math.h>
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Native calendar decomposition of OLE DATE values (days since 1899-12-30, UTC).
+// civilTime() and localTime() replace year(), month(), day(), dow(), hour(), minute(), tod(),
+// tow(), ldow(), lhour(), ltod(), ltow() and dst() with integer arithmetic and no host calls.
+// Daylight saving follows the rules of the ETimeZone regions, with the transitions of every year
+// precomputed: European rules for WET/CET (zones 0..2), US rules for ET and the other American
+// zones (-10..-3), Australian rules for AEST (10, 11), none for JST, UTC and other zones.
+// The rules are exact since 1996 (EU), 1987 (US) and 2008 (AU); one-off exceptions such as the
+// Sydney Olympics extension of 2000 are not covered.
+// barCalendar() decomposes the current bar once per bar and zone and shares the result:
+//
+//   const z::SCivilTime& T = z::barCalendar().local(ETimeZone::ET);
+//   if (T.dow <= 5 && T.tod >= 930 && T.tod < 1600) ...   // NYSE session
+
+struct SCivilTime
+{
+	int year, month, day;      // month 1..12, day 1..31
+	int dow;                   // 1 = Monday .. 7 = Sunday, like dow()
+	int doy;                   // day of the year, 1..366
+	int week;                  // ISO week 1..53
+	int hour, minute, second;
+	int tod;                   // hhmm, like tod()
+	int tow;                   // dhhmm with d = dow, like tow()
+	int dst;                   // 1 during daylight saving time
+	int offset;                // minutes to add to UTC, including daylight saving
+	long days;                 // days since 1899-12-30 of the local date
+};
+
+namespace calendar_detail
+{
+	enum ERule { NO_DST, EU_DST, US_DST, AU_DST };
+	enum { FirstYear = 1970, LastYear = 2099, SecondsPerDay = 86400 };
+
+	// OLE day number of a civil date; days since 1899-12-30
+	inline long daysFromCivil(int y, int m, int d)
+	{
+		y -= m <= 2;
+		const long era = (y >= 0 ? y : y - 399)/400;
+		const long yoe = y - era*400;
+		const long doy = (153*(m + (m > 2 ? -3 : 9)) + 2)/5 + d - 1;
+		const long doe = yoe*365 + yoe/4 - yoe/100 + doy;
+		return era*146097 + doe - 719468 + 25569;
+	}
+
+	inline void civilFromDays(long days, int& y, int& m, int& d)
+	{
+		const long z = days - 25569 + 719468;
+		const long era = (z >= 0 ? z : z - 146096)/146097;
+		const long doe = z - era*146097;
+		const long yoe = (doe - doe/1460 + doe/36524 - doe/146096)/365;
+		const long doy = doe - (365*yoe + yoe/4 - yoe/100);
+		const long mp = (5*doy + 2)/153;
+		d = static_cast<int>(doy - (153*mp + 2)/5 + 1);
+		m = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+		y = static_cast<int>(yoe + era*400 + (m <= 2));
+	}
+
+	// 1 = Monday .. 7 = Sunday; day 0 (1899-12-30) was a Saturday
+	inline int weekday(long days) { return static_cast<int>(((days + 5) % 7 + 7) % 7) + 1; }
+
+	// day of the n-th Sunday of a month, n = -1 for the last one
+	inline long sunday(int y, int m, int n)
+	{
+		if (n < 0) {
+			const long last = daysFromCivil(m == 12 ? y+1 : y, m == 12 ? 1 : m+1, 1) - 1;
+			return last - (weekday(last) % 7);
+		}
+		const long first = daysFromCivil(y, m, 1);
+		return first + (7 - weekday(first)) % 7 + 7*(n-1);
+	}
+
+	inline ERule rule(int zone)
+	{
+		if (zone >= 0 && zone <= 2) return EU_DST;
+		if (zone >= -10 && zone <= -3) return US_DST;
+		if (zone == 10 || zone == 11) return AU_DST;
+		return NO_DST;
+	}
+
+	// transition days per year for the EU, US and AU rules
+	struct STransitions
+	{
+		long start[3][LastYear - FirstYear + 1], end[3][LastYear - FirstYear + 1];
+
+		STransitions() {
+			for (int y = FirstYear; y <= LastYear; y++) {
+				const int i = y - FirstYear;
+				start[0][i] = sunday(y, 3, -1);
+				end[0][i] = sunday(y, 10, -1);
+				start[1][i] = y >= 2007 ? sunday(y, 3, 2) : sunday(y, 4, 1);
+				end[1][i] = y >= 2007 ? sunday(y, 11, 1) : sunday(y, 10, -1);
+				// southern hemisphere: daylight saving ends in April and starts in October
+				start[2][i] = y >= 2008 ? sunday(y, 10, 1) : sunday(y, 10, -1);
+				end[2][i] = y >= 2008 ? sunday(y, 4, 1) : sunday(y, 3, -1);
+			}
+		}
+	};
+
+	inline const STransitions& transitions()
+	{
+		static const STransitions s_table;
+		return s_table;
+	}
+
+	// daylight saving at UTC second 'secs' in a zone with 'standard' minutes offset
+	inline int daylight(long long secs, int zone, int standard)
+	{
+		const ERule r = rule(zone);
+		if (r == NO_DST) return 0;
+		int y, m, d;
+		const long days = static_cast<long>(secs >= 0 ? secs/SecondsPerDay : (secs - SecondsPerDay + 1)/SecondsPerDay);
+		civilFromDays(days, y, m, d);
+		if (y < FirstYear || y > LastYear) return 0;
+		const STransitions& t = transitions();
+		const int i = y - FirstYear, k = r - 1;
+		// EU changes at 01:00 UTC; US at 02:00 local standard time, back at 01:00 standard;
+		// AU at 02:00 local standard time in both directions
+		long long from, to;
+		if (r == EU_DST) {
+			from = t.start[k][i]*86400LL + 3600;
+			to = t.end[k][i]*86400LL + 3600;
+		} else if (r == US_DST) {
+			from = t.start[k][i]*86400LL + 7200 - standard*60LL;
+			to = t.end[k][i]*86400LL + 3600 - standard*60LL;
+		} else {
+			from = t.start[k][i]*86400LL + 7200 - standard*60LL;
+			to = t.end[k][i]*86400LL + 7200 - standard*60LL;
+			return secs >= from || secs < to ? 1 : 0;
+		}
+		return secs >= from && secs < to ? 1 : 0;
+	}
+
+	inline long long seconds(DATE t) { return static_cast<long long>(floor(t*SecondsPerDay + 0.5)); }
+
+	inline void decompose(long long secs, SCivilTime& c)
+	{
+		long days = static_cast<long>(secs >= 0 ? secs/SecondsPerDay : (secs - SecondsPerDay + 1)/SecondsPerDay);
+		int sod = static_cast<int>(secs - days*static_cast<long long>(SecondsPerDay));
+		civilFromDays(days, c.year, c.month, c.day);
+		c.days = days;
+		c.dow = weekday(days);
+		c.doy = static_cast<int>(days - daysFromCivil(c.year, 1, 1)) + 1;
+		c.hour = sod/3600;
+		c.minute = sod/60 % 60;
+		c.second = sod % 60;
+		c.tod = c.hour*100 + c.minute;
+		c.tow = c.dow*10000 + c.tod;
+		// ISO week: the week with the year's first Thursday is week 1
+		int week = (c.doy - c.dow + 10)/7;
+		if (week < 1) {
+			const long prev = daysFromCivil(c.year-1, 12, 31);
+			const int doy = static_cast<int>(prev - daysFromCivil(c.year-1, 1, 1)) + 1;
+			week = (doy - weekday(prev) + 10)/7;
+		} else if (week == 53) {
+			const int dec31 = weekday(daysFromCivil(c.year, 12, 31));
+			if (dec31 < 4) week = 1;
+		}
+		c.week = week;
+	}
+} // namespace calendar_detail
+
+// UTC fields of a DATE
+inline SCivilTime civilTime(DATE t)
+{
+	SCivilTime c;
+	calendar_detail::decompose(calendar_detail::seconds(t), c);
+	c.dst = 0;
+	c.offset = 0;
+	return c;
+}
+
+// local fields of a DATE in a time zone, with daylight saving
+inline SCivilTime localTime(DATE t, ETimeZone zone)
+{
+	const int z = static_cast<int>(zone);
+	if (z == static_cast<int>(ETimeZone::UTC)) return civilTime(t);
+	const long long secs = calendar_detail::seconds(t);
+	const int standard = z*60;
+	const int dst = calendar_detail::daylight(secs, z, standard);
+	SCivilTime c;
+	calendar_detail::decompose(secs + (standard + 60*dst)*60LL, c);
+	c.dst = dst;
+	c.offset = standard + 60*dst;
+	return c;
+}
+
+// OLE DATE of a UTC civil time. For a local time in a zone, subtract the offset of that zone,
+// f.i. t - localTime(t, zone).offset/1440. away from the daylight saving changes.
+inline DATE civilDate(int year, int month, int day, int hour = 0, int minute = 0, int second = 0)
+{
+	return calendar_detail::daysFromCivil(year, month, day) + (hour*3600 + minute*60 + second)/86400.;
+}
+
+///////////////////////////////////////////////////////
+// Decomposition of the current bar time, computed once per bar and zone and shared by all
+// callers of the thread. Other bars are decomposed on demand from wdate(offset).
+class CBarCalendar
+{
+	enum { MinZone = -12, MaxZone = 24 };
+
+public:
+	CBarCalendar() : m_time(-1.) {
+		for (int i = 0; i <= MaxZone - MinZone; i++) m_valid[i] = false;
+	}
+
+	inline const SCivilTime& utc() { return local(ETimeZone::UTC); }
+
+	const SCivilTime& local(ETimeZone zone) {
+		update();
+		int z = static_cast<int>(zone);
+		if (z < MinZone || z > MaxZone) z = static_cast<int>(ETimeZone::UTC);
+		const int i = z - MinZone;
+		if (!m_valid[i]) {
+			m_fields[i] = localTime(m_time, static_cast<ETimeZone>(z));
+			m_valid[i] = true;
+		}
+		return m_fields[i];
+	}
+
+	// fields of an earlier bar; one host call for all fields
+	inline SCivilTime local(ETimeZone zone, int offset) {
+		return offset == 0 ? local(zone) : localTime(wdate(offset), zone);
+	}
+
+	inline DATE time() { update(); return m_time; }
+
+private:
+	inline void update() {
+		if (g->tNow == m_time) return;
+		m_time = g->tNow;
+		for (int i = 0; i <= MaxZone - MinZone; i++) m_valid[i] = false;
+	}
+
+	DATE m_time;
+	bool m_valid[MaxZone - MinZone + 1];
+	SCivilTime m_fields[MaxZone - MinZone + 1];
+};
+
+inline CBarCalendar& barCalendar()
+{
+	static thread_local CBarCalendar s_calendar;
+	return s_calendar;
+}
+} // namespace z
+
+#endif // ZORRO_CALENDAR_H_
@@ -0,0 +1,153 @@
+
+#ifndef ZORRO_CANDLES_H_
+#define ZORRO_CANDLES_H_
+
+#include <vector>
+#include "zorro/calendar.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Incremental candle aggregates updated once per bar: Heikin-Ashi candles like HAOpen(),
+// HAClose(), HAHigh(), HALow(), and daily OHLC per time zone with a history of N days like
+// dayOpen(), dayHigh(), dayLow(), dayClose() and dayPivot(). The host functions scan back
+// through the bars on every call; here each lookup is a ring buffer access.
+// A day begins at local midnight of its zone, or at 'startTime' (hhmm local); a bar belongs to
+// the day in which it closes. Days without bars, like weekends, do not appear in the history.
+//
+//   static z::CCandles Candles(5);
+//   static int NY = Candles.addZone(ETimeZone::ET, 930), EU = Candles.addZone(ETimeZone::CET);
+//   Candles.update();
+//   var Pivot = Candles.day(NY).pivot(1), HAClose = Candles.ha().close();
+
+// Heikin-Ashi candle
+class CHeikinAshi
+{
+public:
+	CHeikinAshi() : m_open(0), m_high(0), m_low(0), m_close(0), m_init(false) {}
+
+	inline void update(var open, var high, var low, var close) {
+		const var c = (open + high + low + close)/4.;
+		m_open = m_init ? (m_open + m_close)/2. : (open + close)/2.;
+		m_close = c;
+		m_high = high > m_open ? (high > c ? high : c) : (m_open > c ? m_open : c);
+		m_low = low < m_open ? (low < c ? low : c) : (m_open < c ? m_open : c);
+		m_init = true;
+	}
+	inline var open() const { return m_open; }
+	inline var high() const { return m_high; }
+	inline var low() const { return m_low; }
+	inline var close() const { return m_close; }
+
+private:
+	var m_open, m_high, m_low, m_close;
+	bool m_init;
+};
+
+// daily OHLC of one time zone; day 0 is the current, incomplete day, 1 the previous day
+class CDailyOHLC
+{
+	struct SDay
+	{
+		long key;
+		var open, high, low, close;
+	};
+
+public:
+	explicit CDailyOHLC(ETimeZone zone = ETimeZone::UTC, int days = 10, int startTime = 0)
+		: m_zone(zone), m_start(startTime/100*3600 + startTime%100*60), m_head(0), m_count(0) {
+		const SDay empty = { 0, 0., 0., 0., 0. };
+		m_days.assign((days > 0 ? days : 1) + 1, empty);
+	}
+
+	inline ETimeZone zone() const { return m_zone; }
+
+	// adds a bar by its local close time in this zone
+	void update(const SCivilTime& local, var open, var high, var low, var close) {
+		// the bar closing exactly at the day start still belongs to the day before
+		const long long secs = local.days*86400LL + local.hour*3600 + local.minute*60 + local.second - m_start - 1;
+		const long key = static_cast<long>(secs >= 0 ? secs/86400 : (secs - 86399)/86400);
+		if (m_count == 0 || key != m_days[m_head].key) {
+			if (m_count > 0) m_head = (m_head + 1) % static_cast<int>(m_days.size());
+			if (m_count < static_cast<int>(m_days.size())) m_count++;
+			SDay& d = m_days[m_head];
+			d.key = key;
+			d.open = open;
+			d.high = high;
+			d.low = low;
+			d.close = close;
+			return;
+		}
+		SDay& d = m_days[m_head];
+		if (high > d.high) d.high = high;
+		if (low < d.low) d.low = low;
+		d.close = close;
+	}
+	inline void update(DATE time, var open, var high, var low, var close) {
+		update(localTime(time, m_zone), open, high, low, close);
+	}
+
+	// number of days in the history, including the current one; before the first update()
+	// there is none and the prices below are 0
+	inline int days() const { return m_count; }
+
+	inline var open(int day) const { return at(day).open; }
+	inline var high(int day) const { return at(day).high; }
+	inline var low(int day) const { return at(day).low; }
+	inline var close(int day) const { return at(day).close; }
+	inline var pivot(int day) const { const SDay& d = at(day); return (d.high + d.low + d.close)/3.; }
+	// local date of the day start, days since 1899-12-30
+	inline DATE date(int day) const { return at(day).key + m_start/86400.; }
+
+private:
+	// days beyond the history return the oldest one
+	inline const SDay& at(int day) const {
+		if (day >= m_count) day = m_count - 1;
+		if (day < 0) day = 0;
+		const int n = static_cast<int>(m_days.size());
+		return m_days[(m_head - day + n) % n];
+	}
+
+	ETimeZone m_zone;
+	int m_start;
+	std::vector<SDay> m_days;
+	int m_head, m_count;
+};
+
+// Heikin-Ashi and the daily OHLC of several zones, fed by one call per bar
+class CCandles
+{
+public:
+	explicit CCandles(int days = 10) : m_history(days) {}
+
+	// returns the index for day()
+	int addZone(ETimeZone zone, int startTime = 0) {
+		m_zones.push_back(CDailyOHLC(zone, m_history, startTime));
+		return static_cast<int>(m_zones.size()) - 1;
+	}
+
+	void update(DATE time, var open, var high, var low, var close) {
+		m_ha.update(open, high, low, close);
+		for (size_t i = 0; i < m_zones.size(); i++) m_zones[i].update(time, open, high, low, close);
+	}
+
+	// current bar of the current asset; the local times come from the shared bar calendar
+	void update() {
+		const var o = priceOpen(0), h = priceHigh(0), l = priceLow(0), c = priceClose(0);
+		m_ha.update(o, h, l, c);
+		CBarCalendar& calendar = barCalendar();
+		for (size_t i = 0; i < m_zones.size(); i++)
+			m_zones[i].update(calendar.local(m_zones[i].zone()), o, h, l, c);
+	}
+
+	inline const CHeikinAshi& ha() const { return m_ha; }
+	inline const CDailyOHLC& day(int index) const { return m_zones[index]; }
+
+private:
+	int m_history;
+	CHeikinAshi m_ha;
+	std::vector<CDailyOHLC> m_zones;
+};
+} // namespace z
+
+#endif // ZORRO_CANDLES_H_
@@ -0,0 +1,213 @@
+
+#ifndef ZORRO_COMPONENTS_H_
+#define ZORRO_COMPONENTS_H_
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include "zorro/thread_pool.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Parallel execution of portfolio components within one bar.
+// The nested while(asset(loop(...))) while(algo(loop(...))) loop runs every component after the
+// other, although the components only share the account. The scheduler splits a bar in three
+// phases: a serial one that selects each component on the host and captures its prices and
+// STATUS; a parallel one that runs the component functions on the thread pool, with no host
+// calls and with their own series; and a serial one that applies the collected trade requests
+// to the account in component registration order, so the results do not depend on the
+// thread timing. A plain exported run() that uses the scheduler must call zorroExitRun()
+// at its end, so that the pool workers are stopped before the dll is unloaded.
+//
+//   static z::CComponentScheduler Components;
+//   if (is(INITRUN)) {
+//     Components.add("EUR/USD", "TRND", tradeTrend);          // void tradeTrend(z::CComponent& C)
+//     Components.add("USD/JPY", "CNTR", tradeCounterTrend);
+//   }
+//   Components.run();
+//
+//   void tradeTrend(z::CComponent& C) {
+//     const var* Price = C.series(C.close(), 3);
+//     if (Price[0] > Price[1] && Price[1] > Price[2]) C.enterLong(1, 0, 4*C.close()/100.);
+//   }
+
+// trade request of a component, applied after the parallel phase
+struct STradeRequest
+{
+	enum EType { ENTER_LONG, ENTER_SHORT, EXIT_LONG, EXIT_SHORT };
+
+	EType type;
+	int lots;
+	var entry, stop, takeProfit, trail;
+};
+
+// series buffer of a component: newest first and contiguous like series(), in a mirrored
+// buffer of twice the length that is copied back once per 'length' bars
+class CComponentSeries
+{
+public:
+	CComponentSeries() : m_length(0), m_pos(0) {}
+
+	const var* push(var value, int length) {
+		if (m_length != length || m_buffer.empty()) {
+			m_length = length > 0 ? length : 1;
+			m_buffer.assign(2*m_length, value);
+			m_pos = m_length;
+			return &m_buffer[m_pos];
+		}
+		if (m_pos == 0) {
+			memmove(&m_buffer[m_length], &m_buffer[0], (m_length - 1)*sizeof(var));
+			m_pos = m_length;
+		}
+		m_buffer[--m_pos] = value;
+		return &m_buffer[m_pos];
+	}
+
+private:
+	std::vector<var> m_buffer;
+	int m_length, m_pos;
+};
+
+// one asset/algo component; everything here belongs to the component and may be used
+// from its thread during the parallel phase
+class CComponent
+{
+public:
+	CComponent(const char* asset, const char* algo, int index)
+		: m_asset(asset ? asset : ""), m_algo(algo ? algo : ""), m_index(index), m_series(0) {
+		m_open = m_high = m_low = m_close = 0;
+		memset(&m_statLong, 0, sizeof(m_statLong));
+		memset(&m_statShort, 0, sizeof(m_statShort));
+	}
+
+	inline const char* asset() const { return m_asset.c_str(); }
+	inline const char* algo() const { return m_algo.c_str(); }
+	inline int index() const { return m_index; }
+
+	// prices and statistics of the current bar, captured before the parallel phase
+	inline var open() const { return m_open; }
+	inline var high() const { return m_high; }
+	inline var low() const { return m_low; }
+	inline var close() const { return m_close; }
+	inline const STATUS& statLong() const { return m_statLong; }
+	inline const STATUS& statShort() const { return m_statShort; }
+
+	// extra inputs stored by the prepare function, f.i. optimize() parameters or ATR()
+	inline var& input(int i) { if (i >= static_cast<int>(m_inputs.size())) m_inputs.resize(i+1, 0.); return m_inputs[i]; }
+
+	// component series, identified by call order within the bar like series()
+	const var* series(var value, int length) {
+		if (m_series >= static_cast<int>(m_buffers.size())) m_buffers.resize(m_series + 1);
+		return m_buffers[m_series++].push(value, length);
+	}
+
+	// trade requests, applied in order after the parallel phase
+	inline void enterLong(int lots = 0, var entry = 0, var stop = 0, var takeProfit = 0, var trail = 0) { request(STradeRequest::ENTER_LONG, lots, entry, stop, takeProfit, trail); }
+	inline void enterShort(int lots = 0, var entry = 0, var stop = 0, var takeProfit = 0, var trail = 0) { request(STradeRequest::ENTER_SHORT, lots, entry, stop, takeProfit, trail); }
+	inline void exitLong(int lots = 0, var limit = 0) { request(STradeRequest::EXIT_LONG, lots, limit, 0, 0, 0); }
+	inline void exitShort(int lots = 0, var limit = 0) { request(STradeRequest::EXIT_SHORT, lots, limit, 0, 0, 0); }
+	inline const std::vector<STradeRequest>& requests() const { return m_requests; }
+
+private:
+	friend class CComponentScheduler;
+
+	inline void request(STradeRequest::EType type, int lots, var entry, var stop, var takeProfit, var trail) {
+		STradeRequest r = { type, lots, entry, stop, takeProfit, trail };
+		m_requests.push_back(r);
+	}
+
+	// on the host thread, with the component selected
+	void capture() {
+		m_open = priceOpen(0);
+		m_high = priceHigh(0);
+		m_low = priceLow(0);
+		m_close = priceClose(0);
+		if (g->statLong) m_statLong = *g->statLong;
+		if (g->statShort) m_statShort = *g->statShort;
+		m_requests.clear();
+		m_series = 0;
+	}
+
+	std::string m_asset, m_algo;
+	int m_index;
+	var m_open, m_high, m_low, m_close;
+	STATUS m_statLong, m_statShort;
+	std::vector<var> m_inputs;
+	std::vector<CComponentSeries> m_buffers;
+	int m_series;
+	std::vector<STradeRequest> m_requests;
+};
+
+class CComponentScheduler
+{
+public:
+	typedef std::function<void(CComponent&)> TFunction;
+
+	CComponentScheduler() : m_applied(0) {}
+
+	// 'compute' runs in parallel without host calls; the optional 'prepare' runs on the host
+	// thread with the component selected and can store further inputs
+	int add(const char* asset, const char* algo, TFunction compute, TFunction prepare = TFunction()) {
+		SEntry entry = { CComponent(asset, algo, static_cast<int>(m_entries.size())), compute, prepare };
+		m_entries.push_back(entry);
+		return static_cast<int>(m_entries.size()) - 1;
+	}
+
+	inline int size() const { return static_cast<int>(m_entries.size()); }
+	inline CComponent& component(int i) { return m_entries[i].component; }
+
+	// runs all components for the current bar; returns the number of applied trade requests
+	int run() {
+		const int n = size();
+		for (int i = 0; i < n; i++) {
+			SEntry& e = m_entries[i];
+			select(e.component);
+			e.component.capture();
+			if (e.prepare) e.prepare(e.component);
+		}
+		threadPool().parallelForEach(0, n, [this](int i) {
+			SEntry& e = m_entries[i];
+			e.compute(e.component);
+		});
+		m_applied = 0;
+		for (int i = 0; i < n; i++) {
+			CComponent& c = m_entries[i].component;
+			if (c.m_requests.empty()) continue;
+			select(c);
+			for (size_t k = 0; k < c.m_requests.size(); k++) apply(c.m_requests[k]);
+			m_applied += static_cast<int>(c.m_requests.size());
+		}
+		return m_applied;
+	}
+
+	inline int applied() const { return m_applied; }
+
+private:
+	struct SEntry
+	{
+		CComponent component;
+		TFunction compute, prepare;
+	};
+
+	static void select(CComponent& c) {
+		asset(const_cast<char*>(c.asset()));
+		algo(const_cast<char*>(c.algo()));
+	}
+
+	static void apply(const STradeRequest& r) {
+		switch (r.type) {
+		case STradeRequest::ENTER_LONG: enterLong(r.lots, r.entry, r.stop, r.takeProfit, r.trail, 0., 0., 0.); break;
+		case STradeRequest::ENTER_SHORT: enterShort(r.lots, r.entry, r.stop, r.takeProfit, r.trail, 0., 0., 0.); break;
+		case STradeRequest::EXIT_LONG: exitLong(0, r.entry, r.lots); break;
+		case STradeRequest::EXIT_SHORT: exitShort(0, r.entry, r.lots); break;
+		}
+	}
+
+	std::vector<SEntry> m_entries;
+	int m_applied;
+};
+} // namespace z
+
+#endif // ZORRO_COMPONENTS_H_
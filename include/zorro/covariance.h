@@ -0,0 +1,180 @@
+
+#ifndef ZORRO_COVARIANCE_H_
+#define ZORRO_COVARIANCE_H_
+
+#include <math.h>
+#include <vector>
+#include "zorro/simd.h"
+#include "zorro/thread_pool.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Streaming covariance matrix of the returns of many assets.
+// Instead of n*n Covariance() calls per rebalance, the matrix is kept up to date with rank-1
+// updates, one return vector per bar:
+//
+//   static z::CCovarianceMatrix Cov(NumAssets, 60);       // rolling 60 bar window
+//   ... fill Returns[i] for all assets ...
+//   Cov.update(Returns);
+//   Cov.exportTo(Covariances, Means);                    // layout for markowitz()
+//   var Variance = markowitz(Covariances, Means, NumAssets, 0.5);
+//
+// EXPONENTIAL mode uses weights 2/(Period+1) like EMA; ROLLING mode keeps the sums over the
+// last Period bars and recomputes them from the stored returns every 'resync' windows.
+// Only the upper triangle is updated; rows are processed with SSE2 and spread over the thread
+// pool for large portfolios. Every element is computed the same way on all paths, so the
+// result does not depend on SIMD or thread count. With more than ParallelThreshold assets the
+// pool is started; a plain exported run() then has to end with zorroExitRun().
+class CCovarianceMatrix
+{
+public:
+	enum EMode { ROLLING, EXPONENTIAL };
+
+	CCovarianceMatrix(int assets = 0, int period = 60, EMode mode = ROLLING, int resync = 64) { init(assets, period, mode, resync); }
+
+	void init(int assets, int period, EMode mode = ROLLING, int resync = 64) {
+		m_n = assets > 0 ? assets : 0;
+		m_stride = (m_n + 1) & ~1;
+		m_period = period > 1 ? period : 2;
+		m_mode = mode;
+		m_alpha = 2./(m_period + 1);
+		m_resync = (resync > 0 ? resync : 1)*m_period;
+		m_count = m_head = m_sinceSync = 0;
+		m_sum.assign(m_stride, 0.);
+		m_mean.assign(m_stride, 0.);
+		m_delta.assign(m_stride, 0.);
+		m_cross.assign(m_n*m_stride, 0.);
+		m_window.assign(mode == ROLLING ? m_period*m_stride : 0, 0.);
+	}
+
+	// adds one return per asset
+	void update(const var* returns) {
+		const int n = m_n;
+		if (n == 0) return;
+		if (m_mode == EXPONENTIAL) {
+			if (m_count++ == 0) {
+				for (int i = 0; i < n; i++) m_mean[i] = returns[i];
+				return;
+			}
+			// West's weighted update: d = r - mean, mean += a*d, C = (1-a)*(C + a*d*d')
+			const var a = m_alpha;
+			for (int i = 0; i < n; i++) {
+				m_delta[i] = returns[i] - m_mean[i];
+				m_mean[i] += a*m_delta[i];
+			}
+			const var* d = &m_delta[0];
+			forRows([=](int i, var* row) { rowUpdate(row, i, n, 1.-a, (1.-a)*a*d[i], d, 0., d); });
+			return;
+		}
+
+		var* slot = &m_window[m_head*m_stride];
+		const bool full = m_count == m_period;
+		// with a full window the oldest return leaves and the new one takes its slot
+		for (int i = 0; i < n; i++) {
+			m_delta[i] = full ? slot[i] : 0.;
+			m_sum[i] += returns[i] - m_delta[i];
+		}
+		for (int i = 0; i < n; i++) slot[i] = returns[i];
+		m_head = (m_head + 1) % m_period;
+		if (!full) m_count++;
+		if (++m_sinceSync >= m_resync) {
+			resync();
+			return;
+		}
+		const var* x = slot;
+		const var* o = &m_delta[0];
+		forRows([=](int i, var* row) { rowUpdate(row, i, n, 1., x[i], x, -o[i], o); });
+	}
+
+	inline int size() const { return m_n; }
+	inline int count() const { return m_count; }
+	inline bool ready() const { return m_count >= 2; }
+
+	inline var mean(int i) const { return m_mode == EXPONENTIAL ? m_mean[i] : m_sum[i]/(m_count > 0 ? m_count : 1); }
+	var covariance(int i, int j) const {
+		if (i > j) { int t = i; i = j; j = t; }
+		if (m_mode == EXPONENTIAL) return m_cross[i*m_stride + j];
+		if (m_count < 2) return 0.;
+		return (m_cross[i*m_stride + j] - m_sum[i]*m_sum[j]/m_count)/(m_count - 1);
+	}
+	inline var correlation(int i, int j) const {
+		var v = covariance(i, i)*covariance(j, j);
+		return v > 0. ? covariance(i, j)/sqrt(v) : 0.;
+	}
+	// beta of asset i against asset j
+	inline var beta(int i, int j) const {
+		var v = covariance(j, j);
+		return v > 0. ? covariance(i, j)/v : 0.;
+	}
+
+	// full symmetric n*n row-major matrix and optional means, as markowitz(covMatrix,means,n,caps) expects
+	void exportTo(var* covMatrix, var* means = 0) const {
+		const int n = m_n;
+		const int block = 32;
+		for (int i0 = 0; i0 < n; i0 += block)
+			for (int j0 = i0; j0 < n; j0 += block)
+				for (int i = i0; i < i0 + block && i < n; i++)
+					for (int j = (j0 > i ? j0 : i); j < j0 + block && j < n; j++)
+						covMatrix[i*n + j] = covMatrix[j*n + i] = covariance(i, j);
+		if (means)
+			for (int i = 0; i < n; i++) means[i] = mean(i);
+	}
+	void exportCorrelation(var* corrMatrix) const {
+		const int n = m_n;
+		for (int i = 0; i < n; i++)
+			for (int j = i; j < n; j++)
+				corrMatrix[i*n + j] = corrMatrix[j*n + i] = (i == j ? 1. : correlation(i, j));
+	}
+
+private:
+	enum { ParallelThreshold = 96 };
+
+	template <typename Functor>
+	inline void forRows(Functor functor) {
+		var* cross = &m_cross[0];
+		const int stride = m_stride;
+		if (m_n < ParallelThreshold) {
+			for (int i = 0; i < m_n; i++) functor(i, cross + i*stride);
+			return;
+		}
+		threadPool().parallelForEach(0, m_n, [=](int i) { functor(i, cross + i*stride); }, 8);
+	}
+
+	// row[j] = s*row[j] + u*x[j] + v*y[j] for j = i..n-1
+	static inline void rowUpdate(var* row, int i, int n, var s, var u, const var* x, var v, const var* y) {
+		int j = i;
+#ifdef ZORRO_SIMD_SSE2
+		const __m128d vs = _mm_set1_pd(s), vu = _mm_set1_pd(u), vv = _mm_set1_pd(v);
+		for (; j + 2 <= n; j += 2) {
+			__m128d c = _mm_mul_pd(vs, _mm_loadu_pd(row + j));
+			c = _mm_add_pd(c, _mm_mul_pd(vu, _mm_loadu_pd(x + j)));
+			c = _mm_add_pd(c, _mm_mul_pd(vv, _mm_loadu_pd(y + j)));
+			_mm_storeu_pd(row + j, c);
+		}
+#endif
+		for (; j < n; j++) row[j] = s*row[j] + u*x[j] + v*y[j];
+	}
+
+	// rolling sums recomputed from the stored returns
+	void resync() {
+		const int n = m_n;
+		m_sinceSync = 0;
+		for (int i = 0; i < n; i++) m_sum[i] = 0.;
+		for (size_t k = 0; k < m_cross.size(); k++) m_cross[k] = 0.;
+		for (int t = 0; t < m_count; t++) {
+			const var* r = &m_window[t*m_stride];
+			for (int i = 0; i < n; i++) m_sum[i] += r[i];
+			forRows([=](int i, var* row) { rowUpdate(row, i, n, 1., r[i], r, 0., r); });
+		}
+	}
+
+	int m_n, m_stride, m_period, m_resync;
+	EMode m_mode;
+	var m_alpha;
+	int m_count, m_head, m_sinceSync;
+	TAlignedVars m_sum, m_mean, m_delta, m_cross, m_window;
+};
+} // namespace z
+
+#endif // ZORRO_COVARIANCE_H_
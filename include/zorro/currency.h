@@ -0,0 +1,181 @@
+
+#ifndef ZORRO_CURRENCY_H_
+#define ZORRO_CURRENCY_H_
+
+#include <string.h>
+#include <vector>
+#include <string>
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Currency strength engine for ccySet(), ccyStrength(), ccyMax() and ccyMin().
+// Every pair adds its value to the base currency and subtracts it from the counter currency;
+// a currency's strength is the average over its pairs. The pair-to-currency incidence has two
+// entries per pair, so all strengths follow from one pass over the pair values, and a single
+// pair update on a tick moves only its two currencies. The ranking of the currencies and the
+// strongest and weakest pair are kept lazily: after an update the previous order is repaired by
+// insertion sort, which is linear for the small moves between ticks.
+//
+//   static z::CCurrencyStrength Ccy;
+//   if (is(INITRUN)) for (...) Ccy.addPair(Asset);            // f.i. the 28 majors and crosses
+//   Ccy.set(Ccy.find(Asset), RSI(series(priceClose()), 14) - 50);
+//   var Strength = Ccy.strength("EUR");
+//   const char* Best = Ccy.pairName(Ccy.maxPair());           // like ccyMax()
+class CCurrencyStrength
+{
+	enum { CodeSize = 3 };
+
+public:
+	CCurrencyStrength() : m_dirty(false), m_maxPair(-1), m_minPair(-1) {}
+
+	// "EUR/USD" or "EURUSD"; returns the pair index
+	int addPair(const char* name) {
+		const int found = find(name);
+		if (found >= 0) return found;
+		if (!name || strlen(name) < 2*CodeSize) return -1;
+		const char* counter = name + CodeSize + (name[CodeSize] == '/' ? 1 : 0);
+		const int base = addCurrency(name), quote = addCurrency(counter);
+		m_names.push_back(name);
+		m_base.push_back(base);
+		m_counter.push_back(quote);
+		m_value.push_back(0);
+		m_count[base]++;
+		m_count[quote]++;
+		m_dirty = true;
+		return pairs() - 1;
+	}
+
+	inline int pairs() const { return static_cast<int>(m_names.size()); }
+	inline int currencies() const { return static_cast<int>(m_codes.size()); }
+	inline const char* pairName(int pair) const { return pair >= 0 && pair < pairs() ? m_names[pair].c_str() : ""; }
+	inline const char* currencyName(int c) const { return c >= 0 && c < currencies() ? m_codes[c].c_str() : ""; }
+
+	// pair index, or -1
+	int find(const char* name) const {
+		if (!name) return -1;
+		for (size_t i = 0; i < m_names.size(); i++)
+			if (m_names[i] == name) return static_cast<int>(i);
+		return -1;
+	}
+
+	// currency index of a 3 letter code, or -1
+	int currency(const char* code) const {
+		if (!code) return -1;
+		for (size_t i = 0; i < m_codes.size(); i++)
+			if (strncmp(m_codes[i].c_str(), code, CodeSize) == 0) return static_cast<int>(i);
+		return -1;
+	}
+
+	// one pair value, like ccySet() for that asset; O(1)
+	inline void set(int pair, var value) {
+		if (pair < 0 || pair >= pairs()) return;
+		const var delta = value - m_value[pair];
+		m_value[pair] = value;
+		m_sum[m_base[pair]] += delta;
+		m_sum[m_counter[pair]] -= delta;
+		m_dirty = true;
+	}
+
+	// all pair values at once, in pair index order
+	void update(const var* values) {
+		const int n = currencies(), np = pairs();
+		for (int c = 0; c < n; c++) m_sum[c] = 0;
+		for (int i = 0; i < np; i++) {
+			m_value[i] = values[i];
+			m_sum[m_base[i]] += values[i];
+			m_sum[m_counter[i]] -= values[i];
+		}
+		m_dirty = true;
+	}
+
+	// clears all values, like ccyReset()
+	void reset() {
+		for (size_t i = 0; i < m_value.size(); i++) m_value[i] = 0;
+		for (size_t c = 0; c < m_sum.size(); c++) m_sum[c] = 0;
+		m_dirty = true;
+	}
+
+	// average strength of a currency
+	inline var strength(int c) const { return c >= 0 && c < currencies() && m_count[c] ? m_sum[c]/m_count[c] : 0.; }
+	// strength of a pair, base minus counter currency
+	inline var pairStrength(int pair) const {
+		if (pair < 0 || pair >= pairs()) return 0.;
+		return strength(m_base[pair]) - strength(m_counter[pair]);
+	}
+	// like ccyStrength(): "EUR" for a currency, "EUR/USD" for a pair
+	var strength(const char* name) const {
+		if (!name) return 0.;
+		if (strlen(name) <= CodeSize) return strength(currency(name));
+		const int pair = find(name);
+		if (pair >= 0) return pairStrength(pair);
+		const char* counter = name + CodeSize + (name[CodeSize] == '/' ? 1 : 0);
+		return strength(currency(name)) - strength(currency(counter));
+	}
+
+	// currency of rank i, 0 = strongest
+	inline int ranked(int i) { sort(); return i >= 0 && i < currencies() ? m_rank[i] : -1; }
+	inline int strongest() { return ranked(0); }
+	inline int weakest() { return ranked(currencies() - 1); }
+	// pair with the highest and lowest strength, like ccyMax() and ccyMin()
+	inline int maxPair() { sort(); return m_maxPair; }
+	inline int minPair() { sort(); return m_minPair; }
+
+private:
+	int addCurrency(const char* code) {
+		const int found = currency(code);
+		if (found >= 0) return found;
+		m_codes.push_back(std::string(code, CodeSize));
+		m_sum.push_back(0);
+		m_count.push_back(0);
+		m_strength.push_back(0);
+		m_rank.push_back(static_cast<int>(m_rank.size()));
+		return static_cast<int>(m_codes.size()) - 1;
+	}
+
+	// repairs the ranking from the previous order, and finds the extreme pairs
+	void sort() {
+		if (!m_dirty) return;
+		m_dirty = false;
+		const int n = currencies(), np = pairs();
+		for (int c = 0; c < n; c++) m_strength[c] = m_count[c] ? m_sum[c]/m_count[c] : 0.;
+		const var* strength = n > 0 ? &m_strength[0] : 0;
+		for (int i = 1; i < n; i++) {
+			const int c = m_rank[i];
+			const var s = strength[c];
+			int j = i;
+			for (; j > 0 && strength[m_rank[j-1]] < s; j--) m_rank[j] = m_rank[j-1];
+			m_rank[j] = c;
+		}
+		m_maxPair = m_minPair = -1;
+		if (np == 0) return;
+		const int* base = &m_base[0];
+		const int* counter = &m_counter[0];
+		var hi = strength[base[0]] - strength[counter[0]], lo = hi;
+		int maxPair = 0, minPair = 0;
+		for (int i = 1; i < np; i++) {
+			const var s = strength[base[i]] - strength[counter[i]];
+			// branch free, the extremes change unpredictably between ticks
+			maxPair = s > hi ? i : maxPair;
+			hi = s > hi ? s : hi;
+			minPair = s < lo ? i : minPair;
+			lo = s < lo ? s : lo;
+		}
+		m_maxPair = maxPair;
+		m_minPair = minPair;
+	}
+
+	// pairs as parallel arrays
+	std::vector<std::string> m_names;
+	std::vector<int> m_base, m_counter;
+	std::vector<var> m_value;
+	// per currency
+	std::vector<std::string> m_codes;
+	std::vector<var> m_sum, m_strength;
+	std::vector<int> m_count, m_rank;
+	bool m_dirty;
+	int m_maxPair, m_minPair;
+};
+} // namespace z
+
+#endif // ZORRO_CURRENCY_H_
@@ -0,0 +1,401 @@
+
+#ifndef ZORRO_FILTER_BANK_H_
+#define ZORRO_FILTER_BANK_H_
+
+#include "zorro/indicators.h"
+#include "zorro/simd.h"
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Filter banks: one filter type evaluated for a whole vector of periods in one pass.
+// The lanes are stored as structure of arrays and updated with SSE2 two periods at a time.
+// Every optimize() step is a separate simulation run, so a bank read with valueFor(optimize(...))
+// does not share work between the steps. To score all periods at once, run the bank once
+// without optimize() and let a CBankSweep trade every lane on paper; then use the best period:
+//
+//   static int Periods[] = { 20,22,24,26,28,30,32,34,36,38,40 };
+//   static z::CBandPassBank Bank(Periods, 11, 0.5);
+//   static z::CBankSweep Sweep(Periods, 11);
+//   Sweep.slope(Bank.update(price()), priceClose());   // long when a lane rises, short when it falls
+//   if (is(EXITRUN)) printf("\nbest period %d", Sweep.bestPeriod());
+//   ...
+//   var Filtered = Bank.valueFor(BestPeriod);           // several periods in one strategy
+//
+// The results equal the single z:: filters within floating point rounding.
+
+// bank of linear recursive filters y = b0*x0+b1*x1+b2*x2+b3*x3 + a1*y1+a2*y2+a3*y3
+class CIIRBank
+{
+public:
+	CIIRBank() : m_size(0), m_presetOutput(true), m_init(false) {}
+
+	inline int size() const { return m_size; }
+	inline int period(int lane) const { return m_periods[lane]; }
+
+	// current output of all lanes
+	inline const var* values() const { return &m_y1[0]; }
+	inline var value(int lane) const { return m_y1[lane]; }
+
+	// lane of the given period, or -1
+	inline int lane(int period) const {
+		for (int i = 0; i < m_size; i++)
+			if (m_periods[i] == period) return i;
+		return -1;
+	}
+	inline var valueFor(int period) const {
+		int i = lane(period);
+		return i >= 0 ? m_y1[i] : 0.;
+	}
+
+	// feeds the same input to all lanes
+	const var* update(var x) {
+		for (int i = 0; i < m_size; i++) m_in[i] = x;
+		return step();
+	}
+
+	// feeds an individual input to every lane
+	const var* update(const var* x) {
+		for (int i = 0; i < m_size; i++) m_in[i] = x[i];
+		return step();
+	}
+
+protected:
+	void resize(const int* periods, int n) {
+		m_size = n;
+		m_periods.assign(periods, periods + n);
+		int padded = (n + 1) & ~1; // even number of lanes for the SSE2 loop
+		TAlignedVars* arrays[] = { &m_in, &m_x1, &m_x2, &m_x3, &m_y1, &m_y2, &m_y3, &m_b0, &m_b1, &m_b2, &m_b3, &m_a1, &m_a2, &m_a3 };
+		for (size_t k = 0; k < sizeof(arrays)/sizeof(arrays[0]); k++)
+			arrays[k]->assign(padded, 0.);
+		m_init = false;
+	}
+
+	inline void setLane(int i, var b0, var b1, var b2, var b3, var a1, var a2, var a3) {
+		m_b0[i] = b0; m_b1[i] = b1; m_b2[i] = b2; m_b3[i] = b3;
+		m_a1[i] = a1; m_a2[i] = a2; m_a3[i] = a3;
+	}
+
+	// true: the output history starts with the first input (low pass type filters),
+	// false: it starts with 0 (high pass type filters)
+	inline void setPresetOutput(bool preset) { m_presetOutput = preset; }
+
+	const var* step() {
+		const int n = static_cast<int>(m_in.size());
+		if (!m_init) {
+			for (int i = 0; i < n; i++) {
+				m_x1[i] = m_x2[i] = m_x3[i] = m_in[i];
+				m_y1[i] = m_y2[i] = m_y3[i] = m_presetOutput ? m_in[i] : 0.;
+			}
+			m_init = true;
+			if (m_presetOutput) return &m_y1[0];
+		}
+		int i = 0;
+#ifdef ZORRO_SIMD_SSE2
+		for (; i + 2 <= n; i += 2) {
+			__m128d x0 = _mm_load_pd(&m_in[i]), x1 = _mm_load_pd(&m_x1[i]), x2 = _mm_load_pd(&m_x2[i]), x3 = _mm_load_pd(&m_x3[i]);
+			__m128d y1 = _mm_load_pd(&m_y1[i]), y2 = _mm_load_pd(&m_y2[i]), y3 = _mm_load_pd(&m_y3[i]);
+			__m128d y = _mm_mul_pd(_mm_load_pd(&m_b0[i]), x0);
+			y = _mm_add_pd(y, _mm_mul_pd(_mm_load_pd(&m_b1[i]), x1));
+			y = _mm_add_pd(y, _mm_mul_pd(_mm_load_pd(&m_b2[i]), x2));
+			y = _mm_add_pd(y, _mm_mul_pd(_mm_load_pd(&m_b3[i]), x3));
+			y = _mm_add_pd(y, _mm_mul_pd(_mm_load_pd(&m_a1[i]), y1));
+			y = _mm_add_pd(y, _mm_mul_pd(_mm_load_pd(&m_a2[i]), y2));
+			y = _mm_add_pd(y, _mm_mul_pd(_mm_load_pd(&m_a3[i]), y3));
+			_mm_store_pd(&m_x3[i], x2); _mm_store_pd(&m_x2[i], x1); _mm_store_pd(&m_x1[i], x0);
+			_mm_store_pd(&m_y3[i], y2); _mm_store_pd(&m_y2[i], y1); _mm_store_pd(&m_y1[i], y);
+		}
+#endif
+		for (; i < n; i++) {
+			var y = m_b0[i]*m_in[i];
+			y += m_b1[i]*m_x1[i];
+			y += m_b2[i]*m_x2[i];
+			y += m_b3[i]*m_x3[i];
+			y += m_a1[i]*m_y1[i];
+			y += m_a2[i]*m_y2[i];
+			y += m_a3[i]*m_y3[i];
+			m_x3[i] = m_x2[i]; m_x2[i] = m_x1[i]; m_x1[i] = m_in[i];
+			m_y3[i] = m_y2[i]; m_y2[i] = m_y1[i]; m_y1[i] = y;
+		}
+		return &m_y1[0];
+	}
+
+	int m_size;
+	bool m_presetOutput, m_init;
+	std::vector<int> m_periods;
+	TAlignedVars m_in, m_x1, m_x2, m_x3, m_y1, m_y2, m_y3;
+	TAlignedVars m_b0, m_b1, m_b2, m_b3, m_a1, m_a2, m_a3;
+};
+
+// LowPass(Data,Period) for many periods
+class CLowPassBank : public CIIRBank
+{
+public:
+	CLowPassBank(const int* periods, int n) {
+		resize(periods, n);
+		for (int i = 0; i < n; i++) {
+			var a = 2./(1+periods[i]);
+			setLane(i, a-0.25*a*a, 0.5*a*a, -(a-0.75*a*a), 0., 2*(1.-a), -(1.-a)*(1.-a), 0.);
+		}
+	}
+};
+
+// HighPass1(Data,Cutoff) for many cutoffs
+class CHighPass1Bank : public CIIRBank
+{
+public:
+	CHighPass1Bank(const int* periods, int n) {
+		resize(periods, n);
+		setPresetOutput(false);
+		for (int i = 0; i < n; i++) {
+			var a = (0.707*2*PI)/periods[i];
+			var alpha = 1.+(sin(a)-1.)/cos(a);
+			setLane(i, 1.-alpha/2., -(1.-alpha/2.), 0., 0., 1.-alpha, 0., 0.);
+		}
+	}
+};
+
+// HighPass(Data,Cutoff) for many cutoffs
+class CHighPassBank : public CIIRBank
+{
+public:
+	CHighPassBank(const int* periods, int n) {
+		resize(periods, n);
+		setPresetOutput(false);
+		for (int i = 0; i < n; i++) {
+			var a = (0.707*2*PI)/periods[i];
+			var alpha = 1.+(sin(a)-1.)/cos(a);
+			var b = (1.-alpha/2.)*(1.-alpha/2.), c = 1.-alpha;
+			setLane(i, b, -2*b, b, 0., 2*c, -c*c, 0.);
+		}
+	}
+};
+
+// BandPass(Data,Period,Delta) for many periods
+class CBandPassBank : public CIIRBank
+{
+public:
+	CBandPassBank(const int* periods, int n, var delta) {
+		resize(periods, n);
+		for (int i = 0; i < n; i++) {
+			var beta = cos(2*PI/periods[i]);
+			var gamma = 1./cos(4*PI*delta/periods[i]);
+			var alpha = gamma - sqrt(gamma*gamma - 1.);
+			setLane(i, 0.5*(1.-alpha), 0., -0.5*(1.-alpha), 0., beta*(1.+alpha), -alpha, 0.);
+		}
+	}
+};
+
+// Smooth(Data,Cutoff) for many cutoffs
+class CSmoothBank : public CIIRBank
+{
+public:
+	CSmoothBank(const int* periods, int n) {
+		resize(periods, n);
+		for (int i = 0; i < n; i++) {
+			var f = (1.414*PI)/periods[i];
+			var a = exp(-f);
+			var c2 = 2*a*cos(f), c3 = -a*a, c1 = 1.-c2-c3;
+			setLane(i, 0.5*c1, 0.5*c1, 0., 0., c2, c3, 0.);
+		}
+	}
+};
+
+// Butterworth(Data,Cutoff) for many cutoffs
+class CButterworthBank : public CIIRBank
+{
+public:
+	CButterworthBank(const int* periods, int n) {
+		resize(periods, n);
+		for (int i = 0; i < n; i++) {
+			var a = exp(-PI/periods[i]);
+			var b = 2*a*cos(1.738*PI/periods[i]);
+			var c = a*a;
+			var c1 = (1.-b+c)*(1.-c)/8.;
+			setLane(i, c1, 3*c1, 3*c1, c1, b+c, -(c+b*c), c*c);
+		}
+	}
+};
+
+// Decycle(Data,Period) for many periods: the input minus the 1-pole high pass bank
+class CDecycleBank
+{
+public:
+	CDecycleBank(const int* periods, int n) : m_hp(periods, n), m_y(n, 0.) {}
+
+	inline int size() const { return m_hp.size(); }
+	inline const var* values() const { return &m_y[0]; }
+	inline var value(int lane) const { return m_y[lane]; }
+	inline var valueFor(int period) const { int i = m_hp.lane(period); return i >= 0 ? m_y[i] : 0.; }
+
+	const var* update(var x) {
+		const var* hp = m_hp.update(x);
+		for (int i = 0; i < m_hp.size(); i++) m_y[i] = x - hp[i];
+		return &m_y[0];
+	}
+
+private:
+	CHighPass1Bank m_hp;
+	TAlignedVars m_y;
+};
+
+// Roof(Data,CutoffLow,CutoffHigh) for many cutoff pairs
+class CRoofBank
+{
+public:
+	CRoofBank(const int* cutoffsLow, const int* cutoffsHigh, int n) : m_hp(cutoffsHigh, n), m_smooth(cutoffsLow, n) {}
+
+	inline int size() const { return m_smooth.size(); }
+	inline const var* values() const { return m_smooth.values(); }
+	inline var value(int lane) const { return m_smooth.value(lane); }
+
+	// lane of the given cutoff pair, or -1
+	inline int lane(int cutoffLow, int cutoffHigh) const {
+		for (int i = 0; i < size(); i++)
+			if (m_smooth.period(i) == cutoffLow && m_hp.period(i) == cutoffHigh) return i;
+		return -1;
+	}
+	inline var valueFor(int cutoffLow, int cutoffHigh) const {
+		int i = lane(cutoffLow, cutoffHigh);
+		return i >= 0 ? m_smooth.value(i) : 0.;
+	}
+
+	inline const var* update(var x) { return m_smooth.update(m_hp.update(x)); }
+
+private:
+	CHighPassBank m_hp;
+	CSmoothBank m_smooth;
+};
+
+// Laguerre(Data,Alpha) for many alpha values
+class CLaguerreBank
+{
+public:
+	CLaguerreBank(const var* alphas, int n) : m_size(n), m_init(false) {
+		int padded = (n + 1) & ~1;
+		m_g.assign(padded, 0.); m_alpha.assign(padded, 0.);
+		m_l0.assign(padded, 0.); m_l1.assign(padded, 0.); m_l2.assign(padded, 0.); m_l3.assign(padded, 0.);
+		m_y.assign(padded, 0.);
+		for (int i = 0; i < n; i++) { m_alpha[i] = alphas[i]; m_g[i] = 1.-alphas[i]; }
+	}
+
+	inline int size() const { return m_size; }
+	inline const var* values() const { return &m_y[0]; }
+	inline var value(int lane) const { return m_y[lane]; }
+
+	const var* update(var x) {
+		const int n = static_cast<int>(m_y.size());
+		if (!m_init) {
+			for (int i = 0; i < n; i++) m_l0[i] = m_l1[i] = m_l2[i] = m_l3[i] = x;
+			m_init = true;
+		}
+		int i = 0;
+#ifdef ZORRO_SIMD_SSE2
+		const __m128d vx = _mm_set1_pd(x), two = _mm_set1_pd(2.), sixth = _mm_set1_pd(1./6.);
+		for (; i + 2 <= n; i += 2) {
+			__m128d g1 = _mm_load_pd(&m_g[i]);
+			__m128d p0 = _mm_load_pd(&m_l0[i]), p1 = _mm_load_pd(&m_l1[i]), p2 = _mm_load_pd(&m_l2[i]), p3 = _mm_load_pd(&m_l3[i]);
+			__m128d l0 = _mm_add_pd(_mm_mul_pd(_mm_load_pd(&m_alpha[i]), vx), _mm_mul_pd(g1, p0));
+			__m128d l1 = _mm_add_pd(_mm_sub_pd(p0, _mm_mul_pd(g1, l0)), _mm_mul_pd(g1, p1));
+			__m128d l2 = _mm_add_pd(_mm_sub_pd(p1, _mm_mul_pd(g1, l1)), _mm_mul_pd(g1, p2));
+			__m128d l3 = _mm_add_pd(_mm_sub_pd(p2, _mm_mul_pd(g1, l2)), _mm_mul_pd(g1, p3));
+			_mm_store_pd(&m_l0[i], l0); _mm_store_pd(&m_l1[i], l1); _mm_store_pd(&m_l2[i], l2); _mm_store_pd(&m_l3[i], l3);
+			__m128d s = _mm_add_pd(_mm_add_pd(l0, _mm_mul_pd(two, l1)), _mm_add_pd(_mm_mul_pd(two, l2), l3));
+			_mm_store_pd(&m_y[i], _mm_mul_pd(s, sixth));
+		}
+#endif
+		for (; i < n; i++) {
+			var g1 = m_g[i];
+			var l0 = m_alpha[i]*x + g1*m_l0[i];
+			var l1 = (m_l0[i] - g1*l0) + g1*m_l1[i];
+			var l2 = (m_l1[i] - g1*l1) + g1*m_l2[i];
+			var l3 = (m_l2[i] - g1*l2) + g1*m_l3[i];
+			m_l0[i] = l0; m_l1[i] = l1; m_l2[i] = l2; m_l3[i] = l3;
+			m_y[i] = ((l0 + 2.*l1) + (2.*l2 + l3)) * (1./6.);
+		}
+		return &m_y[0];
+	}
+
+private:
+	int m_size;
+	bool m_init;
+	TAlignedVars m_alpha, m_g, m_l0, m_l1, m_l2, m_l3, m_y;
+};
+
+// Single run period sweep: every lane holds a position from its own signal, and the position of
+// the previous bar earns the price change of the current one, without trading costs. The
+// scores of all lanes come from one pass, instead of one simulation run per optimize() step.
+class CBankSweep
+{
+public:
+	CBankSweep(const int* periods, int n) : m_periods(periods, periods + n), m_position(n, 0.), m_signal(n, 0.), m_last(n, 0.),
+		m_profit(n, 0.), m_sum2(n, 0.), m_price(0.), m_bars(0) {}
+
+	inline int size() const { return static_cast<int>(m_periods.size()); }
+	inline int period(int lane) const { return m_periods[lane]; }
+	inline int bars() const { return m_bars; }
+
+	// positions of all lanes from now on, f.i. -1..1, and the current price
+	void update(const var* positions, var price) {
+		if (m_bars > 0) {
+			const var change = price - m_price;
+			for (int i = 0; i < size(); i++) {
+				const var pnl = m_position[i]*change;
+				m_profit[i] += pnl;
+				m_sum2[i] += pnl*pnl;
+			}
+		}
+		for (int i = 0; i < size(); i++) m_position[i] = positions[i];
+		m_price = price;
+		m_bars++;
+	}
+
+	// long when the filter output of a lane rises, short when it falls
+	void slope(const var* values, var price) {
+		for (int i = 0; i < size(); i++) {
+			const var v = values[i];
+			m_signal[i] = m_bars > 0 ? (v > m_last[i] ? 1. : v < m_last[i] ? -1. : 0.) : 0.;
+			m_last[i] = v;
+		}
+		update(&m_signal[0], price);
+	}
+
+	// paper profit of a lane in price units, and its mean per bar divided by the deviation
+	inline var profit(int lane) const { return m_profit[lane]; }
+	inline var sharpe(int lane) const {
+		const int n = m_bars - 1;
+		if (n < 2) return 0.;
+		const var mean = m_profit[lane]/n, v = m_sum2[lane]/n - mean*mean;
+		return v > 0. ? mean/sqrt(v) : 0.;
+	}
+
+	// lane with the highest Sharpe ratio, or -1 before the third bar; the Sharpe ratio needs
+	// the profits of two bars, and the first bar has none
+	int best() const {
+		if (m_bars < 3) return -1;
+		int b = -1;
+		for (int i = 0; i < size(); i++)
+			if (b < 0 || sharpe(i) > sharpe(b)) b = i;
+		return b;
+	}
+	inline int bestPeriod() const { int b = best(); return b >= 0 ? m_periods[b] : 0; }
+
+	void clear() {
+		std::fill(m_position.begin(), m_position.end(), 0.);
+		std::fill(m_profit.begin(), m_profit.end(), 0.);
+		std::fill(m_sum2.begin(), m_sum2.end(), 0.);
+		m_bars = 0;
+	}
+
+private:
+	std::vector<int> m_periods;
+	std::vector<var> m_position, m_signal, m_last, m_profit, m_sum2;
+	var m_price;
+	int m_bars;
+};
+} // namespace z
+
+#endif // ZORRO_FILTER_BANK_H_
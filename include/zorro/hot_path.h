@@ -0,0 +1,199 @@
+
+#ifndef ZORRO_HOT_PATH_H_
+#define ZORRO_HOT_PATH_H_
+
+///////////////////////////////////////////////////////
+// Allocation-free hot path verification.
+// Build with ZORRO_HOT_PATH_CHECK defined to report every heap allocation made inside run(),
+// tick(), tock() or a trade management function. zorro_impl.h then replaces the global
+// operator new/delete in all forms, including the nothrow and the C++17 aligned ones.
+// Direct malloc(), calloc() or realloc() calls are only seen with the debug CRT, which is
+// hooked through _CrtSetAllocHook; release builds report operator new only.
+// The CZorroEvents run(), tick() and tock() are checked automatically, and so is a run()
+// defined with ZORRO_RUN() from zorro_impl.h. Other exported functions mark themselves with
+// ZORRO_HOT_PATH_SCOPE, and TMFs are wrapped:
+//
+//   ZORRO_RUN() { ... }                                 // instead of ZORRO_EXPORT void ZORRO_CALL run()
+//   ZORRO_EXPORT void ZORRO_CALL tick() { ZORRO_HOT_PATH_SCOPE("tick"); ... }
+//   enterLong(z::hotPathTMF<MyTMF>);                    // int MyTMF()
+//
+// tests/hot_path_host.cpp is a stand-in host that runs a strategy source with stub host
+// functions for a number of bars and fails when an allocation site was found.
+//
+// Every allocation site is recorded once with its call stack; new sites are printed to the log
+// when the outermost scope is left. Define ZORRO_HOT_PATH_SYMBOLS to resolve the stack with
+// DbgHelp. Without ZORRO_HOT_PATH_CHECK the macro is empty and nothing is hooked.
+
+#ifdef ZORRO_HOT_PATH_CHECK
+
+#include <stddef.h>
+#include <atomic>
+#ifdef ZORRO_HOT_PATH_SYMBOLS
+#include <DbgHelp.h>
+#pragma comment(lib, "dbghelp.lib")
+#endif
+
+#ifndef ZORRO_HOT_PATH_FRAMES
+#define ZORRO_HOT_PATH_FRAMES 12
+#endif
+#ifndef ZORRO_HOT_PATH_SITES
+#define ZORRO_HOT_PATH_SITES 64
+#endif
+
+namespace z
+{
+struct SHotPathSite
+{
+	const char* scope;
+	void* frames[ZORRO_HOT_PATH_FRAMES];
+	int numFrames;
+	int count;
+	size_t bytes;
+	int bar;
+};
+
+// Collects the allocation sites. note() runs inside the allocator, so it uses no heap, no
+// host calls and only a spin lock; everything that may allocate happens in report().
+class CHotPathMonitor
+{
+public:
+	CHotPathMonitor() : m_numSites(0), m_reported(0), m_total(0), m_dropped(0) { m_lock.clear(); }
+
+	inline void enter(const char* scope) {
+		if (depth()++ == 0) currentScope() = scope;
+	}
+	inline void leave() {
+		if (--depth() == 0 && m_reported < m_numSites) report();
+	}
+
+	// called by the allocation hooks
+	void note(size_t bytes) {
+		if (depth() == 0 || muted() > 0) return;
+		muted()++;
+		void* frames[ZORRO_HOT_PATH_FRAMES];
+		// skip note() and the hook itself
+		int n = CaptureStackBackTrace(2, ZORRO_HOT_PATH_FRAMES, frames, 0);
+		while (m_lock.test_and_set(std::memory_order_acquire)) {}
+		m_total++;
+		int i = 0;
+		for (; i < m_numSites; i++)
+			if (sameStack(m_sites[i], frames, n)) break;
+		if (i < m_numSites) {
+			m_sites[i].count++;
+			m_sites[i].bytes += bytes;
+		} else if (m_numSites < ZORRO_HOT_PATH_SITES) {
+			SHotPathSite& site = m_sites[m_numSites++];
+			site.scope = currentScope();
+			for (int k = 0; k < n; k++) site.frames[k] = frames[k];
+			site.numFrames = n;
+			site.count = 1;
+			site.bytes = bytes;
+			site.bar = g ? g->nBar : 0;
+		} else
+			m_dropped++;
+		m_lock.clear(std::memory_order_release);
+		muted()--;
+	}
+
+	// prints the sites found since the last report
+	void report() {
+		muted()++;
+		while (m_lock.test_and_set(std::memory_order_acquire)) {}
+		int from = m_reported, to = m_numSites;
+		m_reported = to;
+		m_lock.clear(std::memory_order_release);
+		for (int i = from; i < to; i++) {
+			const SHotPathSite& site = m_sites[i];
+			print(EPrintMode::TO_LOG, "\nHeap allocation in %s at bar %d, %u bytes:", site.scope, site.bar, static_cast<unsigned>(site.bytes));
+			for (int k = 0; k < site.numFrames; k++) printFrame(site.frames[k]);
+		}
+		if (m_dropped > 0)
+			print(EPrintMode::TO_LOG, "\n%d more heap allocations at unrecorded sites", m_dropped);
+		muted()--;
+	}
+
+	inline int sites() const { return m_numSites; }
+	inline long total() const { return m_total; }
+	inline const SHotPathSite& site(int i) const { return m_sites[i]; }
+
+	// thread state, plain PODs so that they need no allocation
+	static inline int& depth() { static thread_local int s_depth = 0; return s_depth; }
+	static inline int& muted() { static thread_local int s_muted = 0; return s_muted; }
+	static inline const char*& currentScope() { static thread_local const char* s_scope = ""; return s_scope; }
+
+private:
+	static inline bool sameStack(const SHotPathSite& site, void* const* frames, int n) {
+		if (site.numFrames != n) return false;
+		for (int k = 0; k < n; k++) if (site.frames[k] != frames[k]) return false;
+		return true;
+	}
+
+	static void printFrame(void* address) {
+#ifdef ZORRO_HOT_PATH_SYMBOLS
+		static bool s_init = false;
+		HANDLE process = GetCurrentProcess();
+		if (!s_init) { SymInitialize(process, 0, TRUE); s_init = true; }
+		char buffer[sizeof(SYMBOL_INFO) + 256];
+		SYMBOL_INFO* symbol = reinterpret_cast<SYMBOL_INFO*>(buffer);
+		symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+		symbol->MaxNameLen = 255;
+		DWORD64 offset = 0;
+		if (SymFromAddr(process, reinterpret_cast<DWORD64>(address), &offset, symbol)) {
+			IMAGEHLP_LINE64 line;
+			line.SizeOfStruct = sizeof(line);
+			DWORD column = 0;
+			if (SymGetLineFromAddr64(process, reinterpret_cast<DWORD64>(address), &column, &line))
+				print(EPrintMode::TO_LOG, "\n  %s  %s(%u)", symbol->Name, line.FileName, static_cast<unsigned>(line.LineNumber));
+			else
+				print(EPrintMode::TO_LOG, "\n  %s+0x%x", symbol->Name, static_cast<unsigned>(offset));
+			return;
+		}
+#endif
+		print(EPrintMode::TO_LOG, "\n  %p", address);
+	}
+
+	std::atomic_flag m_lock;
+	SHotPathSite m_sites[ZORRO_HOT_PATH_SITES];
+	int m_numSites, m_reported;
+	long m_total;
+	int m_dropped;
+};
+
+inline CHotPathMonitor& hotPathMonitor()
+{
+	static CHotPathMonitor s_monitor;
+	return s_monitor;
+}
+
+class CHotPathScope
+{
+public:
+	explicit CHotPathScope(const char* scope) { hotPathMonitor().enter(scope); }
+	~CHotPathScope() { hotPathMonitor().leave(); }
+
+private:
+	CHotPathScope(const CHotPathScope&);
+	CHotPathScope& operator=(const CHotPathScope&);
+};
+} // namespace z
+
+#define ZORRO_HOT_PATH_SCOPE(name) ::z::CHotPathScope zorroHotPathScope(name)
+
+#else
+
+#define ZORRO_HOT_PATH_SCOPE(name) ((void)0)
+
+#endif // ZORRO_HOT_PATH_CHECK
+
+namespace z
+{
+// trade management function called in a hot path scope; without the check it only forwards
+template <int (*Function)()>
+int hotPathTMF()
+{
+	ZORRO_HOT_PATH_SCOPE("TMF");
+	return Function();
+}
+} // namespace z
+
+#endif // ZORRO_HOT_PATH_H_
@@ -0,0 +1,325 @@
+
+#ifndef ZORRO_INDICATORS_H_
+#define ZORRO_INDICATORS_H_
+
+#include <math.h>
+#include <vector>
+#include <utility>
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Streaming versions of the Ehlers filters from indicators.c.
+// Each object keeps its own state and is fed with one new value per bar by update(),
+// so it needs no series and no host call. Use one object per asset/algo component.
+// Like the host's series, the history is preset with the first value on the first update.
+
+// short input history x[0..N-1], newest first
+template <int N>
+class CHistory
+{
+public:
+	CHistory() : m_init(false) { for (int i = 0; i < N; i++) m_x[i] = 0; }
+
+	inline void push(var x) {
+		if (!m_init) {
+			for (int i = 0; i < N; i++) m_x[i] = x;
+			m_init = true;
+			return;
+		}
+		for (int i = N-1; i > 0; i--) m_x[i] = m_x[i-1];
+		m_x[0] = x;
+	}
+	inline var operator[](int i) const { return m_x[i]; }
+	inline bool initialized() const { return m_init; }
+
+private:
+	var m_x[N];
+	bool m_init;
+};
+
+// 2-pole low pass filter, LowPass(Data,Period)
+class CLowPass
+{
+public:
+	explicit CLowPass(int period = 20) { setPeriod(period); }
+
+	inline void setPeriod(int period) { m_a = 2./(1+period); }
+
+	inline var update(var x) {
+		bool first = !m_x.initialized();
+		m_x.push(x);
+		var a = m_a;
+		var y = first ? x : (a-0.25*a*a)*m_x[0] + 0.5*a*a*m_x[1] - (a-0.75*a*a)*m_x[2] + 2*(1.-a)*m_y[0] - (1.-a)*(1.-a)*m_y[1];
+		m_y.push(y);
+		return y;
+	}
+	inline var value() const { return m_y[0]; }
+
+private:
+	var m_a;
+	CHistory<3> m_x;
+	CHistory<2> m_y;
+};
+
+// 1-pole high pass filter, HighPass1(Data,Cutoff)
+class CHighPass1
+{
+public:
+	explicit CHighPass1(int cutoff = 20) : m_y(0) { setPeriod(cutoff); }
+
+	inline void setPeriod(int cutoff) {
+		var a = (0.707*2*PI)/cutoff;
+		m_alpha = 1.+(sin(a)-1.)/cos(a);
+	}
+
+	inline var update(var x) {
+		m_x.push(x);
+		return m_y = (1.-m_alpha/2.)*(m_x[0]-m_x[1]) + (1.-m_alpha)*m_y;
+	}
+	inline var value() const { return m_y; }
+
+private:
+	var m_alpha, m_y;
+	CHistory<2> m_x;
+};
+
+// 2-pole high pass filter, HighPass(Data,Cutoff) and HighPass2(Data,Cutoff)
+class CHighPass
+{
+public:
+	explicit CHighPass(int cutoff = 20) : m_y1(0), m_y2(0) { setPeriod(cutoff); }
+
+	inline void setPeriod(int cutoff) {
+		var a = (0.707*2*PI)/cutoff;
+		var alpha = 1.+(sin(a)-1.)/cos(a);
+		m_b = (1.-alpha/2.)*(1.-alpha/2.);
+		m_c = 1.-alpha;
+	}
+
+	inline var update(var x) {
+		m_x.push(x);
+		var y = m_b*(m_x[0]-2*m_x[1]+m_x[2]) + 2*m_c*m_y1 - m_c*m_c*m_y2;
+		m_y2 = m_y1;
+		return m_y1 = y;
+	}
+	inline var value() const { return m_y1; }
+
+private:
+	var m_b, m_c, m_y1, m_y2;
+	CHistory<3> m_x;
+};
+
+// band pass filter, BandPass(Data,Period,Delta)
+class CBandPass
+{
+public:
+	explicit CBandPass(int period = 20, var delta = 0.1) { setPeriod(period, delta); }
+
+	inline void setPeriod(int period, var delta) {
+		m_beta = cos(2*PI/period);
+		var gamma = 1./cos(4*PI*delta/period);
+		m_alpha = gamma - sqrt(gamma*gamma - 1.);
+	}
+
+	inline var update(var x) {
+		bool first = !m_x.initialized();
+		m_x.push(x);
+		var y = first ? x : 0.5*(1.-m_alpha)*(m_x[0]-m_x[2]) + m_beta*(1.+m_alpha)*m_y[0] - m_alpha*m_y[1];
+		m_y.push(y);
+		return y;
+	}
+	inline var value() const { return m_y[0]; }
+
+private:
+	var m_alpha, m_beta;
+	CHistory<3> m_x;
+	CHistory<2> m_y;
+};
+
+// 2-pole super smoother, Smooth(Data,Cutoff)
+class CSmooth
+{
+public:
+	explicit CSmooth(int cutoff = 10) { setPeriod(cutoff); }
+
+	inline void setPeriod(int cutoff) {
+		var f = (1.414*PI)/cutoff;
+		var a = exp(-f);
+		m_c2 = 2*a*cos(f);
+		m_c3 = -a*a;
+		m_c1 = 1.-m_c2-m_c3;
+	}
+
+	inline var update(var x) {
+		bool first = !m_x.initialized();
+		m_x.push(x);
+		var y = first ? x : m_c1*(m_x[0]+m_x[1])*0.5 + m_c2*m_y[0] + m_c3*m_y[1];
+		m_y.push(y);
+		return y;
+	}
+	inline var value() const { return m_y[0]; }
+
+private:
+	var m_c1, m_c2, m_c3;
+	CHistory<2> m_x;
+	CHistory<2> m_y;
+};
+
+// 3-pole Butterworth filter, Butterworth(Data,Cutoff)
+class CButterworth
+{
+public:
+	explicit CButterworth(int cutoff = 20) { setPeriod(cutoff); }
+
+	inline void setPeriod(int cutoff) {
+		var a = exp(-PI/cutoff);
+		var b = 2*a*cos(1.738*PI/cutoff);
+		var c = a*a;
+		m_c2 = b + c;
+		m_c3 = -(c + b*c);
+		m_c4 = c*c;
+		m_c1 = (1.-b+c)*(1.-c)/8.;
+	}
+
+	inline var update(var x) {
+		bool first = !m_x.initialized();
+		m_x.push(x);
+		var y = first ? x : m_c1*(m_x[0] + 3*m_x[1] + 3*m_x[2] + m_x[3]) + m_c2*m_y[0] + m_c3*m_y[1] + m_c4*m_y[2];
+		m_y.push(y);
+		return y;
+	}
+	inline var value() const { return m_y[0]; }
+
+private:
+	var m_c1, m_c2, m_c3, m_c4;
+	CHistory<4> m_x;
+	CHistory<3> m_y;
+};
+
+// decycler, Decycle(Data,Period): the data minus its 1-pole high pass
+class CDecycle
+{
+public:
+	explicit CDecycle(int period = 20) : m_hp(period), m_y(0) {}
+
+	inline void setPeriod(int period) { m_hp.setPeriod(period); }
+
+	inline var update(var x) { return m_y = x - m_hp.update(x); }
+	inline var value() const { return m_y; }
+
+private:
+	CHighPass1 m_hp;
+	var m_y;
+};
+
+// roofing filter, Roof(Data,CutoffLow,CutoffHigh): high pass followed by super smoother
+class CRoof
+{
+public:
+	CRoof(int cutoffLow = 10, int cutoffHigh = 48) : m_smooth(cutoffLow), m_hp(cutoffHigh) {}
+
+	inline void setPeriod(int cutoffLow, int cutoffHigh) { m_smooth.setPeriod(cutoffLow); m_hp.setPeriod(cutoffHigh); }
+
+	inline var update(var x) { return m_smooth.update(m_hp.update(x)); }
+	inline var value() const { return m_smooth.value(); }
+
+private:
+	CSmooth m_smooth;
+	CHighPass m_hp;
+};
+
+// 4-element Laguerre filter, Laguerre(Data,Alpha)
+class CLaguerre
+{
+public:
+	explicit CLaguerre(var alpha = 0.2) : m_alpha(alpha), m_init(false), m_y(0) { m_l[0] = m_l[1] = m_l[2] = m_l[3] = 0; }
+
+	inline void setAlpha(var alpha) { m_alpha = alpha; }
+
+	inline var update(var x) {
+		if (!m_init) {
+			m_l[0] = m_l[1] = m_l[2] = m_l[3] = x;
+			m_init = true;
+		}
+		var g1 = 1.-m_alpha;
+		var l0 = m_alpha*x + g1*m_l[0];
+		var l1 = -g1*l0 + m_l[0] + g1*m_l[1];
+		var l2 = -g1*l1 + m_l[1] + g1*m_l[2];
+		var l3 = -g1*l2 + m_l[2] + g1*m_l[3];
+		m_l[0] = l0; m_l[1] = l1; m_l[2] = l2; m_l[3] = l3;
+		return m_y = (l0 + 2*l1 + 2*l2 + l3)/6.;
+	}
+	inline var value() const { return m_y; }
+
+private:
+	var m_alpha;
+	bool m_init;
+	var m_y;
+	var m_l[4];
+};
+
+// sliding minimum and maximum over the last 'period' values, O(1) amortized per update.
+// The monotonic queues live in ring buffers that are allocated once, so update() never allocates.
+class CMinMax
+{
+	struct SQueue
+	{
+		std::vector<std::pair<int, var> > buf;
+		int head, size;
+		inline std::pair<int, var>& at(int i) { return buf[(head + i) % buf.size()]; }
+		inline const std::pair<int, var>& front() const { return buf[head]; }
+	};
+
+public:
+	explicit CMinMax(int period = 20) : m_period(period > 0 ? period : 1), m_n(0) {
+		m_min.buf.resize(m_period); m_min.head = 0; m_min.size = 0;
+		m_max.buf.resize(m_period); m_max.head = 0; m_max.size = 0;
+	}
+
+	inline void update(var x) {
+		push(m_min, x, true);
+		push(m_max, x, false);
+		m_n++;
+	}
+	inline var lowest() const { return m_min.front().second; }
+	inline var highest() const { return m_max.front().second; }
+
+private:
+	inline void push(SQueue& q, var x, bool isMin) {
+		const int n = static_cast<int>(q.buf.size());
+		if (q.size > 0 && q.front().first <= m_n - m_period) { q.head = (q.head + 1) % n; q.size--; }
+		while (q.size > 0 && (isMin ? q.at(q.size-1).second >= x : q.at(q.size-1).second <= x)) q.size--;
+		q.at(q.size++) = std::make_pair(m_n, x);
+	}
+
+	int m_period, m_n;
+	SQueue m_min, m_max;
+};
+
+// normalized Fisher transform, FisherN(Data,Period). Like the host, the position in the
+// Period range is smoothed first, Value = 0.66*((x-lo)/(hi-lo) - 0.5) + 0.67*Value[1], and
+// kept while the range is empty; the Fisher step clamps it to +-0.998.
+class CFisherN
+{
+public:
+	explicit CFisherN(int period = 500) : m_minMax(period), m_value(0), m_y(0) {}
+
+	inline var update(var x) {
+		m_minMax.update(x);
+		const var lo = m_minMax.lowest(), hi = m_minMax.highest();
+		if (hi > lo) m_value = 0.66*((x-lo)/(hi-lo) - 0.5) + 0.67*m_value;
+		var v = m_value;
+		if (v > 0.998) v = 0.998;
+		else if (v < -0.998) v = -0.998;
+		return m_y = 0.5*log((1.+v)/(1.-v));
+	}
+	inline var value() const { return m_y; }
+
+private:
+	CMinMax m_minMax;
+	var m_value, m_y;
+};
+} // namespace z
+
+#endif // ZORRO_INDICATORS_H_
@@ -0,0 +1,526 @@
+
+#ifndef ZORRO_LEARNER_H_
+#define ZORRO_LEARNER_H_
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "zorro/simd.h"
+#include "zorro/thread_pool.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Native DTREE and PERCEPTRON training for advise rules.
+// The samples are the signal arrays that go into adviseLong(method, objective, signals, numSignals)
+// together with the trade results. Like the host, the trainer captures the signals at advise
+// time, keeps them pending with the trade that is entered next, and labels them with the trade
+// result when the trade is closed. The components (f.i. asset x algo x long/short) are trained
+// in parallel on the thread pool (end a plain exported run() with zorroExitRun() to stop it
+// before the dll is unloaded). The trained rules are flat arrays without host calls, so
+// evaluate() takes a few nanoseconds; it returns -100..100 like the advise functions.
+//
+//   static z::CAdviseTrainer Trainer(EAdviseMode::DTREE);
+//   if (Trainer.advise(Component, Signals, 8) > 50 || Train)  // instead of adviseLong(DTREE, 0, Signals, 8)
+//     Trainer.open(Component, enterLong(TMF));
+//   int TMF() { if (TradeIsClosed) Trainer.close(ThisTrade); return 0; }  // labels the sample
+//   ...
+//   Trainer.train(); Trainer.save("Data\\MyStrategy.rul");
+//   // or directly: Trainer.add(Component, Signals, 8, Result);
+
+namespace learner_detail
+{
+	inline var dot(const var* a, const var* b, int n)
+	{
+		int i = 0;
+		var sum = 0;
+#if defined(ZORRO_SIMD_AVX2)
+		__m256d vs = _mm256_setzero_pd();
+		for (; i + 4 <= n; i += 4) vs = _mm256_add_pd(vs, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+		double lanes[4];
+		_mm256_storeu_pd(lanes, vs);
+		sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(ZORRO_SIMD_SSE2)
+		__m128d vs = _mm_setzero_pd();
+		for (; i + 2 <= n; i += 2) vs = _mm_add_pd(vs, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+		double lanes[2];
+		_mm_storeu_pd(lanes, vs);
+		sum = lanes[0] + lanes[1];
+#endif
+		for (; i < n; i++) sum += a[i]*b[i];
+		return sum;
+	}
+
+	// c[i] += s*x[i]
+	inline void addScaled(var* c, const var* x, var s, int n)
+	{
+		int i = 0;
+#if defined(ZORRO_SIMD_AVX2)
+		const __m256d vs = _mm256_set1_pd(s);
+		for (; i + 4 <= n; i += 4) _mm256_storeu_pd(c + i, _mm256_add_pd(_mm256_loadu_pd(c + i), _mm256_mul_pd(vs, _mm256_loadu_pd(x + i))));
+#elif defined(ZORRO_SIMD_SSE2)
+		const __m128d vs = _mm_set1_pd(s);
+		for (; i + 2 <= n; i += 2) _mm_storeu_pd(c + i, _mm_add_pd(_mm_loadu_pd(c + i), _mm_mul_pd(vs, _mm_loadu_pd(x + i))));
+#endif
+		for (; i < n; i++) c[i] += s*x[i];
+	}
+
+	inline var sigmoid(var x) { return 1./(1. + exp(-x)); }
+} // namespace learner_detail
+
+// training samples of one component, row-major
+struct SSampleSet
+{
+	int numSignals;
+	std::vector<var> signals;
+	std::vector<var> objectives;
+
+	SSampleSet() : numSignals(0) {}
+	inline int size() const { return static_cast<int>(objectives.size()); }
+	inline const var* row(int i) const { return &signals[static_cast<size_t>(i)*numSignals]; }
+
+	// +1 for winning samples, -1 for losing ones; BALANCED weights both sides equally
+	void targets(bool balanced, std::vector<var>& y, std::vector<var>& w) const {
+		int wins = 0;
+		for (int i = 0; i < size(); i++) if (objectives[i] > 0) wins++;
+		const int losses = size() - wins;
+		y.resize(size());
+		w.resize(size());
+		for (int i = 0; i < size(); i++) {
+			y[i] = objectives[i] > 0 ? 1. : -1.;
+			w[i] = !balanced || wins == 0 || losses == 0 ? 1. : 0.5*size()/(y[i] > 0 ? wins : losses);
+		}
+	}
+};
+
+///////////////////////////////////////////////////////
+// Regression tree on the sign of the objective, with histogram split finding.
+// Every signal is quantized once into at most 'Bins' quantile bins; a split then only needs one
+// pass over the node samples per signal instead of a sort.
+class CDecisionTree
+{
+public:
+	struct SNode
+	{
+		int signal;     // -1 for a leaf
+		var threshold;  // signal <= threshold goes left
+		int left, right;
+		var value;      // leaf result -100..100
+	};
+
+	enum { Bins = 32 };
+
+	CDecisionTree(int maxDepth = 6, int minLeaf = 10) : m_maxDepth(maxDepth), m_minLeaf(minLeaf) {}
+
+	void train(const SSampleSet& set, bool balanced) {
+		m_nodes.clear();
+		const int n = set.size(), m = set.numSignals;
+		if (n == 0) return;
+		set.targets(balanced, m_y, m_w);
+		// quantile bin edges per signal
+		m_edges.assign(m, std::vector<var>());
+		m_bins.resize(static_cast<size_t>(n)*m);
+		std::vector<var> column(n);
+		for (int s = 0; s < m; s++) {
+			for (int i = 0; i < n; i++) column[i] = set.row(i)[s];
+			std::sort(column.begin(), column.end());
+			std::vector<var>& edges = m_edges[s];
+			for (int b = 1; b < Bins; b++) {
+				var e = column[static_cast<size_t>(b)*(n-1)/Bins];
+				if (edges.empty() || e > edges.back()) edges.push_back(e);
+			}
+			for (int i = 0; i < n; i++)
+				m_bins[static_cast<size_t>(s)*n + i] = static_cast<unsigned char>(std::lower_bound(edges.begin(), edges.end(), set.row(i)[s]) - edges.begin());
+		}
+		m_index.resize(n);
+		for (int i = 0; i < n; i++) m_index[i] = i;
+		grow(0, n, 0, n);
+		m_bins.clear();
+		m_index.clear();
+	}
+
+	inline var evaluate(const var* signals) const {
+		if (m_nodes.empty()) return 0.;
+		const SNode* node = &m_nodes[0];
+		while (node->signal >= 0)
+			node = &m_nodes[signals[node->signal] <= node->threshold ? node->left : node->right];
+		return node->value;
+	}
+
+	inline const std::vector<SNode>& nodes() const { return m_nodes; }
+	inline std::vector<SNode>& nodes() { return m_nodes; }
+
+	// the tree as C code, like the host's rule files
+	void print(FILE* file, const char* name) const {
+		fprintf(file, "var %s(var* sig)\n{\n", name);
+		if (!m_nodes.empty()) printNode(file, 0, 1);
+		fprintf(file, "}\n");
+	}
+
+private:
+	int grow(int begin, int end, int depth, int total) {
+		const int id = static_cast<int>(m_nodes.size());
+		var sumW = 0, sumWY = 0;
+		for (int i = begin; i < end; i++) { sumW += m_w[m_index[i]]; sumWY += m_w[m_index[i]]*m_y[m_index[i]]; }
+		SNode leaf = { -1, 0., -1, -1, sumW > 0 ? 100.*sumWY/sumW : 0. };
+		m_nodes.push_back(leaf);
+		if (depth >= m_maxDepth || end - begin < 2*m_minLeaf) return id;
+
+		// best split per signal, in parallel for large nodes
+		const int m = static_cast<int>(m_edges.size());
+		std::vector<var> gains(m, 0.);
+		std::vector<int> splits(m, -1);
+		auto findSplit = [&](int s) {
+			var histW[Bins] = { 0 }, histWY[Bins] = { 0 };
+			int histN[Bins] = { 0 };
+			const unsigned char* bins = &m_bins[static_cast<size_t>(s)*total];
+			for (int i = begin; i < end; i++) {
+				const int k = m_index[i];
+				histW[bins[k]] += m_w[k];
+				histWY[bins[k]] += m_w[k]*m_y[k];
+				histN[bins[k]]++;
+			}
+			var w = 0, wy = 0;
+			int cnt = 0;
+			const var parent = sumWY*sumWY/sumW;
+			for (int b = 0; b < static_cast<int>(m_edges[s].size()); b++) {
+				w += histW[b]; wy += histWY[b]; cnt += histN[b];
+				if (cnt < m_minLeaf) continue;
+				if (end - begin - cnt < m_minLeaf) break;
+				const var gain = wy*wy/w + (sumWY - wy)*(sumWY - wy)/(sumW - w) - parent;
+				if (gain > gains[s] + 1e-12) { gains[s] = gain; splits[s] = b; }
+			}
+		};
+		if (static_cast<long>(end - begin)*m >= 1 << 16)
+			threadPool().parallelForEach(0, m, findSplit);
+		else
+			for (int s = 0; s < m; s++) findSplit(s);
+		int best = -1;
+		for (int s = 0; s < m; s++)
+			if (splits[s] >= 0 && (best < 0 || gains[s] > gains[best])) best = s;
+		if (best < 0) return id;
+
+		const int bin = splits[best];
+		const unsigned char* bins = &m_bins[static_cast<size_t>(best)*total];
+		const int mid = static_cast<int>(std::stable_partition(m_index.begin() + begin, m_index.begin() + end,
+			[bins, bin](int k) { return bins[k] <= bin; }) - m_index.begin());
+		m_nodes[id].signal = best;
+		m_nodes[id].threshold = m_edges[best][bin];
+		const int left = grow(begin, mid, depth+1, total);
+		m_nodes[id].left = left;
+		const int right = grow(mid, end, depth+1, total);
+		m_nodes[id].right = right;
+		return id;
+	}
+
+	void printNode(FILE* file, int id, int indent) const {
+		const SNode& node = m_nodes[id];
+		if (node.signal < 0) {
+			fprintf(file, "%*sreturn %.0f;\n", indent, "", node.value);
+			return;
+		}
+		fprintf(file, "%*sif(sig[%d] <= %.6g)\n", indent, "", node.signal, node.threshold);
+		printNode(file, node.left, indent+1);
+		fprintf(file, "%*selse\n", indent, "");
+		printNode(file, node.right, indent+1);
+	}
+
+	int m_maxDepth, m_minLeaf;
+	std::vector<SNode> m_nodes;
+	// training scratch
+	std::vector<std::vector<var> > m_edges;
+	std::vector<unsigned char> m_bins;   // signal-major bin numbers
+	std::vector<int> m_index;
+	std::vector<var> m_y, m_w;
+};
+
+///////////////////////////////////////////////////////
+// Logistic perceptron trained by mini-batch SGD on standardized signals.
+// The standardization is folded into the weights after training, so evaluate() is one dot product.
+class CPerceptron
+{
+public:
+	CPerceptron(int epochs = 30, int batch = 32, var rate = 0.5, var decay = 1e-4) :
+		m_epochs(epochs), m_batch(batch), m_rate(rate), m_decay(decay), m_bias(0) {}
+
+	void train(const SSampleSet& set, bool balanced) {
+		using namespace learner_detail;
+		const int n = set.size(), m = set.numSignals;
+		m_weights.assign(m, 0.);
+		m_bias = 0;
+		if (n == 0) return;
+		std::vector<var> y, w;
+		set.targets(balanced, y, w);
+
+		// standardized copy
+		TAlignedVars mean(m, 0.), scale(m, 0.), x(static_cast<size_t>(n)*m);
+		for (int i = 0; i < n; i++) addScaled(&mean[0], set.row(i), 1./n, m);
+		for (int i = 0; i < n; i++)
+			for (int s = 0; s < m; s++) { var d = set.row(i)[s] - mean[s]; scale[s] += d*d/n; }
+		for (int s = 0; s < m; s++) scale[s] = scale[s] > 0 ? 1./sqrt(scale[s]) : 0.;
+		for (int i = 0; i < n; i++)
+			for (int s = 0; s < m; s++) x[static_cast<size_t>(i)*m + s] = (set.row(i)[s] - mean[s])*scale[s];
+
+		// deterministic shuffles
+		std::vector<int> order(n);
+		for (int i = 0; i < n; i++) order[i] = i;
+		unsigned seed = 2463534242u;
+		TAlignedVars weights(m, 0.), grad(m);
+		var bias = 0;
+		const int batch = m_batch > 0 ? m_batch : 1;
+		for (int epoch = 0; epoch < m_epochs; epoch++) {
+			for (int i = n-1; i > 0; i--) {
+				seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+				std::swap(order[i], order[seed % (i+1)]);
+			}
+			const var rate = m_rate/(1. + epoch);
+			for (int b0 = 0; b0 < n; b0 += batch) {
+				const int b1 = b0 + batch < n ? b0 + batch : n;
+				std::fill(grad.begin(), grad.end(), 0.);
+				var gradBias = 0;
+				for (int j = b0; j < b1; j++) {
+					const int i = order[j];
+					const var* xi = &x[static_cast<size_t>(i)*m];
+					const var err = w[i]*(sigmoid(dot(&weights[0], xi, m) + bias) - (y[i] > 0 ? 1. : 0.));
+					addScaled(&grad[0], xi, err, m);
+					gradBias += err;
+				}
+				const var step = rate/(b1 - b0);
+				addScaled(&weights[0], &weights[0], -rate*m_decay, m);
+				addScaled(&weights[0], &grad[0], -step, m);
+				bias -= step*gradBias;
+			}
+		}
+		// fold the standardization into the rule
+		m_bias = bias;
+		for (int s = 0; s < m; s++) {
+			m_weights[s] = weights[s]*scale[s];
+			m_bias -= m_weights[s]*mean[s];
+		}
+	}
+
+	inline var evaluate(const var* signals) const {
+		if (m_weights.empty()) return 0.;
+		return 100.*(2.*learner_detail::sigmoid(learner_detail::dot(&m_weights[0], signals, static_cast<int>(m_weights.size())) + m_bias) - 1.);
+	}
+
+	inline const TAlignedVars& weights() const { return m_weights; }
+	inline TAlignedVars& weights() { return m_weights; }
+	inline var bias() const { return m_bias; }
+	inline void setBias(var bias) { m_bias = bias; }
+
+	void print(FILE* file, const char* name) const {
+		fprintf(file, "var %s(var* sig)\n{\n var x = %.6g", name, m_bias);
+		for (size_t s = 0; s < m_weights.size(); s++) fprintf(file, "%+.6g*sig[%d]", m_weights[s], static_cast<int>(s));
+		fprintf(file, ";\n return 100*(2/(1+exp(-x))-1);\n}\n");
+	}
+
+private:
+	int m_epochs, m_batch;
+	var m_rate, m_decay;
+	TAlignedVars m_weights;
+	var m_bias;
+};
+
+///////////////////////////////////////////////////////
+// Samples and rules of all components, trained in parallel.
+class CAdviseTrainer
+{
+	struct SHeader
+	{
+		char magic[4];
+		unsigned version, method, components;
+	};
+
+	// signals captured at advise time, waiting for the result of their trade
+	struct SPending
+	{
+		int component, trade;
+		std::vector<var> signals;
+	};
+
+public:
+	enum { MaxComponents = 1 << 16, MaxRecords = 1 << 24 };
+
+	explicit CAdviseTrainer(EAdviseMode method = EAdviseMode::DTREE) : m_method(method) {}
+
+	inline bool perceptron() const { return (m_method & EAdviseMode::PERCEPTRON) != 0; }
+	inline bool balanced() const { return (m_method & EAdviseMode::BALANCED) != 0; }
+
+	void add(int component, const var* signals, int numSignals, var objective) {
+		if (component < 0) return;
+		if (component >= components()) resize(component + 1);
+		SSampleSet& set = m_samples[component];
+		if (set.size() == 0) set.numSignals = numSignals;
+		if (numSignals != set.numSignals) return;
+		set.signals.insert(set.signals.end(), signals, signals + numSignals);
+		set.objectives.push_back(objective);
+	}
+
+	// captures the signals for the next trade of the component, and returns the rule result
+	var advise(int component, const var* signals, int numSignals) {
+		if (component < 0 || component >= MaxComponents) return 0.;
+		if (component >= static_cast<int>(m_captured.size())) m_captured.resize(component + 1);
+		m_captured[component].assign(signals, signals + numSignals);
+		return evaluate(component, signals);
+	}
+
+	// the trade entered after the last advise() of the component; the captured signals wait for its result
+	void open(int component, int tradeId) {
+		if (component < 0 || component >= static_cast<int>(m_captured.size()) || m_captured[component].empty()) return;
+		m_pending.push_back(SPending());
+		SPending& p = m_pending.back();
+		p.component = component;
+		p.trade = tradeId;
+		p.signals.swap(m_captured[component]);
+	}
+	inline void open(int component, const TRADE* trade) { if (trade) open(component, trade->nID); }
+
+	// labels the pending sample of a closed trade with its result; false when the trade has none
+	bool close(int tradeId, var result) {
+		for (size_t i = 0; i < m_pending.size(); i++) {
+			if (m_pending[i].trade != tradeId) continue;
+			SPending& p = m_pending[i];
+			add(p.component, &p.signals[0], static_cast<int>(p.signals.size()), result);
+			if (i + 1 < m_pending.size()) {
+				p.component = m_pending.back().component;
+				p.trade = m_pending.back().trade;
+				p.signals.swap(m_pending.back().signals);
+			}
+			m_pending.pop_back();
+			return true;
+		}
+		return false;
+	}
+	inline bool close(const TRADE* trade) { return trade ? close(trade->nID, trade->fResult) : false; }
+
+	// trades entered but not closed yet
+	inline int pending() const { return static_cast<int>(m_pending.size()); }
+
+	// trains every component, f.i. at the end of a WFO cycle; the samples are kept
+	void train() {
+		threadPool().parallelForEach(0, components(), [this](int c) {
+			if (perceptron()) m_perceptrons[c].train(m_samples[c], balanced());
+			else m_trees[c].train(m_samples[c], balanced());
+		});
+	}
+
+	// starts a new training cycle; pending trades still get their samples when they close
+	inline void clearSamples() {
+		for (int c = 0; c < components(); c++) m_samples[c] = SSampleSet();
+	}
+
+	inline var evaluate(int component, const var* signals) const {
+		if (component < 0 || component >= components()) return 0.;
+		return perceptron() ? m_perceptrons[component].evaluate(signals) : m_trees[component].evaluate(signals);
+	}
+
+	inline int components() const { return static_cast<int>(m_samples.size()); }
+	inline const SSampleSet& samples(int component) const { return m_samples[component]; }
+	inline const CDecisionTree& tree(int component) const { return m_trees[component]; }
+	inline const CPerceptron& perceptronRule(int component) const { return m_perceptrons[component]; }
+
+	void resize(int numComponents) {
+		m_samples.resize(numComponents);
+		m_trees.resize(numComponents);
+		m_perceptrons.resize(numComponents);
+	}
+
+	// rules as C functions named <prefix><component>
+	bool print(const char* filename, const char* prefix = "rule") const {
+		FILE* file = fopen(filename, "w");
+		if (!file) return false;
+		char name[64];
+		for (int c = 0; c < components(); c++) {
+			snprintf(name, sizeof(name), "%s%d", prefix, c);
+			if (perceptron()) m_perceptrons[c].print(file, name);
+			else m_trees[c].print(file, name);
+		}
+		fclose(file);
+		return true;
+	}
+
+	// binary rules: header, then per component the node or weight count and the records,
+	// with the node fields written one by one
+	bool save(const char* filename) const {
+		FILE* file = fopen(filename, "wb");
+		if (!file) return false;
+		SHeader h = { { 'Z', 'R', 'U', 'L' }, 2, static_cast<unsigned>(m_method), static_cast<unsigned>(components()) };
+		bool ok = fwrite(&h, sizeof(h), 1, file) == 1;
+		for (int c = 0; ok && c < components(); c++) {
+			if (perceptron()) {
+				const TAlignedVars& w = m_perceptrons[c].weights();
+				unsigned n = static_cast<unsigned>(w.size());
+				var bias = m_perceptrons[c].bias();
+				ok = fwrite(&n, sizeof(n), 1, file) == 1 && fwrite(&bias, sizeof(bias), 1, file) == 1 && (n == 0 || fwrite(&w[0], sizeof(var), n, file) == n);
+			} else {
+				const std::vector<CDecisionTree::SNode>& nodes = m_trees[c].nodes();
+				unsigned n = static_cast<unsigned>(nodes.size());
+				ok = fwrite(&n, sizeof(n), 1, file) == 1;
+				for (unsigned i = 0; ok && i < n; i++) ok = writeNode(file, nodes[i]);
+			}
+		}
+		fclose(file);
+		return ok;
+	}
+
+	bool load(const char* filename) {
+		FILE* file = fopen(filename, "rb");
+		if (!file) return false;
+		SHeader h;
+		bool ok = fread(&h, sizeof(h), 1, file) == 1 && h.magic[0] == 'Z' && h.magic[1] == 'R' && h.magic[2] == 'U' && h.magic[3] == 'L' && h.version == 2
+			&& h.components <= MaxComponents;
+		if (ok) {
+			m_method = static_cast<EAdviseMode>(h.method);
+			resize(static_cast<int>(h.components));
+			for (int c = 0; ok && c < components(); c++) {
+				unsigned n = 0;
+				ok = fread(&n, sizeof(n), 1, file) == 1 && n < MaxRecords;
+				if (!ok) break;
+				if (perceptron()) {
+					var bias = 0;
+					TAlignedVars& w = m_perceptrons[c].weights();
+					w.resize(n);
+					ok = fread(&bias, sizeof(bias), 1, file) == 1 && (n == 0 || fread(&w[0], sizeof(var), n, file) == n);
+					m_perceptrons[c].setBias(bias);
+				} else {
+					std::vector<CDecisionTree::SNode>& nodes = m_trees[c].nodes();
+					nodes.clear();
+					for (unsigned i = 0; ok && i < n; i++) {
+						CDecisionTree::SNode node;
+						// children come after their parent, so a damaged file cannot make evaluate() loop
+						ok = readNode(file, node) && (node.signal < 0 || (node.left > static_cast<int>(i) && node.left < static_cast<int>(n)
+							&& node.right > static_cast<int>(i) && node.right < static_cast<int>(n)));
+						if (ok) nodes.push_back(node);
+					}
+				}
+			}
+			if (!ok) resize(0);
+		}
+		fclose(file);
+		return ok;
+	}
+
+private:
+	static inline bool writeNode(FILE* file, const CDecisionTree::SNode& node) {
+		return fwrite(&node.signal, sizeof(int), 1, file) == 1 && fwrite(&node.threshold, sizeof(var), 1, file) == 1
+			&& fwrite(&node.left, sizeof(int), 1, file) == 1 && fwrite(&node.right, sizeof(int), 1, file) == 1
+			&& fwrite(&node.value, sizeof(var), 1, file) == 1;
+	}
+	static inline bool readNode(FILE* file, CDecisionTree::SNode& node) {
+		return fread(&node.signal, sizeof(int), 1, file) == 1 && fread(&node.threshold, sizeof(var), 1, file) == 1
+			&& fread(&node.left, sizeof(int), 1, file) == 1 && fread(&node.right, sizeof(int), 1, file) == 1
+			&& fread(&node.value, sizeof(var), 1, file) == 1;
+	}
+
+	EAdviseMode m_method;
+	std::vector<SSampleSet> m_samples;
+	std::vector<CDecisionTree> m_trees;
+	std::vector<CPerceptron> m_perceptrons;
+	std::vector<std::vector<var> > m_captured;
+	std::vector<SPending> m_pending;
+};
+} // namespace z
+
+#endif // ZORRO_LEARNER_H_
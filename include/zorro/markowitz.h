@@ -0,0 +1,436 @@
+
+#ifndef ZORRO_MARKOWITZ_H_
+#define ZORRO_MARKOWITZ_H_
+
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include <algorithm>
+#include "zorro/thread_pool.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Native mean-variance optimizer, compatible with markowitz(), markowitzReturn() and
+// markowitzVariance(): long only portfolios, weights summing to 1, per-asset caps.
+//
+// frontier() computes the whole efficient frontier in one call with the critical line
+// algorithm, a parametric active-set method that walks from the maximum return portfolio
+// (lambda = infinity) down to the minimum variance portfolio (lambda = 0) of the problem
+//   minimize 0.5*w'Cw - lambda*m'w  subject to  sum(w) = 1, 0 <= w[i] <= cap[i].
+// Between two turning points the weights are linear, so any frontier point is interpolated
+// exactly. The inverse of the free-asset covariance block is updated in O(free^2) when an
+// asset enters or leaves, which keeps 500+ asset universes within a few hundred milliseconds.
+//
+// optimize() solves a single lambda and starts from the active set of the previous call; when
+// the assets that were free, capped and unused at the last rebalance still give a valid
+// solution, this costs one factorization instead of a full walk.
+// Gradients of large universes run on the thread pool; end a plain exported run() with
+// zorroExitRun() when the optimizer is used.
+class CMarkowitz
+{
+public:
+	struct SPoint
+	{
+		var lambda, ret, variance;
+		std::vector<var> weights;
+	};
+
+	CMarkowitz() : m_n(0), m_lambda(0), m_warm(false) {}
+
+	// returns the variance of the frontier point with the best return/risk ratio like markowitz(),
+	// or 0 if the caps do not add up to 1. A cap <= 0 means no cap.
+	inline var frontier(const var* covMatrix, const var* means, int n, const var* caps) {
+		setData(covMatrix, means, n, caps, 0.);
+		return build();
+	}
+	inline var frontier(const var* covMatrix, const var* means, int n, var cap = 0.) {
+		setData(covMatrix, means, n, 0, cap);
+		return build();
+	}
+
+	inline int points() const { return static_cast<int>(m_points.size()); }
+	inline const SPoint& point(int i) const { return m_points[i]; }
+	inline int size() const { return m_n; }
+
+	// frontier point with the best return/risk ratio; returns its variance
+	var best(var* weights) const {
+		const int np = points();
+		if (np == 0) return 0.;
+		int bestSeg = 0;
+		var bestT = 0, bestRatio = -DBL_MAX;
+		for (int k = 0; k < np; k++) {
+			const SPoint& p = m_points[k];
+			if (p.variance > 0. && p.ret/sqrt(p.variance) > bestRatio) { bestRatio = p.ret/sqrt(p.variance); bestSeg = k; bestT = 0; }
+		}
+		for (int k = 0; k+1 < np; k++) {
+			var c1, c2;
+			segment(k, c1, c2);
+			// golden section search for the best ratio inside the segment
+			var lo = 0, hi = 1;
+			const var r = 0.6180339887498949;
+			for (int it = 0; it < 60; it++) {
+				var t1 = hi - r*(hi-lo), t2 = lo + r*(hi-lo);
+				if (ratio(k, t1, c1, c2) < ratio(k, t2, c1, c2)) lo = t1; else hi = t2;
+			}
+			var t = 0.5*(lo+hi), q = ratio(k, t, c1, c2);
+			if (q > bestRatio) { bestRatio = q; bestSeg = k; bestT = t; }
+		}
+		return interpolate(bestSeg, bestT, weights);
+	}
+
+	// frontier point with the given variance, clipped to the frontier; returns its return like markowitzReturn()
+	var returnAt(var* weights, var variance) const {
+		const int np = points();
+		if (np == 0) return 0.;
+		if (variance >= m_points[0].variance) { copyWeights(0, weights); return m_points[0].ret; }
+		for (int k = 0; k+1 < np; k++) {
+			const SPoint& p0 = m_points[k];
+			if (variance < m_points[k+1].variance) continue;
+			var c1, c2;
+			segment(k, c1, c2);
+			// variance(t) = v0 + 2*c1*t + c2*t^2 falls from p0 to p1
+			var c = p0.variance - variance, t;
+			if (c2 > 0.) {
+				var disc = c1*c1 - c2*c;
+				t = (-c1 - sqrt(disc > 0. ? disc : 0.))/c2;
+				if (t < 0. || t > 1.) t = (-c1 + sqrt(disc > 0. ? disc : 0.))/c2;
+			} else
+				t = c1 != 0. ? -c/(2*c1) : 0.;
+			if (t < 0.) t = 0.;
+			else if (t > 1.) t = 1.;
+			interpolate(k, t, weights);
+			return p0.ret + t*(m_points[k+1].ret - p0.ret);
+		}
+		copyWeights(np-1, weights);
+		return m_points[np-1].ret;
+	}
+
+	// frontier point with the given return, clipped to the frontier; returns its variance like markowitzVariance()
+	var varianceAt(var* weights, var ret) const {
+		const int np = points();
+		if (np == 0) return 0.;
+		if (ret >= m_points[0].ret) { copyWeights(0, weights); return m_points[0].variance; }
+		for (int k = 0; k+1 < np; k++) {
+			const SPoint& p0 = m_points[k];
+			const SPoint& p1 = m_points[k+1];
+			if (ret < p1.ret) continue;
+			var t = p0.ret > p1.ret ? (p0.ret - ret)/(p0.ret - p1.ret) : 0.;
+			return interpolate(k, t, weights);
+		}
+		copyWeights(np-1, weights);
+		return m_points[np-1].variance;
+	}
+
+	// single frontier point for a risk aversion lambda, warm started from the previous call;
+	// returns the variance or 0 if infeasible
+	inline var optimize(var* weights, const var* covMatrix, const var* means, int n, const var* caps, var lambda) {
+		return solve(weights, covMatrix, means, n, caps, 0., lambda);
+	}
+	inline var optimize(var* weights, const var* covMatrix, const var* means, int n, var cap, var lambda) {
+		return solve(weights, covMatrix, means, n, 0, cap, lambda);
+	}
+
+private:
+	enum EState { FREE, LOWER, UPPER };
+	enum { ParallelThreshold = 256 };
+
+	void setData(const var* cov, const var* means, int n, const var* caps, var cap) {
+		if (n != m_n) {
+			m_warm = false;
+			m_state.assign(n, LOWER);
+			m_inv.assign(n*n, 0.);
+			m_w.assign(n, 0.);
+			m_a.assign(n, 0.); m_b.assign(n, 0.); m_p.assign(n, 0.); m_q.assign(n, 0.);
+			m_h.assign(n, 0.); m_v.assign(n, 0.); m_u.assign(n, 0.);
+			m_A1.assign(n, 0.); m_Amu.assign(n, 0.); m_Ah.assign(n, 0.);
+		}
+		m_n = n;
+		m_cov.assign(cov, cov + n*n);
+		m_mean.assign(means, means + n);
+		m_cap.resize(n);
+		for (int i = 0; i < n; i++) {
+			var c = caps ? caps[i] : cap;
+			m_cap[i] = c > 0. && c < 1. ? c : 1.;
+		}
+	}
+
+	var build() {
+		m_points.clear();
+		if (!start()) return 0.;
+		walk(0., true);
+		m_warm = true;
+		return best(0);
+	}
+
+	var solve(var* weights, const var* cov, const var* means, int n, const var* caps, var cap, var lambda) {
+		const bool warm = m_warm && n == m_n;
+		setData(cov, means, n, caps, cap);
+		if (lambda < 0.) lambda = 0.;
+		if (!(warm && tryActiveSet(lambda))) {
+			if (!start()) { m_warm = false; return 0.; }
+			walk(lambda, false);
+		}
+		m_warm = true;
+		if (weights)
+			for (int i = 0; i < n; i++) weights[i] = m_w[i];
+		return quadForm(&m_w[0], &m_w[0]);
+	}
+
+	// maximum return portfolio: assets filled up to their caps in descending order of means
+	bool start() {
+		const int n = m_n;
+		std::vector<int> order(n);
+		for (int i = 0; i < n; i++) order[i] = i;
+		const std::vector<var>& mean = m_mean;
+		std::stable_sort(order.begin(), order.end(), [&mean](int a, int b) { return mean[a] > mean[b]; });
+		m_free.clear();
+		var rest = 1.;
+		int freeAsset = -1;
+		for (int k = 0; k < n; k++) {
+			int i = order[k];
+			if (freeAsset < 0 && rest > m_cap[i]) { m_w[i] = m_cap[i]; m_state[i] = UPPER; rest -= m_cap[i]; }
+			else if (freeAsset < 0) { m_w[i] = rest; m_state[i] = FREE; freeAsset = i; }
+			else { m_w[i] = 0.; m_state[i] = LOWER; }
+		}
+		if (freeAsset < 0) return false;
+		addFree(freeAsset);
+		m_lambda = DBL_MAX;
+		return true;
+	}
+
+	// previous free/capped/unused sets, accepted if they still satisfy all KKT conditions at lambda
+	bool tryActiveSet(var lambda) {
+		const int n = m_n;
+		m_free.clear();
+		for (int i = 0; i < n; i++) {
+			if (m_state[i] == UPPER) m_w[i] = m_cap[i];
+			else if (m_state[i] == LOWER) m_w[i] = 0.;
+		}
+		for (int i = 0; i < n; i++)
+			if (m_state[i] == FREE) addFree(i);
+		if (m_free.empty()) return false;
+		coefficients();
+		const int f = static_cast<int>(m_free.size());
+		const var tol = 1e-12;
+		for (int p = 0; p < f; p++) {
+			var w = m_a[p] + lambda*m_b[p];
+			if (w < -tol || w > m_cap[m_free[p]] + tol) return false;
+		}
+		gradients();
+		for (int i = 0; i < n; i++) {
+			if (m_state[i] == FREE) continue;
+			var g = m_p[i] + lambda*m_q[i];
+			var scale = tol*(1. + fabs(m_p[i]) + fabs(lambda*m_q[i]));
+			if (m_state[i] == LOWER ? g < -scale : g > scale) return false;
+		}
+		for (int p = 0; p < f; p++) m_w[m_free[p]] = m_a[p] + lambda*m_b[p];
+		m_lambda = lambda;
+		return true;
+	}
+
+	// moves lambda down to lambdaEnd through all turning points
+	void walk(var lambdaEnd, bool record) {
+		const int n = m_n;
+		var lambda = m_lambda;
+		if (record) addPoint(lambda);
+		int last = -1;
+		for (int iter = 0; iter < 4*n + 10; iter++) {
+			coefficients();
+			gradients();
+			const int f = static_cast<int>(m_free.size());
+			var bestL = -DBL_MAX, bound = 0;
+			int bestP = -1, bestI = -1, state = LOWER;
+			// a free asset reaches 0 or its cap
+			for (int p = 0; p < f && f > 1; p++) {
+				int i = m_free[p];
+				var b = m_b[p];
+				if (b == 0.) continue;
+				var l = b > 0. ? -m_a[p]/b : (m_cap[i] - m_a[p])/b;
+				if (l >= lambda || (i == last && l > lambda*(1.-1e-9))) continue;
+				if (l > bestL) { bestL = l; bestP = p; bestI = -1; bound = b > 0. ? 0. : m_cap[i]; state = b > 0. ? LOWER : UPPER; }
+			}
+			// an asset at a bound gets a zero multiplier and becomes free
+			for (int i = 0; i < n; i++) {
+				if (m_state[i] == FREE) continue;
+				var q = m_q[i];
+				if (m_state[i] == LOWER ? q <= 0. : q >= 0.) continue;
+				var l = -m_p[i]/q;
+				if (l >= lambda || (i == last && l > lambda*(1.-1e-9))) continue;
+				if (l > bestL) { bestL = l; bestI = i; bestP = -1; }
+			}
+			if (bestL <= lambdaEnd) {
+				for (int p = 0; p < f; p++) m_w[m_free[p]] = m_a[p] + lambdaEnd*m_b[p];
+				m_lambda = lambdaEnd;
+				if (record) addPoint(lambdaEnd);
+				return;
+			}
+			lambda = bestL;
+			for (int p = 0; p < f; p++) m_w[m_free[p]] = m_a[p] + lambda*m_b[p];
+			if (bestP >= 0) {
+				last = m_free[bestP];
+				removeFree(bestP, state, bound);
+			} else {
+				last = bestI;
+				addFree(bestI);
+			}
+			m_lambda = lambda;
+			if (record) addPoint(lambda);
+		}
+	}
+
+	// free weights w = a + lambda*b from the inverse of the free covariance block and the budget
+	void coefficients() {
+		const int n = m_n, f = static_cast<int>(m_free.size());
+		const var* C = &m_cov[0];
+		const var* A = &m_inv[0];
+		var s = 1.;
+		for (int j = 0; j < n; j++) if (m_state[j] == UPPER) s -= m_w[j];
+		for (int p = 0; p < f; p++) {
+			const var* row = C + m_free[p]*n;
+			var h = 0;
+			for (int j = 0; j < n; j++) if (m_state[j] == UPPER) h += row[j]*m_w[j];
+			m_h[p] = h;
+		}
+		var s1 = 0, smu = 0, sh = 0;
+		for (int p = 0; p < f; p++) {
+			const var* row = A + p*n;
+			var a1 = 0, amu = 0, ah = 0;
+			for (int q = 0; q < f; q++) { a1 += row[q]; amu += row[q]*m_mean[m_free[q]]; ah += row[q]*m_h[q]; }
+			m_A1[p] = a1; m_Amu[p] = amu; m_Ah[p] = ah;
+			s1 += a1; smu += amu; sh += ah;
+		}
+		m_gamma1 = smu/s1;
+		m_gamma0 = (-sh - s)/s1;
+		for (int p = 0; p < f; p++) {
+			m_a[p] = -m_Ah[p] - m_gamma0*m_A1[p];
+			m_b[p] = m_Amu[p] - m_gamma1*m_A1[p];
+		}
+	}
+
+	// multiplier g = p + lambda*q = (Cw - lambda*m + gamma)[i] of every asset at a bound
+	void gradients() {
+		const int n = m_n, f = static_cast<int>(m_free.size());
+		auto gradient = [this, n, f](int i) {
+			if (m_state[i] == FREE) return;
+			const var* row = &m_cov[i*n];
+			var p = m_gamma0, q = m_gamma1 - m_mean[i];
+			for (int k = 0; k < f; k++) { p += row[m_free[k]]*m_a[k]; q += row[m_free[k]]*m_b[k]; }
+			for (int j = 0; j < n; j++) if (m_state[j] == UPPER) p += row[j]*m_w[j];
+			m_p[i] = p; m_q[i] = q;
+		};
+		if (n < ParallelThreshold) {
+			for (int i = 0; i < n; i++) gradient(i);
+			return;
+		}
+		threadPool().parallelForEach(0, n, gradient, 16);
+	}
+
+	// bordered inverse update for a new free asset
+	void addFree(int i) {
+		const int n = m_n, f = static_cast<int>(m_free.size());
+		var* A = &m_inv[0];
+		for (int p = 0; p < f; p++) m_v[p] = m_cov[m_free[p]*n + i];
+		var d = m_cov[i*n + i];
+		for (int p = 0; p < f; p++) {
+			var u = 0;
+			for (int q = 0; q < f; q++) u += A[p*n + q]*m_v[q];
+			m_u[p] = u;
+			d -= m_v[p]*u;
+		}
+		// keep a singular covariance block invertible
+		var eps = 1e-12*m_cov[i*n + i];
+		if (d < eps) d = eps > 0. ? eps : 1e-20;
+		for (int p = 0; p < f; p++) {
+			for (int q = 0; q < f; q++) A[p*n + q] += m_u[p]*m_u[q]/d;
+			A[p*n + f] = A[f*n + p] = -m_u[p]/d;
+		}
+		A[f*n + f] = 1./d;
+		m_free.push_back(i);
+		m_state[i] = FREE;
+	}
+
+	// inverse downdate for a free asset that reaches a bound
+	void removeFree(int p, int state, var bound) {
+		const int n = m_n, last = static_cast<int>(m_free.size()) - 1;
+		var* A = &m_inv[0];
+		if (p != last) {
+			for (int q = 0; q <= last; q++) std::swap(A[p*n + q], A[last*n + q]);
+			for (int q = 0; q <= last; q++) std::swap(A[q*n + p], A[q*n + last]);
+			std::swap(m_free[p], m_free[last]);
+		}
+		var d = A[last*n + last];
+		for (int r = 0; r < last; r++)
+			for (int c = 0; c < last; c++)
+				A[r*n + c] -= A[r*n + last]*A[last*n + c]/d;
+		int i = m_free[last];
+		m_free.pop_back();
+		m_state[i] = state;
+		m_w[i] = bound;
+	}
+
+	void addPoint(var lambda) {
+		SPoint point;
+		point.lambda = lambda;
+		point.weights = m_w;
+		point.ret = 0;
+		for (int i = 0; i < m_n; i++) point.ret += m_mean[i]*m_w[i];
+		point.variance = quadForm(&m_w[0], &m_w[0]);
+		m_points.push_back(point);
+	}
+
+	inline var quadForm(const var* x, const var* y) const {
+		const int n = m_n;
+		var s = 0;
+		for (int i = 0; i < n; i++) {
+			if (x[i] == 0.) continue;
+			const var* row = &m_cov[i*n];
+			var r = 0;
+			for (int j = 0; j < n; j++) r += row[j]*y[j];
+			s += x[i]*r;
+		}
+		return s;
+	}
+
+	// variance(t) = v0 + 2*c1*t + c2*t^2 on the segment from point k to k+1
+	void segment(int k, var& c1, var& c2) const {
+		const std::vector<var>& w0 = m_points[k].weights;
+		const std::vector<var>& w1 = m_points[k+1].weights;
+		std::vector<var> d(m_n);
+		for (int i = 0; i < m_n; i++) d[i] = w1[i] - w0[i];
+		c1 = quadForm(&w0[0], &d[0]);
+		c2 = quadForm(&d[0], &d[0]);
+	}
+
+	inline var ratio(int k, var t, var c1, var c2) const {
+		var v = m_points[k].variance + 2*c1*t + c2*t*t;
+		var r = m_points[k].ret + t*(m_points[k+1].ret - m_points[k].ret);
+		return v > 0. ? r/sqrt(v) : -DBL_MAX;
+	}
+
+	// weights at t on segment k; returns the variance
+	var interpolate(int k, var t, var* weights) const {
+		if (t <= 0. || k+1 >= points()) { copyWeights(k, weights); return m_points[k].variance; }
+		std::vector<var> w(m_n);
+		for (int i = 0; i < m_n; i++) w[i] = m_points[k].weights[i] + t*(m_points[k+1].weights[i] - m_points[k].weights[i]);
+		if (weights)
+			for (int i = 0; i < m_n; i++) weights[i] = w[i];
+		return quadForm(&w[0], &w[0]);
+	}
+
+	inline void copyWeights(int k, var* weights) const {
+		if (weights)
+			for (int i = 0; i < m_n; i++) weights[i] = m_points[k].weights[i];
+	}
+
+	int m_n;
+	var m_lambda, m_gamma0, m_gamma1;
+	bool m_warm;
+	std::vector<var> m_cov, m_mean, m_cap, m_w, m_inv;
+	std::vector<var> m_a, m_b, m_p, m_q, m_h, m_v, m_u, m_A1, m_Amu, m_Ah;
+	std::vector<int> m_state, m_free;
+	std::vector<SPoint> m_points;
+};
+} // namespace z
+
+#endif // ZORRO_MARKOWITZ_H_
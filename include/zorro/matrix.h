@@ -0,0 +1,277 @@
+
+#ifndef ZORRO_MATRIX_H_
+#define ZORRO_MATRIX_H_
+
+#include <string.h>
+#include "zorro/simd.h"
+#include "zorro/arena.h"
+#include "zorro/thread_pool.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Native MATRIX kernels working on the host layout (rows, cols, total, row-major dat).
+// They replace matMul, matTrans, matAdd, matSub and matScale without host calls and without
+// allocating result matrices; the names differ from the host functions so both can be used.
+// Products are computed in cache blocks of packed B panels with SSE2/AVX2 row updates and are
+// spread over the thread pool for large matrices. Every element is summed in the same order on
+// all paths, so the results do not depend on the SIMD level or the number of threads.
+// Strategies with a plain exported run() must call zorroExitRun() at its end to stop the pool.
+// Result matrices must have the right size; they may be the same as an operand. Packed panels
+// and temporaries come from the thread arena, so the kernels don't touch the heap once it has grown.
+
+namespace matrix_detail
+{
+	enum { BlockK = 128, BlockN = 256, TileT = 32, ParallelWork = 64*64*64 };
+
+	// c[j] = c[j] + a0*b[j] for 4 rows at once; shares every load of b
+	inline void axpy4(var* c0, var* c1, var* c2, var* c3, const var* b, var a0, var a1, var a2, var a3, int n)
+	{
+		int j = 0;
+#if defined(ZORRO_SIMD_AVX2)
+		const __m256d va0 = _mm256_set1_pd(a0), va1 = _mm256_set1_pd(a1), va2 = _mm256_set1_pd(a2), va3 = _mm256_set1_pd(a3);
+		for (; j + 4 <= n; j += 4) {
+			__m256d vb = _mm256_loadu_pd(b + j);
+			_mm256_storeu_pd(c0 + j, _mm256_add_pd(_mm256_loadu_pd(c0 + j), _mm256_mul_pd(va0, vb)));
+			_mm256_storeu_pd(c1 + j, _mm256_add_pd(_mm256_loadu_pd(c1 + j), _mm256_mul_pd(va1, vb)));
+			_mm256_storeu_pd(c2 + j, _mm256_add_pd(_mm256_loadu_pd(c2 + j), _mm256_mul_pd(va2, vb)));
+			_mm256_storeu_pd(c3 + j, _mm256_add_pd(_mm256_loadu_pd(c3 + j), _mm256_mul_pd(va3, vb)));
+		}
+#elif defined(ZORRO_SIMD_SSE2)
+		const __m128d va0 = _mm_set1_pd(a0), va1 = _mm_set1_pd(a1), va2 = _mm_set1_pd(a2), va3 = _mm_set1_pd(a3);
+		for (; j + 2 <= n; j += 2) {
+			__m128d vb = _mm_loadu_pd(b + j);
+			_mm_storeu_pd(c0 + j, _mm_add_pd(_mm_loadu_pd(c0 + j), _mm_mul_pd(va0, vb)));
+			_mm_storeu_pd(c1 + j, _mm_add_pd(_mm_loadu_pd(c1 + j), _mm_mul_pd(va1, vb)));
+			_mm_storeu_pd(c2 + j, _mm_add_pd(_mm_loadu_pd(c2 + j), _mm_mul_pd(va2, vb)));
+			_mm_storeu_pd(c3 + j, _mm_add_pd(_mm_loadu_pd(c3 + j), _mm_mul_pd(va3, vb)));
+		}
+#endif
+		for (; j < n; j++) {
+			c0[j] += a0*b[j]; c1[j] += a1*b[j]; c2[j] += a2*b[j]; c3[j] += a3*b[j];
+		}
+	}
+
+	inline void axpy1(var* c, const var* b, var a, int n)
+	{
+		int j = 0;
+#if defined(ZORRO_SIMD_AVX2)
+		const __m256d va = _mm256_set1_pd(a);
+		for (; j + 4 <= n; j += 4)
+			_mm256_storeu_pd(c + j, _mm256_add_pd(_mm256_loadu_pd(c + j), _mm256_mul_pd(va, _mm256_loadu_pd(b + j))));
+#elif defined(ZORRO_SIMD_SSE2)
+		const __m128d va = _mm_set1_pd(a);
+		for (; j + 2 <= n; j += 2)
+			_mm_storeu_pd(c + j, _mm_add_pd(_mm_loadu_pd(c + j), _mm_mul_pd(va, _mm_loadu_pd(b + j))));
+#endif
+		for (; j < n; j++) c[j] += a*b[j];
+	}
+
+	// out[i] = alpha*a[i] + beta*b[i]
+	inline void axpby(var* out, const var* a, var alpha, const var* b, var beta, int n)
+	{
+		int i = 0;
+#if defined(ZORRO_SIMD_AVX2)
+		const __m256d va = _mm256_set1_pd(alpha), vb = _mm256_set1_pd(beta);
+		for (; i + 4 <= n; i += 4)
+			_mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_mul_pd(va, _mm256_loadu_pd(a + i)), _mm256_mul_pd(vb, _mm256_loadu_pd(b + i))));
+#elif defined(ZORRO_SIMD_SSE2)
+		const __m128d va = _mm_set1_pd(alpha), vb = _mm_set1_pd(beta);
+		for (; i + 2 <= n; i += 2)
+			_mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(va, _mm_loadu_pd(a + i)), _mm_mul_pd(vb, _mm_loadu_pd(b + i))));
+#endif
+		for (; i < n; i++) out[i] = alpha*a[i] + beta*b[i];
+	}
+
+	inline void scaleBy(var* out, var c, int n)
+	{
+		int i = 0;
+#if defined(ZORRO_SIMD_AVX2)
+		const __m256d vc = _mm256_set1_pd(c);
+		for (; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_mul_pd(vc, _mm256_loadu_pd(out + i)));
+#elif defined(ZORRO_SIMD_SSE2)
+		const __m128d vc = _mm_set1_pd(c);
+		for (; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_mul_pd(vc, _mm_loadu_pd(out + i)));
+#endif
+		for (; i < n; i++) out[i] *= c;
+	}
+
+	// out (cols x rows) = in' (in is rows x cols), in cache tiles
+	inline void transpose(var* out, const var* in, int rows, int cols)
+	{
+		for (int i0 = 0; i0 < rows; i0 += TileT)
+			for (int j0 = 0; j0 < cols; j0 += TileT)
+				for (int i = i0; i < i0 + TileT && i < rows; i++)
+					for (int j = j0; j < j0 + TileT && j < cols; j++)
+						out[j*rows + i] = in[i*cols + j];
+	}
+} // namespace matrix_detail
+
+// m = alpha*op(a)*op(b) + beta*m, op = transposed if 'transA'/'transB'; the fused form of matMul
+inline mat matMultiplyAdd(mat m, mat a, mat b, var alpha = 1., var beta = 0., bool transA = false, bool transB = false)
+{
+	using namespace matrix_detail;
+	const int M = transA ? a->cols : a->rows;
+	const int K = transA ? a->rows : a->cols;
+	const int N = transB ? b->rows : b->cols;
+	if (m->rows != M || m->cols != N || (transB ? b->cols : b->rows) != K) return m;
+
+	// products into an operand go through a temporary; scratch memory comes from the thread arena
+	CArenaScope scope(threadArena());
+	const bool alias = m->dat == a->dat || m->dat == b->dat;
+	var* C = m->dat;
+	if (alias) {
+		C = static_cast<var*>(threadArena().allocate(sizeof(var)*M*N, 32));
+		memcpy(C, m->dat, sizeof(var)*M*N);
+	}
+	if (beta == 0.) memset(C, 0, sizeof(var)*M*N);
+	else if (beta != 1.) scaleBy(C, beta, M*N);
+
+	// alpha is applied to the A elements, so op(a) is read element-wise
+	const var* A = a->dat;
+	const int lda = a->cols;
+	var* panel = static_cast<var*>(threadArena().allocate(sizeof(var)*BlockK*BlockN, 32));
+	const bool parallel = static_cast<double>(M)*N*K >= ParallelWork;
+	for (int k0 = 0; k0 < K; k0 += BlockK) {
+		const int kc = K - k0 < BlockK ? K - k0 : BlockK;
+		for (int j0 = 0; j0 < N; j0 += BlockN) {
+			const int nc = N - j0 < BlockN ? N - j0 : BlockN;
+			// pack the op(b) panel [k0,k0+kc) x [j0,j0+nc) row-major
+			var* P = panel;
+			for (int k = 0; k < kc; k++)
+				for (int j = 0; j < nc; j++)
+					P[k*nc + j] = transB ? b->dat[(j0+j)*b->cols + k0+k] : b->dat[(k0+k)*b->cols + j0+j];
+			auto rows = [=](int i0, int i1) {
+				int i = i0;
+				for (; i + 4 <= i1; i += 4) {
+					var* c0 = C + i*N + j0; var* c1 = c0 + N; var* c2 = c1 + N; var* c3 = c2 + N;
+					for (int k = 0; k < kc; k++) {
+						const int kk = k0 + k;
+						var a0 = transA ? A[kk*lda + i] : A[i*lda + kk];
+						var a1 = transA ? A[kk*lda + i+1] : A[(i+1)*lda + kk];
+						var a2 = transA ? A[kk*lda + i+2] : A[(i+2)*lda + kk];
+						var a3 = transA ? A[kk*lda + i+3] : A[(i+3)*lda + kk];
+						axpy4(c0, c1, c2, c3, P + k*nc, alpha*a0, alpha*a1, alpha*a2, alpha*a3, nc);
+					}
+				}
+				for (; i < i1; i++)
+					for (int k = 0; k < kc; k++) {
+						const int kk = k0 + k;
+						axpy1(C + i*N + j0, P + k*nc, alpha*(transA ? A[kk*lda + i] : A[i*lda + kk]), nc);
+					}
+			};
+			if (parallel) threadPool().parallelFor(0, M, rows, 16);
+			else rows(0, M);
+		}
+	}
+	if (alias) memcpy(m->dat, C, sizeof(var)*M*N);
+	return m;
+}
+
+// m = a*b, native matMul
+inline mat matMultiply(mat m, mat a, mat b)
+{
+	return matMultiplyAdd(m, a, b, 1., 0.);
+}
+
+// m = alpha*a + beta*b, native matAdd/matSub/matScale in one pass
+inline mat matAddScaled(mat m, mat a, var alpha, mat b, var beta)
+{
+	if (a->rows != m->rows || a->cols != m->cols || b->rows != m->rows || b->cols != m->cols) return m;
+	matrix_detail::axpby(m->dat, a->dat, alpha, b->dat, beta, m->rows*m->cols);
+	return m;
+}
+
+// m = c*m
+inline mat matScaleBy(mat m, var c)
+{
+	matrix_detail::scaleBy(m->dat, c, m->rows*m->cols);
+	return m;
+}
+
+// transposes m in place; square matrices swap tiles, others follow the permutation cycles
+inline mat matTranspose(mat m)
+{
+	using namespace matrix_detail;
+	const int rows = m->rows, cols = m->cols;
+	var* d = m->dat;
+	if (rows == cols) {
+		for (int i0 = 0; i0 < rows; i0 += TileT)
+			for (int j0 = i0; j0 < cols; j0 += TileT)
+				for (int i = i0; i < i0 + TileT && i < rows; i++)
+					for (int j = (j0 == i0 ? i+1 : j0); j < j0 + TileT && j < cols; j++) {
+						var t = d[i*cols + j]; d[i*cols + j] = d[j*cols + i]; d[j*cols + i] = t;
+					}
+	} else {
+		// element at position p = i*cols + j moves to j*rows + i = p*rows mod (total-1)
+		const int last = rows*cols - 1;
+		CArenaScope scope(threadArena());
+		unsigned char* done = threadArena().allocArray<unsigned char>(rows*cols);
+		memset(done, 0, rows*cols);
+		for (int start = 1; start < last; start++) {
+			if (done[start]) continue;
+			int p = start;
+			var v = d[p];
+			do {
+				int next = static_cast<int>(static_cast<long long>(p)*rows % last);
+				var t = d[next]; d[next] = v; v = t;
+				done[p] = 1;
+				p = next;
+			} while (p != start);
+		}
+		m->rows = cols;
+		m->cols = rows;
+	}
+	return m;
+}
+
+// m = a', native matTrans
+inline mat matTranspose(mat m, mat a)
+{
+	if (m->dat == a->dat) return matTranspose(m);
+	if (m->rows != a->cols || m->cols != a->rows) return m;
+	matrix_detail::transpose(m->dat, a->dat, a->rows, a->cols);
+	return m;
+}
+
+///////////////////////////////////////////////////////
+// Arena for temporary matrices.
+// matrix() hands out MATRIX objects from a CArena that is kept between bars; reset() - or
+// updateBar() once per bar - makes all of it available again, so temporaries are not
+// reallocated every bar. Matrices from the arena are valid until the next reset.
+class CMatrixArena
+{
+public:
+	explicit CMatrixArena(int chunk = 64*1024) : m_arena(sizeof(var)*chunk, "matrix arena"), m_used(0) {}
+
+	mat matrix(int rows, int cols = 1) {
+		if (cols <= 0) cols = 1;
+		const int n = rows*cols;
+		mat m = m_arena.allocArray<MATRIX>(1);
+		m->rows = rows;
+		m->cols = cols;
+		m->total = n;
+		m->dat = static_cast<var*>(m_arena.allocate(sizeof(var)*n, 32));
+		memset(m->dat, 0, sizeof(var)*n);
+		m_used++;
+		return m;
+	}
+
+	inline void reset() { m_arena.reset(); m_used = 0; }
+	// resets once per bar, for use at the start of run()
+	inline void updateBar() {
+		int resets = m_arena.resets();
+		m_arena.updateBar();
+		if (m_arena.resets() != resets) m_used = 0;
+	}
+
+	inline int count() const { return m_used; }
+	inline const CArena& arena() const { return m_arena; }
+
+private:
+	CArena m_arena;
+	int m_used;
+};
+} // namespace z
+
+#endif // ZORRO_MATRIX_H_
@@ -0,0 +1,549 @@
+
+#ifndef ZORRO_NEURAL_H_
+#define ZORRO_NEURAL_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "zorro/simd.h"
+#include "zorro/thread_pool.h"
+#include "zorro/arena.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Batched bridge for the neural() callback.
+// LEARN samples and TRAIN blobs go into preallocated row-major float matrices per model, so
+// training hands the whole data set to the backend without copies per sample. For prediction
+// the strategy fills the rows of all assets of a bar in place and runs one batch; the PREDICT
+// calls the host makes afterwards are answered from the batch results.
+//
+//   static z::CMlpBackend Mlp(16);
+//   static z::CNeuralBridge Bridge(Mlp, 256, 20);
+//   if (is(INITRUN)) Bridge.reserve(0, 50000, 8);   // optional, training matrix of model 0
+//   var CZorroEvents::neural(ENeuralMode mode, int model, int numSignals, const void* pData)
+//   { return Bridge.neural(mode, model, numSignals, pData); }
+//   ...
+//   float* Row = Bridge.queue(Model, 8);   // fill 8 signals, for every asset of the bar
+//   Bridge.flush();                        // one batched inference; then call advise as usual
+typedef std::vector<float, CAlignedAllocator<float> > TAlignedFloats;
+
+// Inference and training engine behind the bridge. predict() is called from several threads
+// at once for different rows and must not change the backend. flush() runs on the thread pool,
+// so a plain exported run() has to call zorroExitRun() at its end.
+class CNeuralBackend
+{
+public:
+	virtual ~CNeuralBackend() {}
+	virtual void train(int model, const float* x, const float* y, int rows, int cols) = 0;
+	virtual void predict(int model, const float* x, int rows, int cols, float* out) const = 0;
+	virtual bool save(FILE* file) const = 0;
+	virtual bool load(FILE* file) = 0;
+};
+
+namespace neural_detail
+{
+	// c[j] += a*b[j]
+	inline void axpy(float* c, const float* b, float a, int n)
+	{
+		int j = 0;
+#if defined(ZORRO_SIMD_AVX2)
+		const __m256 va = _mm256_set1_ps(a);
+		for (; j + 8 <= n; j += 8) _mm256_storeu_ps(c + j, _mm256_add_ps(_mm256_loadu_ps(c + j), _mm256_mul_ps(va, _mm256_loadu_ps(b + j))));
+#elif defined(ZORRO_SIMD_SSE2)
+		const __m128 va = _mm_set1_ps(a);
+		for (; j + 4 <= n; j += 4) _mm_storeu_ps(c + j, _mm_add_ps(_mm_loadu_ps(c + j), _mm_mul_ps(va, _mm_loadu_ps(b + j))));
+#endif
+		for (; j < n; j++) c[j] += a*b[j];
+	}
+
+	inline float dot(const float* a, const float* b, int n)
+	{
+		int j = 0;
+		float sum = 0;
+#if defined(ZORRO_SIMD_SSE2)
+		__m128 vs = _mm_setzero_ps();
+		for (; j + 4 <= n; j += 4) vs = _mm_add_ps(vs, _mm_mul_ps(_mm_loadu_ps(a + j), _mm_loadu_ps(b + j)));
+		float lanes[4];
+		_mm_storeu_ps(lanes, vs);
+		sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+		for (; j < n; j++) sum += a[j]*b[j];
+		return sum;
+	}
+
+	// rational tanh approximation, accurate to float precision; branch-free so the loops vectorize
+	inline float tanhApprox(float x)
+	{
+		x = x < -9.f ? -9.f : (x > 9.f ? 9.f : x);
+		const float x2 = x*x;
+		float p = -2.76076847742355e-16f;
+		p = p*x2 + 2.00018790482477e-13f;
+		p = p*x2 - 8.60467152213735e-11f;
+		p = p*x2 + 5.12229709037114e-08f;
+		p = p*x2 + 1.48572235717979e-05f;
+		p = p*x2 + 6.37261928875436e-04f;
+		p = p*x2 + 4.89352455891786e-03f;
+		float q = 1.19825839466702e-06f;
+		q = q*x2 + 1.18534705686654e-04f;
+		q = q*x2 + 2.26843463243900e-03f;
+		q = q*x2 + 4.89352518554385e-03f;
+		return x*p/q;
+	}
+
+	// c[j] += a0*b[j] for 4 rows at once; shares every load of b
+	inline void axpy4(float* c0, float* c1, float* c2, float* c3, const float* b, float a0, float a1, float a2, float a3, int n)
+	{
+		int j = 0;
+#if defined(ZORRO_SIMD_AVX2)
+		const __m256 va0 = _mm256_set1_ps(a0), va1 = _mm256_set1_ps(a1), va2 = _mm256_set1_ps(a2), va3 = _mm256_set1_ps(a3);
+		for (; j + 8 <= n; j += 8) {
+			__m256 vb = _mm256_loadu_ps(b + j);
+			_mm256_storeu_ps(c0 + j, _mm256_add_ps(_mm256_loadu_ps(c0 + j), _mm256_mul_ps(va0, vb)));
+			_mm256_storeu_ps(c1 + j, _mm256_add_ps(_mm256_loadu_ps(c1 + j), _mm256_mul_ps(va1, vb)));
+			_mm256_storeu_ps(c2 + j, _mm256_add_ps(_mm256_loadu_ps(c2 + j), _mm256_mul_ps(va2, vb)));
+			_mm256_storeu_ps(c3 + j, _mm256_add_ps(_mm256_loadu_ps(c3 + j), _mm256_mul_ps(va3, vb)));
+		}
+#elif defined(ZORRO_SIMD_SSE2)
+		const __m128 va0 = _mm_set1_ps(a0), va1 = _mm_set1_ps(a1), va2 = _mm_set1_ps(a2), va3 = _mm_set1_ps(a3);
+		for (; j + 4 <= n; j += 4) {
+			__m128 vb = _mm_loadu_ps(b + j);
+			_mm_storeu_ps(c0 + j, _mm_add_ps(_mm_loadu_ps(c0 + j), _mm_mul_ps(va0, vb)));
+			_mm_storeu_ps(c1 + j, _mm_add_ps(_mm_loadu_ps(c1 + j), _mm_mul_ps(va1, vb)));
+			_mm_storeu_ps(c2 + j, _mm_add_ps(_mm_loadu_ps(c2 + j), _mm_mul_ps(va2, vb)));
+			_mm_storeu_ps(c3 + j, _mm_add_ps(_mm_loadu_ps(c3 + j), _mm_mul_ps(va3, vb)));
+		}
+#endif
+		for (; j < n; j++) {
+			c0[j] += a0*b[j]; c1[j] += a1*b[j]; c2[j] += a2*b[j]; c3[j] += a3*b[j];
+		}
+	}
+
+	// h (rows x hidden) = tanh(x (rows x cols) * w (cols x hidden) + b), 4 rows per pass over w
+	inline void hiddenLayer(float* h, const float* x, const float* w, const float* b, int rows, int cols, int hidden)
+	{
+		for (int r = 0; r < rows; r++) memcpy(h + static_cast<size_t>(r)*hidden, b, hidden*sizeof(float));
+		int r = 0;
+		for (; r + 4 <= rows; r += 4) {
+			float* h0 = h + static_cast<size_t>(r)*hidden;
+			const float* x0 = x + static_cast<size_t>(r)*cols;
+			for (int k = 0; k < cols; k++)
+				axpy4(h0, h0 + hidden, h0 + 2*hidden, h0 + 3*hidden, w + static_cast<size_t>(k)*hidden, x0[k], x0[cols + k], x0[2*cols + k], x0[3*cols + k], hidden);
+		}
+		for (; r < rows; r++) {
+			float* hr = h + static_cast<size_t>(r)*hidden;
+			const float* xr = x + static_cast<size_t>(r)*cols;
+			for (int k = 0; k < cols; k++) axpy(hr, w + static_cast<size_t>(k)*hidden, xr[k], hidden);
+		}
+		for (size_t i = 0; i < static_cast<size_t>(rows)*hidden; i++) h[i] = tanhApprox(h[i]);
+	}
+} // namespace neural_detail
+
+///////////////////////////////////////////////////////
+// Tiny MLP backend: standardized inputs, one tanh hidden layer, linear output, trained on the
+// squared error by mini-batch SGD with momentum. Inference is a float GEMM on SSE2/AVX2.
+class CMlpBackend : public CNeuralBackend
+{
+	struct SModel
+	{
+		int cols;
+		TAlignedFloats mean, scale, w1, b1, w2;
+		float b2;
+		SModel() : cols(0), b2(0) {}
+	};
+
+public:
+	explicit CMlpBackend(int hidden = 16, int epochs = 50, int batch = 32, float rate = 0.05f) :
+		m_hidden(hidden), m_epochs(epochs), m_batch(batch), m_rate(rate) {}
+
+	virtual void train(int model, const float* x, const float* y, int rows, int cols) {
+		using namespace neural_detail;
+		if (model < 0 || rows <= 0 || cols <= 0) return;
+		if (model >= static_cast<int>(m_models.size())) m_models.resize(model + 1);
+		SModel& mdl = m_models[model];
+		const int H = m_hidden;
+		mdl.cols = cols;
+		mdl.mean.assign(cols, 0.f);
+		mdl.scale.assign(cols, 0.f);
+		for (int r = 0; r < rows; r++) axpy(&mdl.mean[0], x + static_cast<size_t>(r)*cols, 1.f/rows, cols);
+		for (int r = 0; r < rows; r++)
+			for (int k = 0; k < cols; k++) { float d = x[static_cast<size_t>(r)*cols + k] - mdl.mean[k]; mdl.scale[k] += d*d/rows; }
+		for (int k = 0; k < cols; k++) mdl.scale[k] = mdl.scale[k] > 0 ? 1.f/sqrtf(mdl.scale[k]) : 0.f;
+
+		// deterministic initialization
+		unsigned seed = 2463534242u + model;
+		mdl.w1.resize(static_cast<size_t>(cols)*H);
+		const float range = 1.f/sqrtf(static_cast<float>(cols));
+		for (size_t i = 0; i < mdl.w1.size(); i++) {
+			seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+			mdl.w1[i] = range*(2.f*(seed & 0xffff)/65535.f - 1.f);
+		}
+		mdl.b1.assign(H, 0.f);
+		mdl.w2.assign(H, 0.f);
+		mdl.b2 = 0;
+		for (int r = 0; r < rows; r++) mdl.b2 += y[r]/rows;
+
+		const int B = m_batch > 0 ? m_batch : 1;
+		TAlignedFloats xs(static_cast<size_t>(B)*cols), h(static_cast<size_t>(B)*H), dh(H);
+		TAlignedFloats gw1(mdl.w1.size()), gb1(H), gw2(H), vw1(mdl.w1.size(), 0.f), vb1(H, 0.f), vw2(H, 0.f);
+		float vb2 = 0;
+		std::vector<int> order(rows);
+		for (int r = 0; r < rows; r++) order[r] = r;
+		for (int epoch = 0; epoch < m_epochs; epoch++) {
+			for (int i = rows-1; i > 0; i--) {
+				seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+				int j = seed % (i+1);
+				int t = order[i]; order[i] = order[j]; order[j] = t;
+			}
+			const float rate = m_rate/(1.f + 0.05f*epoch);
+			for (int b0 = 0; b0 < rows; b0 += B) {
+				const int n = b0 + B < rows ? B : rows - b0;
+				for (int i = 0; i < n; i++) standardize(mdl, x + static_cast<size_t>(order[b0+i])*cols, &xs[static_cast<size_t>(i)*cols]);
+				hiddenLayer(&h[0], &xs[0], &mdl.w1[0], &mdl.b1[0], n, cols, H);
+				std::fill(gw1.begin(), gw1.end(), 0.f);
+				std::fill(gb1.begin(), gb1.end(), 0.f);
+				std::fill(gw2.begin(), gw2.end(), 0.f);
+				float gb2 = 0;
+				for (int i = 0; i < n; i++) {
+					const float* hi = &h[static_cast<size_t>(i)*H];
+					const float err = (dot(hi, &mdl.w2[0], H) + mdl.b2 - y[order[b0+i]])/n;
+					axpy(&gw2[0], hi, err, H);
+					gb2 += err;
+					for (int j = 0; j < H; j++) dh[j] = err*mdl.w2[j]*(1.f - hi[j]*hi[j]);
+					axpy(&gb1[0], &dh[0], 1.f, H);
+					const float* xi = &xs[static_cast<size_t>(i)*cols];
+					for (int k = 0; k < cols; k++) axpy(&gw1[static_cast<size_t>(k)*H], &dh[0], xi[k], H);
+				}
+				step(mdl.w1, vw1, gw1, rate);
+				step(mdl.b1, vb1, gb1, rate);
+				step(mdl.w2, vw2, gw2, rate);
+				vb2 = 0.9f*vb2 - rate*gb2;
+				mdl.b2 += vb2;
+			}
+		}
+	}
+
+	virtual void predict(int model, const float* x, int rows, int cols, float* out) const {
+		using namespace neural_detail;
+		if (model < 0 || model >= static_cast<int>(m_models.size()) || m_models[model].cols != cols) {
+			for (int r = 0; r < rows; r++) out[r] = 0;
+			return;
+		}
+		const SModel& mdl = m_models[model];
+		const int H = m_hidden;
+		enum { Block = 64 };
+		float xs[Block*64], h[Block*64];
+		if (cols > 64 || H > 64) {
+			// large models take the slow path without stack buffers
+			TAlignedFloats xv(cols), hv(H);
+			for (int r = 0; r < rows; r++) {
+				standardize(mdl, x + static_cast<size_t>(r)*cols, &xv[0]);
+				hiddenLayer(&hv[0], &xv[0], &mdl.w1[0], &mdl.b1[0], 1, cols, H);
+				out[r] = dot(&hv[0], &mdl.w2[0], H) + mdl.b2;
+			}
+			return;
+		}
+		for (int r0 = 0; r0 < rows; r0 += Block) {
+			const int n = r0 + Block < rows ? Block : rows - r0;
+			for (int i = 0; i < n; i++) standardize(mdl, x + static_cast<size_t>(r0+i)*cols, xs + i*cols);
+			hiddenLayer(h, xs, &mdl.w1[0], &mdl.b1[0], n, cols, H);
+			for (int i = 0; i < n; i++) out[r0+i] = dot(h + i*H, &mdl.w2[0], H) + mdl.b2;
+		}
+	}
+
+	virtual bool save(FILE* file) const {
+		int header[2] = { static_cast<int>(m_models.size()), m_hidden };
+		bool ok = fwrite(header, sizeof(header), 1, file) == 1;
+		for (size_t m = 0; ok && m < m_models.size(); m++) {
+			const SModel& mdl = m_models[m];
+			ok = fwrite(&mdl.cols, sizeof(int), 1, file) == 1 && fwrite(&mdl.b2, sizeof(float), 1, file) == 1;
+			if (ok && mdl.cols > 0)
+				ok = write(file, mdl.mean) && write(file, mdl.scale) && write(file, mdl.w1) && write(file, mdl.b1) && write(file, mdl.w2);
+		}
+		return ok;
+	}
+
+	// limits for loaded files, so that a damaged header can't trigger huge allocations
+	enum { MaxModels = 1 << 16, MaxHidden = 1 << 12, MaxCols = 1 << 16, MaxWeights = 1 << 26 };
+
+	virtual bool load(FILE* file) {
+		int header[2];
+		if (fread(header, sizeof(header), 1, file) != 1 || header[0] < 0 || header[0] > MaxModels
+			|| header[1] <= 0 || header[1] > MaxHidden) return false;
+		const int hidden = m_hidden;
+		m_hidden = header[1];
+		m_models.assign(header[0], SModel());
+		bool ok = true;
+		for (size_t m = 0; ok && m < m_models.size(); m++) {
+			SModel& mdl = m_models[m];
+			ok = fread(&mdl.cols, sizeof(int), 1, file) == 1 && fread(&mdl.b2, sizeof(float), 1, file) == 1
+				&& mdl.cols >= 0 && mdl.cols <= MaxCols && static_cast<long long>(mdl.cols)*m_hidden <= MaxWeights;
+			if (ok && mdl.cols > 0)
+				ok = read(file, mdl.mean, mdl.cols) && read(file, mdl.scale, mdl.cols) && read(file, mdl.w1, static_cast<size_t>(mdl.cols)*m_hidden)
+					&& read(file, mdl.b1, m_hidden) && read(file, mdl.w2, m_hidden);
+		}
+		if (!ok) {
+			m_models.clear();
+			m_hidden = hidden;
+		}
+		return ok;
+	}
+
+	inline int hidden() const { return m_hidden; }
+
+private:
+	static inline void standardize(const SModel& mdl, const float* x, float* out) {
+		for (int k = 0; k < mdl.cols; k++) out[k] = (x[k] - mdl.mean[k])*mdl.scale[k];
+	}
+	static inline void step(TAlignedFloats& w, TAlignedFloats& v, const TAlignedFloats& grad, float rate) {
+		for (size_t i = 0; i < w.size(); i++) {
+			v[i] = 0.9f*v[i] - rate*grad[i];
+			w[i] += v[i];
+		}
+	}
+	static inline bool write(FILE* file, const TAlignedFloats& v) {
+		return fwrite(&v[0], sizeof(float), v.size(), file) == v.size();
+	}
+	static inline bool read(FILE* file, TAlignedFloats& v, size_t n) {
+		v.resize(n);
+		return fread(&v[0], sizeof(float), n, file) == n;
+	}
+
+	int m_hidden, m_epochs, m_batch;
+	float m_rate;
+	std::vector<SModel> m_models;
+};
+
+///////////////////////////////////////////////////////
+class CNeuralBridge
+{
+	// training matrix of one model: signals row-major, objectives separately; 'x' and 'y' are
+	// allocated for the capacity, the first 'rows' rows are used
+	struct STrainSet
+	{
+		int cols, rows;
+		TAlignedFloats x, y;
+		STrainSet() : cols(0), rows(0) {}
+		inline int capacity() const { return static_cast<int>(y.size()); }
+	};
+
+public:
+	// 'trainRows' is the initial training capacity of a model, allocated with its first sample
+	CNeuralBridge(CNeuralBackend& backend, int maxRows = 256, int maxSignals = 20, int trainRows = 4096) :
+		m_backend(backend), m_maxRows(maxRows), m_maxSignals(maxSignals), m_trainRows(trainRows > 0 ? trainRows : 1), m_rows(0), m_bar(-1), m_cycle(-1),
+		m_batch(static_cast<size_t>(maxRows)*maxSignals), m_models(maxRows), m_cols(maxRows), m_starts(maxRows + 1), m_results(maxRows), m_done(false) {}
+
+	// the neural() callback
+	var neural(ENeuralMode mode, int model, int numSignals, const void* pData) {
+		switch (mode) {
+		case ENeuralMode::INIT:
+			return 1;
+		case ENeuralMode::EXIT:
+			for (size_t m = 0; m < m_sets.size(); m++) m_sets[m].rows = 0;
+			return 1;
+		case ENeuralMode::LEARN:
+			// signals followed by the objective
+			learn(model, static_cast<const var*>(pData), numSignals);
+			return 1;
+		case ENeuralMode::TRAIN:
+			if (pData) parse(model, static_cast<const char*>(pData), numSignals);
+			return train(model) ? 1 : 0;
+		case ENeuralMode::PREDICT:
+			return predict(model, static_cast<const var*>(pData), numSignals);
+		case ENeuralMode::SAVE:
+			return save(static_cast<const char*>(pData)) ? 1 : 0;
+		case ENeuralMode::LOAD:
+			return load(static_cast<const char*>(pData)) ? 1 : 0;
+		default:
+			return 0;
+		}
+	}
+
+	// row of the prediction batch for this bar, to be filled with 'numSignals' values
+	float* queue(int model, int numSignals) {
+		newBar();
+		if (m_rows >= m_maxRows || numSignals > m_maxSignals) return 0;
+		const int r = m_rows++;
+		m_models[r] = model;
+		m_cols[r] = numSignals;
+		m_done = false;
+		return &m_batch[static_cast<size_t>(r)*m_maxSignals];
+	}
+	inline float* queue(int model, const var* signals, int numSignals) {
+		float* row = queue(model, numSignals);
+		if (row) for (int k = 0; k < numSignals; k++) row[k] = static_cast<float>(signals[k]);
+		return row;
+	}
+
+	// predicts all queued rows; runs of the same model go to the backend in batches of up to 'Chunk' rows
+	void flush() {
+		if (m_done || m_rows == 0) return;
+		int runs = 0;
+		for (int r = 0; r < m_rows; r++)
+			if (r == 0 || m_models[r] != m_models[r-1] || m_cols[r] != m_cols[r-1] || r - m_starts[runs-1] >= Chunk) m_starts[runs++] = r;
+		m_starts[runs] = m_rows;
+		threadPool().parallelForEach(0, runs, [this](int i) {
+			const int r0 = m_starts[i], r1 = m_starts[i+1], cols = m_cols[r0];
+			// the batch rows have a stride of m_maxSignals, so pack them when the model is narrower
+			if (cols == m_maxSignals)
+				m_backend.predict(m_models[r0], &m_batch[static_cast<size_t>(r0)*m_maxSignals], r1 - r0, cols, &m_results[r0]);
+			else {
+				CArenaScope scope(threadArena());
+				float* packed = threadArena().allocArray<float>(static_cast<size_t>(r1 - r0)*cols);
+				for (int r = r0; r < r1; r++) memcpy(packed + static_cast<size_t>(r - r0)*cols, &m_batch[static_cast<size_t>(r)*m_maxSignals], cols*sizeof(float));
+				m_backend.predict(m_models[r0], packed, r1 - r0, cols, &m_results[r0]);
+			}
+		});
+		m_done = true;
+	}
+
+	inline int rows() const { return m_rows; }
+	inline var result(int row) const { return row >= 0 && row < m_rows ? m_results[row] : 0.; }
+
+	// single prediction; answered from the batch when the same row was queued this bar
+	var predict(int model, const var* signals, int numSignals) {
+		newBar();
+		flush();
+		if (m_done)
+			for (int r = 0; r < m_rows; r++) {
+				if (m_models[r] != model || m_cols[r] != numSignals) continue;
+				const float* row = &m_batch[static_cast<size_t>(r)*m_maxSignals];
+				int k = 0;
+				while (k < numSignals && row[k] == static_cast<float>(signals[k])) k++;
+				if (k == numSignals) return m_results[r];
+			}
+		float x[64], out = 0;
+		if (numSignals > 64) return 0.;
+		for (int k = 0; k < numSignals; k++) x[k] = static_cast<float>(signals[k]);
+		m_backend.predict(model, x, 1, numSignals, &out);
+		return out;
+	}
+
+	// allocates the training matrix of a model for 'rows' samples of 'cols' signals;
+	// samples already collected with the same width are kept
+	void reserve(int model, int rows, int cols) {
+		if (model < 0 || rows <= 0 || cols <= 0) return;
+		STrainSet& set = trainSet(model);
+		if (set.cols != cols) set.rows = 0;
+		resize(set, (std::max)(rows, set.capacity()), cols);
+	}
+
+	void learn(int model, const var* sample, int numSignals) {
+		if (model < 0 || !sample) return;
+		float* row = append(model, numSignals, static_cast<float>(sample[numSignals]));
+		if (row) for (int k = 0; k < numSignals; k++) row[k] = static_cast<float>(sample[k]);
+	}
+
+	// trains one model, or all models when 'model' is negative
+	bool train(int model) {
+		if (model >= 0) {
+			if (model >= static_cast<int>(m_sets.size()) || m_sets[model].rows == 0) return false;
+			STrainSet& set = m_sets[model];
+			m_backend.train(model, &set.x[0], &set.y[0], set.rows, set.cols);
+			return true;
+		}
+		bool ok = false;
+		for (int m = 0; m < static_cast<int>(m_sets.size()); m++) ok = train(m) || ok;
+		return ok;
+	}
+
+	inline int samples(int model) const {
+		return model >= 0 && model < static_cast<int>(m_sets.size()) ? m_sets[model].rows : 0;
+	}
+
+	bool save(const char* filename) const {
+		FILE* file = filename ? fopen(filename, "wb") : 0;
+		if (!file) return false;
+		bool ok = m_backend.save(file);
+		fclose(file);
+		return ok;
+	}
+	bool load(const char* filename) {
+		FILE* file = filename ? fopen(filename, "rb") : 0;
+		if (!file) return false;
+		bool ok = m_backend.load(file);
+		fclose(file);
+		return ok;
+	}
+
+private:
+	enum { Chunk = 64 };
+
+	inline void newBar() {
+		if (!g || (g->nBar == m_bar && g->nTotalCycle == m_cycle)) return;
+		m_bar = g->nBar;
+		m_cycle = g->nTotalCycle;
+		m_rows = 0;
+		m_done = false;
+	}
+
+	inline STrainSet& trainSet(int model) {
+		if (model >= static_cast<int>(m_sets.size())) m_sets.resize(model + 1);
+		return m_sets[model];
+	}
+
+	static inline void resize(STrainSet& set, int rows, int cols) {
+		set.cols = cols;
+		set.x.resize(static_cast<size_t>(rows)*cols);
+		set.y.resize(rows);
+	}
+
+	// next free row of the training matrix with its objective, 0 when the width does not match;
+	// the capacity doubles when it is exhausted
+	float* append(int model, int cols, float objective) {
+		STrainSet& set = trainSet(model);
+		if (cols <= 0 || (set.rows > 0 && set.cols != cols)) return 0;
+		if (set.cols != cols || set.rows >= set.capacity())
+			resize(set, set.rows < set.capacity() ? set.capacity() : set.capacity() > 0 ? 2*set.capacity() : m_trainRows, cols);
+		set.y[set.rows] = objective;
+		return &set.x[static_cast<size_t>(set.rows++)*cols];
+	}
+
+	// CSV lines of signals and objective, read in place; lines that are not numbers are skipped.
+	// The matrix is sized for all lines up front when the width is known.
+	void parse(int model, const char* text, int numSignals) {
+		if (model < 0) return;
+		STrainSet& set = trainSet(model);
+		const int cols = set.rows > 0 ? set.cols : numSignals;
+		if (cols > 0) {
+			int lines = 1;
+			for (const char* p = text; *p; p++) lines += *p == '\n';
+			reserve(model, set.rows + lines, cols);
+		}
+		float row[65];
+		while (*text) {
+			int n = 0;
+			const char* p = text;
+			while (*p && *p != '\n') {
+				char* end;
+				double v = strtod(p, &end);
+				if (end == p) { n = -1; break; }
+				if (n < 65) row[n] = static_cast<float>(v);
+				n++;
+				p = end;
+				while (*p == ',' || *p == ';' || *p == ' ' || *p == '\t' || *p == '\r') p++;
+			}
+			while (*p && *p != '\n') p++;
+			if (*p) p++;
+			text = p;
+			if (n < 2 || n > 65 || (numSignals > 0 && n != numSignals + 1)) continue;
+			float* dst = append(model, n - 1, row[n - 1]);
+			if (dst) memcpy(dst, row, (n - 1)*sizeof(float));
+		}
+	}
+
+	CNeuralBackend& m_backend;
+	int m_maxRows, m_maxSignals, m_trainRows, m_rows;
+	int m_bar, m_cycle;
+	TAlignedFloats m_batch;
+	std::vector<int> m_models, m_cols, m_starts;
+	std::vector<float> m_results;
+	bool m_done;
+	std::vector<STrainSet> m_sets;
+};
+} // namespace z
+
+#endif // ZORRO_NEURAL_H_
@@ -0,0 +1,214 @@
+
+#ifndef ZORRO_OBJECTIVE_H_
+#define ZORRO_OBJECTIVE_H_
+
+#include <math.h>
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Optimize objectives computed from the PERFORMANCE struct,
+// f.i. return z::objectiveSharpe(g->w); in objective()
+
+// approximate number of bars per year at the current bar period
+inline var barsPerYear()
+{
+	return 252. * 1440. / (g->vBarPeriod > 0 ? g->vBarPeriod : 1440.);
+}
+
+// pessimistic return ratio, same formula as objectivePRR()
+inline var objectivePRR(int numWin, int numLoss, var win, var loss, var winMax, var lossMax)
+{
+	if (!numWin && !numLoss) return 0.;
+	var wFac = 1./sqrt(1.+numWin);
+	var lFac = 1./sqrt(1.+numLoss);
+	// remove single outliers
+	if (numWin > 2) win -= (numWin-2)*winMax/numWin;
+	if (numLoss > 2) loss -= (numLoss-2)*lossMax/numLoss;
+	return (1.-wFac)/(1.+lFac)*(1.+win)/(1.+loss);
+}
+
+inline var objectivePRR(const PERFORMANCE& p)
+{
+	return objectivePRR(p.numWin, p.numLoss, p.vWin, p.vLoss, p.vWinMax, p.vLossMax);
+}
+
+// annualized Sharpe ratio of the bar returns
+inline var objectiveSharpe(const PERFORMANCE& p, var periods = 0)
+{
+	if (p.vStdDev <= 0.) return 0.;
+	return p.vMean/p.vStdDev * sqrt(periods > 0 ? periods : barsPerYear());
+}
+
+// annualized Sortino ratio of the bar returns. PERFORMANCE holds no downside statistics, so the
+// downside deviation below 0 is the one of normally distributed returns with vMean and vStdDev;
+// CObjectiveTracker::sortino() measures it from the returns.
+inline var objectiveSortino(const PERFORMANCE& p, var periods = 0)
+{
+	if (p.vStdDev <= 0.) return 0.;
+	const var m = p.vMean, s = p.vStdDev, z = m/s;
+	// E[min(r,0)^2] = (m^2+s^2)*Phi(-z) - m*s*phi(z)
+	const var down2 = (m*m + s*s)*0.5*erfc(z/sqrt(2.)) - m*s*exp(-0.5*z*z)/sqrt(2.*PI);
+	if (down2 <= 0.) return 0.;
+	return m/sqrt(down2) * sqrt(periods > 0 ? periods : barsPerYear());
+}
+
+// annualized return in percent divided by the ulcer index (Martin ratio)
+inline var objectiveUlcer(const PERFORMANCE& p, var periods = 0)
+{
+	if (p.vUlcer <= 0.) return 0.;
+	return 100. * p.vMean * (periods > 0 ? periods : barsPerYear()) / p.vUlcer;
+}
+
+// coefficient of determination of the equity curve, weighted with its sign
+inline var objectiveR2(const PERFORMANCE& p)
+{
+	return (p.vWin > p.vLoss) ? p.vR2 : -p.vR2;
+}
+
+///////////////////////////////////////////////////////
+// Streaming objective accumulator.
+// Call addBar() with the equity once per bar and addTrade() with each closed trade result.
+// All objectives are then available during the run, which allows aborting a hopeless
+// optimize step as soon as an upper bound of its objective falls below the best previous step.
+class CObjectiveTracker
+{
+public:
+	CObjectiveTracker() : m_best(-1e300), m_bestParCycle(-1), m_bestWFOCycle(-1) { reset(); }
+
+	void reset() {
+		m_numBars = 0; m_lastEquity = 0; m_capital = 0;
+		m_mean = 0; m_m2 = 0; m_down2 = 0;
+		m_peak = 0; m_ulcer2 = 0;
+		m_sx = 0; m_sy = 0; m_sxx = 0; m_syy = 0; m_sxy = 0;
+		m_numWin = 0; m_numLoss = 0; m_win = 0; m_loss = 0; m_winMax = 0; m_lossMax = 0;
+		m_aborted = false; m_abortBound = 0;
+	}
+
+	// equity is the strategy profit in account currency, f.i. ProfitClosed+ProfitOpen;
+	// capital is the base for percent returns and drawdowns (default: Capital)
+	void addBar(var equity, var capital = 0) {
+		if (m_numBars == 0) {
+			m_capital = capital > 0 ? capital : (g->vCapital > 0 ? g->vCapital : 1.);
+			m_peak = equity;
+		} else {
+			var r = (equity - m_lastEquity) / m_capital;
+			int n = m_numBars; // number of returns including this one
+			var delta = r - m_mean;
+			m_mean += delta / n;
+			m_m2 += delta * (r - m_mean);
+			if (r < 0) m_down2 += r*r;
+		}
+		if (equity > m_peak) m_peak = equity;
+		var dd = 100. * (m_peak - equity) / (m_capital + (m_peak > 0 ? m_peak : 0));
+		m_ulcer2 += dd*dd;
+		var x = m_numBars;
+		m_sx += x; m_sy += equity; m_sxx += x*x; m_syy += equity*equity; m_sxy += x*equity;
+		m_lastEquity = equity;
+		m_numBars++;
+	}
+
+	void addTrade(var result) {
+		if (result > 0) {
+			m_numWin++; m_win += result;
+			if (result > m_winMax) m_winMax = result;
+		} else {
+			m_numLoss++; m_loss -= result;
+			if (-result > m_lossMax) m_lossMax = -result;
+		}
+	}
+
+	int numBars() const { return m_numBars; }
+
+	var mean() const { return m_mean; }
+	var stdDev() const { return m_numBars > 2 ? sqrt(m_m2 / (m_numBars - 2)) : 0.; }
+	var downDev() const { return m_numBars > 1 ? sqrt(m_down2 / (m_numBars - 1)) : 0.; }
+	var ulcer() const { return m_numBars > 0 ? sqrt(m_ulcer2 / m_numBars) : 0.; }
+
+	var prr() const { return objectivePRR(m_numWin, m_numLoss, m_win, m_loss, m_winMax, m_lossMax); }
+
+	var sharpe(var periods = 0) const {
+		var sd = stdDev();
+		return sd > 0 ? m_mean/sd * sqrt(periods > 0 ? periods : barsPerYear()) : 0.;
+	}
+
+	var sortino(var periods = 0) const {
+		var dd = downDev();
+		return dd > 0 ? m_mean/dd * sqrt(periods > 0 ? periods : barsPerYear()) : 0.;
+	}
+
+	var ulcerRatio(var periods = 0) const {
+		var u = ulcer();
+		return u > 0 ? 100. * m_mean * (periods > 0 ? periods : barsPerYear()) / u : 0.;
+	}
+
+	var r2() const {
+		if (m_numBars < 2) return 0.;
+		var n = m_numBars;
+		var cov = n*m_sxy - m_sx*m_sy;
+		var vx = n*m_sxx - m_sx*m_sx;
+		var vy = n*m_syy - m_sy*m_sy;
+		if (vx <= 0 || vy <= 0) return 0.;
+		var r2 = cov*cov / (vx*vy);
+		return cov >= 0 ? r2 : -r2;
+	}
+
+	// Upper bound of prr() after at most 'remainingTrades' more trades that win at most 'maxWin' each.
+	// Wins only raise the numerator, and outlier removal can never bring the loss below loss-lossMax.
+	var prrBound(int remainingTrades, var maxWin) const {
+		int numWin = m_numWin + remainingTrades;
+		int numLoss = m_numLoss + remainingTrades;
+		if (!numWin) return 0.;
+		var wFac = 1./sqrt(1.+numWin);
+		var lFac = 1./sqrt(1.+numLoss);
+		var win = m_win + remainingTrades * maxWin;
+		var loss = m_loss - m_lossMax;
+		if (loss < 0) loss = 0;
+		return (1.-wFac)/(1.+lFac)*(1.+win)/(1.+loss);
+	}
+
+	// best objective of the previous steps of the current parameter cycle
+	var best() const {
+		return (m_bestParCycle == g->nParCycle && m_bestWFOCycle == g->nWFOCycle) ? m_best : -1e300;
+	}
+
+	// Terminates the current run with quit() when 'bound' can't beat the best previous step.
+	// Returns true when the run was aborted; finish() then returns the bound instead of the objective.
+	bool abortIfBelow(var bound) {
+		if (m_aborted || !is(EStatusFlag::TRAINMODE) || bound >= best()) return false;
+		m_aborted = true;
+		m_abortBound = bound;
+		quit("objective bound %.3f below best %.3f", bound, best());
+		return true;
+	}
+
+	bool aborted() const { return m_aborted; }
+
+	// call from objective() with the final value; records the best step and resets the accumulators
+	var finish(var objective) {
+		if (m_aborted) objective = m_abortBound;
+		if (m_bestParCycle != g->nParCycle || m_bestWFOCycle != g->nWFOCycle || objective > m_best) {
+			m_best = objective;
+			m_bestParCycle = g->nParCycle;
+			m_bestWFOCycle = g->nWFOCycle;
+		}
+		reset();
+		return objective;
+	}
+
+private:
+	int m_numBars;
+	var m_lastEquity, m_capital;
+	var m_mean, m_m2, m_down2;     // Welford accumulators of bar returns
+	var m_peak, m_ulcer2;          // equity peak and sum of squared drawdown percentages
+	var m_sx, m_sy, m_sxx, m_syy, m_sxy; // regression sums of equity over bars
+	int m_numWin, m_numLoss;
+	var m_win, m_loss, m_winMax, m_lossMax;
+	bool m_aborted;
+	var m_abortBound;
+	var m_best;
+	int m_bestParCycle, m_bestWFOCycle;
+};
+} // namespace z
+
+#endif // ZORRO_OBJECTIVE_H_
@@ -0,0 +1,370 @@
+
+#ifndef ZORRO_ORDER_STATISTIC_H_
+#define ZORRO_ORDER_STATISTIC_H_
+
+#include <vector>
+#include "zorro/thread_pool.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Multiset of values with O(log n) insert, erase, rank and select.
+// It is a treap in a node pool with a fixed priority sequence, so the tree shape and all
+// results are reproducible from run to run, and no memory is allocated once the pool is warm.
+// Each value can carry an integer stamp, normally its bar number. Equal values are kept in
+// insertion order and erase() removes the oldest of them, which is the one leaving a sliding
+// window. The stamp sums give rank weighted sums for rank correlations.
+class COrderStatistic
+{
+	struct SNode
+	{
+		var key;
+		long long stamp, stampSum;
+		unsigned prio;
+		int left, right, size;
+	};
+
+public:
+	explicit COrderStatistic(int capacity = 0) : m_root(-1), m_seed(2463534242u) { reserve(capacity); }
+
+	inline void reserve(int capacity) { m_nodes.reserve(capacity); m_free.reserve(capacity); }
+
+	inline int size() const { return m_root >= 0 ? m_nodes[m_root].size : 0; }
+
+	inline void clear() {
+		m_nodes.clear();
+		m_free.clear();
+		m_root = -1;
+		m_seed = 2463534242u;
+	}
+
+	inline long long stampSum() const { return m_root >= 0 ? m_nodes[m_root].stampSum : 0; }
+
+	// inserts x behind all equal values
+	void insert(var x, long long stamp = 0) {
+		int l, r;
+		split(m_root, x, true, l, r); // l <= x < r
+		m_root = merge(merge(l, create(x, stamp)), r);
+	}
+
+	// removes the oldest element equal to x; returns false if there is none
+	bool erase(var x) {
+		int l, r, m, rest;
+		split(m_root, x, false, l, r);   // l < x <= r
+		splitSize(r, 1, m, rest);        // m = smallest element >= x
+		if (m >= 0 && m_nodes[m].key == x) {
+			m_free.push_back(m);
+			m_root = merge(l, rest);
+			return true;
+		}
+		m_root = merge(l, merge(m, rest));
+		return false;
+	}
+
+	// number of elements < x, or <= x when 'orEqual' is set
+	int countLess(var x, bool orEqual = false) const {
+		int n = 0, t = m_root;
+		while (t >= 0) {
+			const SNode& node = m_nodes[t];
+			if (node.key < x || (orEqual && node.key == x)) {
+				n += sizeOf(node.left) + 1;
+				t = node.right;
+			} else
+				t = node.left;
+		}
+		return n;
+	}
+
+	// sum of the stamps of the elements < x, or <= x when 'orEqual' is set
+	long long stampSumLess(var x, bool orEqual = false) const {
+		long long n = 0;
+		int t = m_root;
+		while (t >= 0) {
+			const SNode& node = m_nodes[t];
+			if (node.key < x || (orEqual && node.key == x)) {
+				n += stampSumOf(node.left) + node.stamp;
+				t = node.right;
+			} else
+				t = node.left;
+		}
+		return n;
+	}
+
+	// number of elements > x, or >= x when 'orEqual' is set
+	inline int countGreater(var x, bool orEqual = false) const {
+		return size() - countLess(x, !orEqual);
+	}
+
+	// k-th smallest element, k = 0..size()-1
+	var select(int k) const {
+		int t = m_root;
+		while (t >= 0) {
+			const SNode& node = m_nodes[t];
+			int ls = sizeOf(node.left);
+			if (k < ls) t = node.left;
+			else if (k == ls) return node.key;
+			else { k -= ls + 1; t = node.right; }
+		}
+		return 0.;
+	}
+
+	// median, the mean of the two middle elements for an even size
+	inline var median() const {
+		int n = size();
+		if (n == 0) return 0.;
+		if (n & 1) return select(n/2);
+		return 0.5*(select(n/2-1) + select(n/2));
+	}
+
+	// percentile 0..100 with linear interpolation between ranks
+	inline var percentile(var percent) const {
+		int n = size();
+		if (n == 0) return 0.;
+		var pos = percent/100. * (n-1);
+		if (pos <= 0) return select(0);
+		if (pos >= n-1) return select(n-1);
+		int k = static_cast<int>(pos);
+		var lo = select(k), hi = select(k+1);
+		return lo + (pos-k)*(hi-lo);
+	}
+
+private:
+	inline int sizeOf(int t) const { return t >= 0 ? m_nodes[t].size : 0; }
+	inline long long stampSumOf(int t) const { return t >= 0 ? m_nodes[t].stampSum : 0; }
+	inline void pull(int t) {
+		SNode& node = m_nodes[t];
+		node.size = sizeOf(node.left) + sizeOf(node.right) + 1;
+		node.stampSum = stampSumOf(node.left) + stampSumOf(node.right) + node.stamp;
+	}
+
+	inline unsigned nextPrio() {
+		m_seed ^= m_seed << 13;
+		m_seed ^= m_seed >> 17;
+		m_seed ^= m_seed << 5;
+		return m_seed;
+	}
+
+	int create(var x, long long stamp) {
+		SNode node;
+		node.key = x; node.stamp = node.stampSum = stamp; node.prio = nextPrio(); node.left = node.right = -1; node.size = 1;
+		if (!m_free.empty()) {
+			int t = m_free.back();
+			m_free.pop_back();
+			m_nodes[t] = node;
+			return t;
+		}
+		m_nodes.push_back(node);
+		return static_cast<int>(m_nodes.size()) - 1;
+	}
+
+	// l gets the keys < x (or <= x if 'orEqual'), r the rest
+	void split(int t, var x, bool orEqual, int& l, int& r) {
+		if (t < 0) { l = r = -1; return; }
+		SNode& node = m_nodes[t];
+		if (node.key < x || (orEqual && node.key == x)) {
+			split(node.right, x, orEqual, m_nodes[t].right, r);
+			l = t;
+		} else {
+			split(node.left, x, orEqual, l, m_nodes[t].left);
+			r = t;
+		}
+		pull(t);
+	}
+
+	// l gets the first k elements, r the rest
+	void splitSize(int t, int k, int& l, int& r) {
+		if (t < 0) { l = r = -1; return; }
+		int ls = sizeOf(m_nodes[t].left);
+		if (k <= ls) {
+			splitSize(m_nodes[t].left, k, l, m_nodes[t].left);
+			r = t;
+		} else {
+			splitSize(m_nodes[t].right, k - ls - 1, m_nodes[t].right, r);
+			l = t;
+		}
+		pull(t);
+	}
+
+	int merge(int l, int r) {
+		if (l < 0) return r;
+		if (r < 0) return l;
+		if (m_nodes[l].prio > m_nodes[r].prio) {
+			m_nodes[l].right = merge(m_nodes[l].right, r);
+			pull(l);
+			return l;
+		}
+		m_nodes[r].left = merge(l, m_nodes[r].left);
+		pull(r);
+		return r;
+	}
+
+	std::vector<SNode> m_nodes;
+	std::vector<int> m_free;
+	int m_root;
+	unsigned m_seed;
+};
+
+///////////////////////////////////////////////////////
+// Ring buffer of the last 'period' values; [0] is the newest like in a series
+class CSlidingWindow
+{
+public:
+	explicit CSlidingWindow(int period = 1) : m_data(period > 0 ? period : 1, 0.), m_head(0), m_count(0) {}
+
+	// stores x; returns true and the dropped value when the window was full
+	inline bool push(var x, var& dropped) {
+		const int n = capacity();
+		m_head = (m_head + 1) % n;
+		bool full = m_count == n;
+		dropped = m_data[m_head];
+		m_data[m_head] = x;
+		if (!full) m_count++;
+		return full;
+	}
+
+	// presets the whole window with x, like a series on its first bar
+	inline void fill(var x) {
+		for (size_t i = 0; i < m_data.size(); i++) m_data[i] = x;
+		m_count = capacity();
+	}
+
+	inline var operator[](int offset) const {
+		const int n = capacity();
+		return m_data[(m_head - offset + n) % n];
+	}
+
+	inline int size() const { return m_count; }
+	inline int capacity() const { return static_cast<int>(m_data.size()); }
+	inline bool full() const { return m_count == capacity(); }
+
+private:
+	std::vector<var> m_data;
+	int m_head, m_count;
+};
+///////////////////////////////////////////////////////
+// Sliding window order statistics, the streaming versions of
+// Median(Data,Period), Percentile(Data,Period,Percent) and PercentRank(Data,Period,Value).
+// update() costs O(log period); like a series the window is preset with the first value.
+class CSlidingRank
+{
+public:
+	explicit CSlidingRank(int period = 50) : m_window(period), m_tree(m_window.capacity()+1), m_stamp(0), m_init(false) {}
+
+	void update(var x) {
+		const int n = m_window.capacity();
+		if (!m_init) {
+			m_window.fill(x);
+			for (int i = 0; i < n; i++) m_tree.insert(x, m_stamp++);
+			m_init = true;
+		}
+		var dropped;
+		m_window.push(x, dropped);
+		m_tree.erase(dropped);
+		m_tree.insert(x, m_stamp++);
+	}
+
+	inline var median() const { return m_tree.median(); }
+	inline var percentile(var percent) const { return m_tree.percentile(percent); }
+	// percentage of the window values below 'value'
+	inline var percentRank(var value) const { return m_init ? 100.*m_tree.countLess(value)/period() : 0.; }
+	inline var lowest() const { return m_tree.select(0); }
+	inline var highest() const { return m_tree.select(period()-1); }
+
+	inline int period() const { return m_window.capacity(); }
+	inline var operator[](int offset) const { return m_window[offset]; }
+	inline const COrderStatistic& tree() const { return m_tree; }
+
+private:
+	CSlidingWindow m_window;
+	COrderStatistic m_tree;
+	long long m_stamp;
+	bool m_init;
+};
+
+// Spearman rank correlation of the window values with their time order, Spearman(Data,Period);
+// +1 for a steadily rising, -1 for a steadily falling series.
+// The sum of value rank times bar stamp is kept up to date from the stamp sums of the
+// order statistic tree, so each bar costs O(log period) and is computed in exact integers.
+// Equal values are ranked by age.
+class CSpearman
+{
+public:
+	explicit CSpearman(int period = 20) : m_window(period > 2 ? period : 2), m_tree(m_window.capacity()+1), m_stamp(0), m_sum(0), m_init(false), m_y(0) {}
+
+	var update(var x) {
+		const long long n = m_window.capacity();
+		if (!m_init) {
+			m_window.fill(x);
+			for (long long i = 0; i < n; i++) {
+				m_tree.insert(x, m_stamp);
+				m_sum += (i+1)*m_stamp++;
+			}
+			m_init = true;
+		}
+		// the oldest value leaves: all values ranked above it move one rank down
+		var dropped;
+		m_window.push(x, dropped);
+		long long stamp = m_stamp - n;
+		long long rank = m_tree.countLess(dropped) + 1;
+		m_sum -= m_tree.stampSum() - m_tree.stampSumLess(dropped) - stamp + rank*stamp;
+		m_tree.erase(dropped);
+		// the new value enters behind its equals: all values ranked above it move one rank up
+		rank = m_tree.countLess(x, true) + 1;
+		m_sum += m_tree.stampSum() - m_tree.stampSumLess(x, true) + rank*m_stamp;
+		m_tree.insert(x, m_stamp++);
+
+		// sum of rank * age with ages 1..n, then rho = 1 - 6*sum(d^2)/(n*(n^2-1))
+		long long s = m_sum - (m_stamp-n-1)*n*(n+1)/2;
+		long long d2 = n*(n+1)*(2*n+1)/3 - 2*s;
+		return m_y = 1. - 6.*d2/(static_cast<var>(n)*(n*n-1));
+	}
+	inline var value() const { return m_y; }
+	inline int period() const { return m_window.capacity(); }
+
+private:
+	CSlidingWindow m_window;
+	COrderStatistic m_tree;
+	long long m_stamp, m_sum;
+	bool m_init;
+	var m_y;
+};
+
+// Sliding order statistics for many assets at once, one window per asset.
+// update() takes one value per asset and is spread over the thread pool for large portfolios;
+// a plain exported run() that uses it must end with zorroExitRun().
+class CSlidingRankBank
+{
+public:
+	CSlidingRankBank(int assets = 0, int period = 50) : m_ranks(assets, CSlidingRank(period)) {}
+
+	inline void update(const var* x) {
+		const int n = size();
+		if (n < ParallelThreshold) {
+			for (int i = 0; i < n; i++) m_ranks[i].update(x[i]);
+			return;
+		}
+		threadPool().parallelForEach(0, n, [this, x](int i) { m_ranks[i].update(x[i]); }, 16);
+	}
+
+	inline void medians(var* out) const {
+		for (int i = 0; i < size(); i++) out[i] = m_ranks[i].median();
+	}
+	inline void percentiles(var percent, var* out) const {
+		for (int i = 0; i < size(); i++) out[i] = m_ranks[i].percentile(percent);
+	}
+	// percent rank of values[i] in the window of asset i
+	inline void percentRanks(const var* values, var* out) const {
+		for (int i = 0; i < size(); i++) out[i] = m_ranks[i].percentRank(values[i]);
+	}
+
+	inline int size() const { return static_cast<int>(m_ranks.size()); }
+	inline const CSlidingRank& operator[](int asset) const { return m_ranks[asset]; }
+	inline CSlidingRank& operator[](int asset) { return m_ranks[asset]; }
+
+private:
+	enum { ParallelThreshold = 64 };
+	std::vector<CSlidingRank> m_ranks;
+};
+} // namespace z
+
+#endif // ZORRO_ORDER_STATISTIC_H_
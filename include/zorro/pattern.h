@@ -0,0 +1,352 @@
+
+#ifndef ZORRO_PATTERN_H_
+#define ZORRO_PATTERN_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Native pattern classifier for the PATTERN mode of adviseLong/adviseShort.
+// The signals are split into PATTERNS_2..6 equal groups like in the host. Only the shape of a
+// group counts, so every group is normalized to its own min..max range.
+//  - Without FUZZY a pattern is the set of order relations between the signals of each group
+//    (with FAST only between neighbours), stored as a bit vector of 2 bits per relation; all
+//    training samples with the same relations form one rule, and rules are found by binary
+//    search in a table sorted by their bit vectors.
+//  - With FUZZY the normalized samples are kept in a kd-tree and a query averages the
+//    objectives of the k nearest samples weighted by distance; FAST limits the search to the
+//    leaves closest to the query, which is approximate but much faster.
+// query() returns the share of the positive objectives in percent, 50 for a break-even
+// pattern, so the usual 'advise... > 40' style thresholds keep working.
+//
+//   static z::CPatternMatcher Matcher(EAdviseMode::PATTERN|EAdviseMode::FUZZY|EAdviseMode::PATTERNS_2);
+//   if (Train) Matcher.add(Signals, 12, TradeResult);  // one sample per finished trade
+//   ...
+//   Matcher.train(); Matcher.save("Data\\Workshop7_EURUSD.pat");
+//   if (Matcher.query(Signals, 12) > 40) reverseLong(1);
+class CPatternMatcher
+{
+	// statistics of a rule; its relation bits are in m_keys at the same index
+	struct SRule
+	{
+		float win, loss;
+		unsigned count;
+	};
+
+	struct SNode
+	{
+		int begin, end;   // sample range in m_order
+		int dim;          // split dimension, -1 for a leaf
+		var split;
+		int left, right;
+	};
+
+	struct SHeader
+	{
+		char magic[4];
+		unsigned version, method, dims, groups, count, k;
+	};
+
+public:
+	explicit CPatternMatcher(EAdviseMode method = EAdviseMode::PATTERN|EAdviseMode::PATTERNS_2, int k = 10) : m_dims(0), m_k(k > 0 ? k : 1), m_trained(false) {
+		setMethod(method);
+	}
+
+	inline void setMethod(EAdviseMode method) {
+		m_method = method;
+		int groups = static_cast<int>(method) & 7;
+		m_groups = groups >= 2 && groups <= 6 ? groups : 1;
+	}
+	inline bool fuzzy() const { return (m_method & EAdviseMode::FUZZY) != 0; }
+	inline bool fast() const { return (m_method & EAdviseMode::FAST) != 0; }
+
+	// training sample: the signals at trade entry and the trade result
+	void add(const var* signals, int n, var objective) {
+		if (m_dims == 0 && n <= MaxSignals) m_dims = n;
+		if (n != m_dims) return;
+		size_t at = m_features.size();
+		m_features.resize(at + n);
+		normalize(signals, &m_features[at]);
+		m_objectives.push_back(objective);
+		m_trained = false;
+	}
+
+	// builds the rule table or the kd-tree from the samples
+	void train() {
+		if (fuzzy()) buildTree();
+		else buildRules();
+		m_trained = true;
+	}
+
+	// percentage of positive objectives for the pattern of 'signals', or 0 when it is unknown
+	var query(const var* signals, int n) const {
+		if (!m_trained || n != m_dims || n == 0) return 0.;
+		var x[MaxSignals];
+		normalize(signals, x);
+		var win = 0, loss = 0;
+		if (fuzzy()) {
+			int ids[MaxNeighbours];
+			var dist[MaxNeighbours];
+			int found = nearest(x, ids, dist);
+			for (int i = 0; i < found; i++) {
+				var w = 1./(1e-9 + sqrt(dist[i]));
+				var o = m_objectives[ids[i]];
+				if (o > 0) win += w*o; else loss -= w*o;
+			}
+		} else {
+			unsigned long long key[MaxKeyWords];
+			patternKey(x, key);
+			const int words = keyWords();
+			int lo = 0, hi = rules();
+			while (lo < hi) {
+				const int mid = (lo + hi)/2;
+				if (compareKeys(&m_keys[static_cast<size_t>(mid)*words], key, words) < 0) lo = mid + 1;
+				else hi = mid;
+			}
+			if (lo == rules() || compareKeys(&m_keys[static_cast<size_t>(lo)*words], key, words) != 0) return 0.;
+			win = m_rules[lo].win;
+			loss = m_rules[lo].loss;
+		}
+		return win + loss > 0. ? 100.*win/(win + loss) : 0.;
+	}
+
+	inline int samples() const { return static_cast<int>(m_objectives.size()); }
+	inline int rules() const { return static_cast<int>(m_rules.size()); }
+	inline int dims() const { return m_dims; }
+
+	// compact binary rules file: header, then the relation bits and statistics of the rules,
+	// or the normalized samples as floats
+	bool save(const char* filename) const {
+		FILE* file = fopen(filename, "wb");
+		if (!file) return false;
+		SHeader h = { { 'Z', 'P', 'A', 'T' }, 2, static_cast<unsigned>(m_method), static_cast<unsigned>(m_dims), static_cast<unsigned>(m_groups), 0, static_cast<unsigned>(m_k) };
+		h.count = fuzzy() ? samples() : rules();
+		bool ok = fwrite(&h, sizeof(h), 1, file) == 1;
+		if (fuzzy()) {
+			std::vector<float> record(m_dims + 1);
+			for (int i = 0; ok && i < samples(); i++) {
+				for (int d = 0; d < m_dims; d++) record[d] = static_cast<float>(m_features[i*m_dims + d]);
+				record[m_dims] = static_cast<float>(m_objectives[i]);
+				ok = fwrite(&record[0], sizeof(float), record.size(), file) == record.size();
+			}
+		} else if (!m_rules.empty()) {
+			ok = ok && fwrite(&m_keys[0], sizeof(unsigned long long), m_keys.size(), file) == m_keys.size();
+			for (int i = 0; ok && i < rules(); i++) {
+				const SRule& rule = m_rules[i];
+				ok = fwrite(&rule.win, sizeof(float), 1, file) == 1 && fwrite(&rule.loss, sizeof(float), 1, file) == 1
+					&& fwrite(&rule.count, sizeof(unsigned), 1, file) == 1;
+			}
+		}
+		fclose(file);
+		return ok;
+	}
+
+	bool load(const char* filename) {
+		FILE* file = fopen(filename, "rb");
+		if (!file) return false;
+		SHeader h;
+		bool ok = fread(&h, sizeof(h), 1, file) == 1 && h.magic[0] == 'Z' && h.magic[1] == 'P' && h.magic[2] == 'A' && h.magic[3] == 'T' && h.version == 2;
+		if (ok) {
+			setMethod(static_cast<EAdviseMode>(h.method));
+			m_dims = h.dims <= MaxSignals ? h.dims : 0;
+			m_k = h.k > 0 ? h.k : 1;
+			ok = m_dims > 0;
+			m_features.clear();
+			m_objectives.clear();
+			m_rules.clear();
+			m_keys.clear();
+			if (ok && fuzzy()) {
+				std::vector<float> record(m_dims + 1);
+				for (unsigned i = 0; ok && i < h.count; i++) {
+					ok = fread(&record[0], sizeof(float), record.size(), file) == record.size();
+					if (!ok) break;
+					for (int d = 0; d < m_dims; d++) m_features.push_back(record[d]);
+					m_objectives.push_back(record[m_dims]);
+				}
+				if (ok) buildTree();
+			} else if (ok) {
+				const int words = keyWords();
+				std::vector<unsigned long long> keys(static_cast<size_t>(h.count)*words);
+				ok = h.count == 0 || fread(&keys[0], sizeof(unsigned long long), keys.size(), file) == keys.size();
+				for (unsigned i = 0; ok && i < h.count; i++) {
+					SRule rule;
+					ok = fread(&rule.win, sizeof(float), 1, file) == 1 && fread(&rule.loss, sizeof(float), 1, file) == 1
+						&& fread(&rule.count, sizeof(unsigned), 1, file) == 1;
+					if (ok) m_rules.push_back(rule);
+				}
+				if (ok) m_keys.swap(keys);
+			}
+			if (!ok) {
+				m_features.clear();
+				m_objectives.clear();
+				m_rules.clear();
+			}
+			m_trained = ok;
+		}
+		fclose(file);
+		return ok;
+	}
+
+private:
+	enum { MaxSignals = 64, MaxKeyWords = (MaxSignals*(MaxSignals-1) + 63)/64, MaxNeighbours = 64, LeafSize = 16, FastLeaves = 3 };
+
+	// every group scaled to 0..1 of its own range
+	void normalize(const var* signals, var* out) const {
+		const int n = m_dims;
+		for (int g0 = 0; g0 < m_groups; g0++) {
+			int from = g0*n/m_groups, to = (g0+1)*n/m_groups;
+			var lo = signals[from], hi = signals[from];
+			for (int i = from; i < to; i++) { if (signals[i] < lo) lo = signals[i]; if (signals[i] > hi) hi = signals[i]; }
+			for (int i = from; i < to; i++) out[i] = hi > lo ? (signals[i] - lo)/(hi - lo) : 0.5;
+		}
+	}
+
+	// number of compared signal pairs, and of 64 bit words for their relations
+	inline int relations() const {
+		int pairs = 0;
+		for (int g0 = 0; g0 < m_groups; g0++) {
+			const int size = (g0+1)*m_dims/m_groups - g0*m_dims/m_groups;
+			pairs += size < 2 ? 0 : fast() ? size - 1 : size*(size - 1)/2;
+		}
+		return pairs;
+	}
+	inline int keyWords() const { const int w = (2*relations() + 63)/64; return w > 0 ? w : 1; }
+
+	// order relations inside the groups, 2 bits each: 1 less, 2 greater, 3 equal
+	void patternKey(const var* x, unsigned long long* key) const {
+		memset(key, 0, keyWords()*sizeof(unsigned long long));
+		const int n = m_dims;
+		int bit = 0;
+		for (int g0 = 0; g0 < m_groups; g0++) {
+			int from = g0*n/m_groups, to = (g0+1)*n/m_groups;
+			for (int i = from; i < to; i++)
+				for (int j = i+1; j < (fast() ? (i+2 < to ? i+2 : to) : to); j++) {
+					unsigned long long relation = x[i] < x[j] ? 1 : (x[i] > x[j] ? 2 : 3);
+					key[bit >> 6] |= relation << (bit & 63);
+					bit += 2;
+				}
+		}
+	}
+
+	static inline int compareKeys(const unsigned long long* a, const unsigned long long* b, int words) {
+		for (int w = 0; w < words; w++)
+			if (a[w] != b[w]) return a[w] < b[w] ? -1 : 1;
+		return 0;
+	}
+
+	void buildRules() {
+		m_rules.clear();
+		m_keys.clear();
+		const int words = keyWords();
+		std::vector<unsigned long long> keys(static_cast<size_t>(samples())*words);
+		std::vector<int> order(samples());
+		for (int i = 0; i < samples(); i++) {
+			patternKey(&m_features[i*m_dims], &keys[static_cast<size_t>(i)*words]);
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&keys, words](int a, int b) {
+			return compareKeys(&keys[static_cast<size_t>(a)*words], &keys[static_cast<size_t>(b)*words], words) < 0;
+		});
+		// merge equal patterns
+		for (int i = 0; i < samples(); i++) {
+			const unsigned long long* key = &keys[static_cast<size_t>(order[i])*words];
+			const var o = m_objectives[order[i]];
+			if (m_rules.empty() || compareKeys(&m_keys[m_keys.size() - words], key, words) != 0) {
+				SRule rule = { 0.f, 0.f, 0 };
+				m_rules.push_back(rule);
+				m_keys.insert(m_keys.end(), key, key + words);
+			}
+			SRule& rule = m_rules.back();
+			rule.win += static_cast<float>(o > 0 ? o : 0);
+			rule.loss += static_cast<float>(o < 0 ? -o : 0);
+			rule.count++;
+		}
+	}
+
+	void buildTree() {
+		m_nodes.clear();
+		m_order.resize(samples());
+		for (int i = 0; i < samples(); i++) m_order[i] = i;
+		if (samples() > 0) buildNode(0, samples());
+	}
+
+	int buildNode(int begin, int end) {
+		int id = static_cast<int>(m_nodes.size());
+		SNode node;
+		node.begin = begin; node.end = end; node.dim = -1; node.split = 0; node.left = node.right = -1;
+		m_nodes.push_back(node);
+		if (end - begin <= LeafSize) return id;
+		// split the dimension with the largest spread at its median
+		int dim = 0;
+		var spread = -1;
+		for (int d = 0; d < m_dims; d++) {
+			var lo = 1e300, hi = -1e300;
+			for (int i = begin; i < end; i++) { var v = m_features[m_order[i]*m_dims + d]; if (v < lo) lo = v; if (v > hi) hi = v; }
+			if (hi - lo > spread) { spread = hi - lo; dim = d; }
+		}
+		if (spread <= 0) return id;
+		int mid = (begin + end)/2;
+		const std::vector<var>& f = m_features;
+		const int dims = m_dims;
+		std::nth_element(m_order.begin() + begin, m_order.begin() + mid, m_order.begin() + end,
+			[&f, dims, dim](int a, int b) { return f[a*dims + dim] < f[b*dims + dim] || (f[a*dims + dim] == f[b*dims + dim] && a < b); });
+		var split = m_features[m_order[mid]*m_dims + dim];
+		int left = buildNode(begin, mid);
+		int right = buildNode(mid, end);
+		m_nodes[id].dim = dim;
+		m_nodes[id].split = split;
+		m_nodes[id].left = left;
+		m_nodes[id].right = right;
+		return id;
+	}
+
+	// k nearest samples, sorted by distance; returns their number
+	int nearest(const var* x, int* ids, var* dist) const {
+		const int k = m_k < MaxNeighbours ? m_k : MaxNeighbours;
+		int found = 0, leaves = 0;
+		if (!m_nodes.empty()) search(0, x, k, ids, dist, found, leaves);
+		return found;
+	}
+
+	void search(int id, const var* x, int k, int* ids, var* dist, int& found, int& leaves) const {
+		const SNode& node = m_nodes[id];
+		if (node.dim < 0) {
+			leaves++;
+			for (int i = node.begin; i < node.end; i++) {
+				int s = m_order[i];
+				const var* f = &m_features[s*m_dims];
+				var d = 0;
+				for (int j = 0; j < m_dims; j++) { var e = f[j] - x[j]; d += e*e; }
+				if (found == k && d >= dist[k-1]) continue;
+				// insertion into the sorted candidate list
+				int p = found < k ? found++ : k-1;
+				while (p > 0 && (dist[p-1] > d || (dist[p-1] == d && ids[p-1] > s))) { dist[p] = dist[p-1]; ids[p] = ids[p-1]; p--; }
+				dist[p] = d; ids[p] = s;
+			}
+			return;
+		}
+		var diff = x[node.dim] - node.split;
+		int nearChild = diff < 0 ? node.left : node.right;
+		int farChild = diff < 0 ? node.right : node.left;
+		search(nearChild, x, k, ids, dist, found, leaves);
+		if (fast() && leaves >= FastLeaves && found == k) return;
+		if (found < k || diff*diff < dist[found-1]) search(farChild, x, k, ids, dist, found, leaves);
+	}
+
+	EAdviseMode m_method;
+	int m_groups, m_dims, m_k;
+	bool m_trained;
+	std::vector<var> m_features, m_objectives;
+	std::vector<SRule> m_rules;
+	std::vector<unsigned long long> m_keys;
+	std::vector<SNode> m_nodes;
+	std::vector<int> m_order;
+};
+} // namespace z
+
+#endif // ZORRO_PATTERN_H_
@@ -0,0 +1,216 @@
+
+#ifndef ZORRO_PIPELINE_H_
+#define ZORRO_PIPELINE_H_
+
+#include "zorro/indicators.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Fused indicator pipelines.
+// A chain like series(FisherN(series(BandPass(series(price()),30,0.5)),500)) becomes
+//
+//   static auto Signal = z::pipeline(z::input() | z::CBandPass(30,0.5) | z::CFisherN(500));
+//   Signal.updateBar(price());
+//   plot("Filtered", Signal.tap<1>(), ...);
+//
+// The whole chain is one object holding the state of all stages by value, so it is updated
+// in one pass per bar without host calls or series. tap<N>() returns the output of stage N
+// (0 = input, 1 = first filter, ...) for plotting. Pipelines fed by the same input can be
+// combined with + - * and scalars. Any class with var update(var) and var value() can be a stage.
+
+// CRTP base that marks pipeline nodes for the operators below
+template <class Derived>
+struct SPipeNode
+{
+	inline const Derived& self() const { return static_cast<const Derived&>(*this); }
+	inline Derived& self() { return static_cast<Derived&>(*this); }
+};
+
+template <bool Here>
+struct SPipeTap;
+
+template <>
+struct SPipeTap<true>
+{
+	template <int N, class Node>
+	static inline var get(const Node& node) { return node.value(); }
+};
+
+template <>
+struct SPipeTap<false>
+{
+	template <int N, class Node>
+	static inline var get(const Node& node) { return node.source().template tap<N>(); }
+};
+
+// pipeline input, stage 0
+class CPipeInput : public SPipeNode<CPipeInput>
+{
+public:
+	enum { depth = 0 };
+
+	CPipeInput() : m_x(0) {}
+
+	inline var update(var x) { return m_x = x; }
+	inline var value() const { return m_x; }
+	template <int N> inline var tap() const { return m_x; }
+
+private:
+	var m_x;
+};
+
+// source node followed by a streaming indicator
+template <class Source, class Filter>
+class CPipeStage : public SPipeNode<CPipeStage<Source, Filter> >
+{
+public:
+	enum { depth = Source::depth + 1 };
+
+	CPipeStage(const Source& source, const Filter& filter) : m_source(source), m_filter(filter) {}
+
+	inline var update(var x) { return m_filter.update(m_source.update(x)); }
+	inline var value() const { return m_filter.value(); }
+	inline const Source& source() const { return m_source; }
+	inline const Filter& filter() const { return m_filter; }
+	inline Filter& filter() { return m_filter; }
+	template <int N> inline var tap() const { return SPipeTap<N == depth>::template get<N>(*this); }
+
+private:
+	Source m_source;
+	Filter m_filter;
+};
+
+// element-wise combination of two nodes fed by the same input; taps follow the left branch
+template <class Left, class Right, class Operation>
+class CPipeBinary : public SPipeNode<CPipeBinary<Left, Right, Operation> >
+{
+public:
+	enum { depth = (static_cast<int>(Left::depth) > static_cast<int>(Right::depth) ? static_cast<int>(Left::depth) : static_cast<int>(Right::depth)) + 1 };
+
+	CPipeBinary(const Left& left, const Right& right) : m_left(left), m_right(right), m_y(0) {}
+
+	inline var update(var x) { return m_y = Operation::apply(m_left.update(x), m_right.update(x)); }
+	inline var value() const { return m_y; }
+	inline const Left& source() const { return m_left; }
+	inline const Right& right() const { return m_right; }
+	template <int N> inline var tap() const { return SPipeTap<N == depth>::template get<N>(*this); }
+
+private:
+	Left m_left;
+	Right m_right;
+	var m_y;
+};
+
+// node combined with a constant
+template <class Source, class Operation>
+class CPipeScalar : public SPipeNode<CPipeScalar<Source, Operation> >
+{
+public:
+	enum { depth = Source::depth + 1 };
+
+	CPipeScalar(const Source& source, var scalar, bool scalarFirst) : m_source(source), m_scalar(scalar), m_scalarFirst(scalarFirst), m_y(0) {}
+
+	inline var update(var x) {
+		var v = m_source.update(x);
+		return m_y = m_scalarFirst ? Operation::apply(m_scalar, v) : Operation::apply(v, m_scalar);
+	}
+	inline var value() const { return m_y; }
+	inline const Source& source() const { return m_source; }
+	template <int N> inline var tap() const { return SPipeTap<N == depth>::template get<N>(*this); }
+
+private:
+	Source m_source;
+	var m_scalar;
+	bool m_scalarFirst;
+	var m_y;
+};
+
+struct SPipeAdd { static inline var apply(var a, var b) { return a + b; } };
+struct SPipeSub { static inline var apply(var a, var b) { return a - b; } };
+struct SPipeMul { static inline var apply(var a, var b) { return a * b; } };
+
+inline CPipeInput input()
+{
+	return CPipeInput();
+}
+
+template <class Source, class Filter>
+inline CPipeStage<Source, Filter> operator|(const SPipeNode<Source>& source, const Filter& filter)
+{
+	return CPipeStage<Source, Filter>(source.self(), filter);
+}
+
+#define ZORRO_PIPE_OPERATOR(op, operation) \
+template <class Left, class Right> \
+inline CPipeBinary<Left, Right, operation> operator op(const SPipeNode<Left>& left, const SPipeNode<Right>& right) { \
+	return CPipeBinary<Left, Right, operation>(left.self(), right.self()); \
+} \
+template <class Source> \
+inline CPipeScalar<Source, operation> operator op(const SPipeNode<Source>& source, var scalar) { \
+	return CPipeScalar<Source, operation>(source.self(), scalar, false); \
+} \
+template <class Source> \
+inline CPipeScalar<Source, operation> operator op(var scalar, const SPipeNode<Source>& source) { \
+	return CPipeScalar<Source, operation>(source.self(), scalar, true); \
+}
+
+ZORRO_PIPE_OPERATOR(+, SPipeAdd)
+ZORRO_PIPE_OPERATOR(-, SPipeSub)
+ZORRO_PIPE_OPERATOR(*, SPipeMul)
+
+#undef ZORRO_PIPE_OPERATOR
+
+///////////////////////////////////////////////////////
+// Pipeline with a short output history for crossOver/peak style tests.
+// updateBar() only advances once per bar, so it can be called from run() and tick() alike.
+template <class Node, int History = 3>
+class CPipeline
+{
+public:
+	explicit CPipeline(const Node& node) : m_node(node), m_bar(-1), m_count(0) {
+		for (int i = 0; i < History; i++) m_y[i] = 0;
+	}
+
+	inline var update(var x) {
+		for (int i = History-1; i > 0; i--) m_y[i] = m_y[i-1];
+		m_y[0] = m_node.update(x);
+		if (m_count < History) m_count++;
+		return m_y[0];
+	}
+
+	inline var updateBar(var x) {
+		if (g->nBar == m_bar) return m_y[0];
+		m_bar = g->nBar;
+		return update(x);
+	}
+
+	// output 'offset' updates ago, 0 = current
+	inline var operator[](int offset) const { return m_y[offset]; }
+	inline var value() const { return m_y[0]; }
+	inline int count() const { return m_count; }
+
+	template <int N> inline var tap() const { return m_node.template tap<N>(); }
+	inline const Node& node() const { return m_node; }
+	inline Node& node() { return m_node; }
+
+	inline bool crossOver(var threshold) const  { return m_count > 1 && m_y[0] > threshold && m_y[1] <= threshold; }
+	inline bool crossUnder(var threshold) const { return m_count > 1 && m_y[0] < threshold && m_y[1] >= threshold; }
+	inline bool rising() const  { return m_count > 1 && m_y[0] > m_y[1]; }
+	inline bool falling() const { return m_count > 1 && m_y[0] < m_y[1]; }
+
+private:
+	Node m_node;
+	int m_bar, m_count;
+	var m_y[History];
+};
+
+// builds a CPipeline from an expression
+template <class Node>
+inline CPipeline<Node> pipeline(const SPipeNode<Node>& node)
+{
+	return CPipeline<Node>(node.self());
+}
+} // namespace z
+
+#endif // ZORRO_PIPELINE_H_
@@ -0,0 +1,199 @@
+
+#ifndef ZORRO_POLYFIT_H_
+#define ZORRO_POLYFIT_H_
+
+#include <math.h>
+#include <vector>
+#include "zorro/order_statistic.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Streaming polyfit(): least squares polynomial over a sliding window, or with exponential
+// forgetting, updated per bar independent of the window length.
+// The fit keeps the moment sums of the normal equations in the scaled bar offset u = x/Period.
+// When a bar passes, every offset grows by one, which moves the sums by a binomial transform in
+// O(order^2); the new value is added at u = 0 and the dropped one removed at u = 1. The small
+// normal system is solved per bar. Sliding windows are recomputed every 'resync' bars to stop
+// rounding drift; with forgetting the old errors decay by themselves.
+// The coefficients are for x = bar offset like polyfit(): x = 0 is the current bar, x = 1 the
+// previous bar, and negative x are future bars.
+//
+//   static z::CPolyFit Trend(2, 3000);
+//   var Fitted = Trend.update(priceClose());
+//   int Bars = Trend.predict(EPredictionType::PEAK, 10);   // like predict(PEAK, Data, 10, 0)
+class CPolyFit
+{
+public:
+	enum { MaxOrder = 6 };
+
+	// 'forget' > 0 selects exponential forgetting with that factor, f.i. 0.999, instead of the window
+	explicit CPolyFit(int order = 2, int period = 100, var forget = 0., int resync = 1024) : m_window(period > 1 ? period : 2) {
+		m_order = order < 0 ? 0 : (order > MaxOrder ? MaxOrder : order);
+		m_forget = forget > 0. && forget < 1. ? forget : 0.;
+		m_scale = m_forget > 0. ? 1./(1. - m_forget) : m_window.capacity();
+		m_resync = resync > 0 ? resync : 1;
+		m_count = 0;
+		m_init = false;
+		for (int k = 0; k <= 2*MaxOrder; k++) m_s[k] = 0;
+		for (int k = 0; k <= MaxOrder; k++) m_t[k] = m_c[k] = 0;
+		// binomial shift u -> u + h: (u+h)^k = sum C(k,j) h^(k-j) u^j
+		const var h = 1./m_scale;
+		var binomial[2*MaxOrder+1][2*MaxOrder+1];
+		for (int k = 0; k <= 2*m_order; k++)
+			for (int j = 0; j <= k; j++) {
+				binomial[k][j] = j == 0 || j == k ? 1. : binomial[k-1][j-1] + binomial[k-1][j];
+				m_shift[k][j] = binomial[k][j]*pow(h, k-j);
+			}
+	}
+
+	// adds the newest value; returns the fitted value at the current bar
+	var update(var y) {
+		if (m_forget > 0.) {
+			if (m_init) shift(m_forget);
+			else m_init = true;
+			m_s[0] += 1.;
+			m_t[0] += y;
+		} else {
+			if (!m_init) {
+				m_window.fill(y);
+				m_init = true;
+				recompute();
+			} else {
+				var dropped;
+				m_window.push(y, dropped);
+				if (++m_count >= m_resync) {
+					m_count = 0;
+					recompute();
+				} else {
+					shift(1.);
+					// the dropped value has now offset Period, u = 1
+					for (int k = 0; k <= 2*m_order; k++) m_s[k] -= 1.;
+					for (int k = 0; k <= m_order; k++) m_t[k] -= dropped;
+					m_s[0] += 1.;
+					m_t[0] += y;
+				}
+			}
+		}
+		solve();
+		return m_c[0];
+	}
+
+	inline int order() const { return m_order; }
+
+	// coefficient of x^k, x in bars
+	inline var coeff(int k) const { return k >= 0 && k <= m_order ? m_c[k] : 0.; }
+	inline void coeffs(var* out) const { for (int k = 0; k <= m_order; k++) out[k] = m_c[k]; }
+
+	// fitted value at bar offset x, like polynom(); negative x forecast
+	inline var value(var x) const {
+		var y = 0;
+		for (int k = m_order; k >= 0; k--) y = y*x + m_c[k];
+		return y;
+	}
+	inline var forecast(int bars) const { return value(-bars); }
+
+	// bars until the fitted curve crosses zero (CROSSOVER, for the difference of two series),
+	// or has a peak or valley of at least 'threshold' above or below the current value;
+	// 0 when nothing happens within 'horizon' bars
+	int predict(EPredictionType type, int horizon, var threshold = 0.) const {
+		const var now = value(0.);
+		var last = now, slope = value(-1.) - now;
+		for (int bar = 1; bar <= horizon; bar++) {
+			const var y = value(-bar);
+			if (type == EPredictionType::CROSSOVER) {
+				if ((last <= 0. && y > 0.) || (last >= 0. && y < 0.)) return bar;
+			} else {
+				const var next = value(-bar-1) - y;
+				if (type == EPredictionType::PEAK && slope > 0. && next <= 0. && y - now >= threshold) return bar;
+				if (type == EPredictionType::VALLEY && slope < 0. && next >= 0. && now - y >= threshold) return bar;
+				slope = next;
+			}
+			last = y;
+		}
+		return 0;
+	}
+
+private:
+	// all offsets one bar older, then the sums scaled by 'factor'
+	void shift(var factor) {
+		var s[2*MaxOrder+1], t[MaxOrder+1];
+		for (int k = 0; k <= 2*m_order; k++) {
+			var sum = 0;
+			for (int j = 0; j <= k; j++) sum += m_shift[k][j]*m_s[j];
+			s[k] = sum*factor;
+		}
+		for (int k = 0; k <= m_order; k++) {
+			var sum = 0;
+			for (int j = 0; j <= k; j++) sum += m_shift[k][j]*m_t[j];
+			t[k] = sum*factor;
+		}
+		for (int k = 0; k <= 2*m_order; k++) m_s[k] = s[k];
+		for (int k = 0; k <= m_order; k++) m_t[k] = t[k];
+	}
+
+	// exact sums from the window
+	void recompute() {
+		for (int k = 0; k <= 2*m_order; k++) m_s[k] = 0;
+		for (int k = 0; k <= m_order; k++) m_t[k] = 0;
+		for (int i = 0; i < m_window.capacity(); i++) {
+			const var u = i/m_scale, y = m_window[i];
+			var p = 1.;
+			for (int k = 0; k <= 2*m_order; k++) {
+				m_s[k] += p;
+				if (k <= m_order) m_t[k] += p*y;
+				p *= u;
+			}
+		}
+	}
+
+	// Cholesky solution of the normal equations, then back to bar units
+	void solve() {
+		const int n = m_order + 1;
+		var a[MaxOrder+1][MaxOrder+1], b[MaxOrder+1];
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j < n; j++) a[i][j] = m_s[i+j];
+			b[i] = m_t[i];
+		}
+		int rank = n;
+		for (int j = 0; j < n; j++) {
+			var d = a[j][j];
+			for (int k = 0; k < j; k++) d -= a[j][k]*a[j][k];
+			if (d <= 1e-14*a[0][0]) { rank = j; break; }
+			a[j][j] = sqrt(d);
+			for (int i = j+1; i < n; i++) {
+				var s = a[i][j];
+				for (int k = 0; k < j; k++) s -= a[i][k]*a[j][k];
+				a[i][j] = s/a[j][j];
+			}
+		}
+		// too few distinct points for the order: fit the lower order part
+		var c[MaxOrder+1];
+		for (int i = 0; i < rank; i++) {
+			var s = b[i];
+			for (int k = 0; k < i; k++) s -= a[i][k]*c[k];
+			c[i] = s/a[i][i];
+		}
+		for (int i = rank-1; i >= 0; i--) {
+			var s = c[i];
+			for (int k = i+1; k < rank; k++) s -= a[k][i]*c[k];
+			c[i] = s/a[i][i];
+		}
+		var scale = 1.;
+		for (int k = 0; k < n; k++) {
+			m_c[k] = k < rank ? c[k]*scale : 0.;
+			scale /= m_scale;
+		}
+	}
+
+	CSlidingWindow m_window;
+	int m_order;
+	var m_forget, m_scale;
+	int m_resync, m_count;
+	bool m_init;
+	var m_s[2*MaxOrder+1], m_t[MaxOrder+1], m_c[MaxOrder+1];
+	var m_shift[2*MaxOrder+1][2*MaxOrder+1];
+};
+} // namespace z
+
+#endif // ZORRO_POLYFIT_H_
@@ -0,0 +1,245 @@
+
+#ifndef ZORRO_RADIX_SORT_H_
+#define ZORRO_RADIX_SORT_H_
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "zorro/arena.h"
+#include "zorro/thread_pool.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Native replacements for sortData() and sortIdx() on large arrays.
+// The doubles are mapped to unsigned 64 bit keys in the same order (sign bit flipped for
+// positive values, all bits for negative ones) and sorted by LSD radix sort in 8 bit digits.
+// One pass over the data builds all 8 digit histograms; digits that are equal for all keys,
+// like the exponent bytes of prices in a narrow range, are skipped. The sort is stable, so
+// the index variant keeps equal values in their original order.
+// Arrays of up to 16 elements go through a branch free Batcher merge network, medium ones
+// through std::sort, and very large ones are sorted with histograms and scatters split over
+// the thread pool. The scratch buffers come from the thread arena. Because of the pool, a
+// plain exported run() that sorts large arrays must end with zorroExitRun().
+//
+//   z::radixSort(Data, Length);                          // like sortData(Data, Length)
+//   const int* Idx = z::radixSortIdx(Data, Length);      // like sortIdx(), valid until the next bar
+namespace radix_detail
+{
+	enum { NetworkSize = 16, RadixThreshold = 512, ParallelThreshold = 1 << 19, Digits = 8, Buckets = 256 };
+
+	inline unsigned long long toKey(var x) {
+		unsigned long long u;
+		memcpy(&u, &x, sizeof(u));
+		return u >> 63 ? ~u : u | 0x8000000000000000ull;
+	}
+	inline var fromKey(unsigned long long k) {
+		const unsigned long long u = k >> 63 ? k & 0x7FFFFFFFFFFFFFFFull : ~k;
+		var x;
+		memcpy(&x, &u, sizeof(x));
+		return x;
+	}
+
+	// Batcher odd-even merge sort for a fixed size; min/max compile to branch free code
+	inline void network(var* a) {
+		for (int p = 1; p < NetworkSize; p <<= 1)
+			for (int k = p; k >= 1; k >>= 1)
+				for (int j = k % p; j + k < NetworkSize; j += 2*k)
+					for (int i = 0; i < k && i + j + k < NetworkSize; i++)
+						if ((i + j)/(2*p) == (i + j + k)/(2*p)) {
+							const var x = a[i+j], y = a[i+j+k];
+							a[i+j] = x < y ? x : y;
+							a[i+j+k] = x < y ? y : x;
+						}
+	}
+	// same with indices; ties keep the lower index first, so the result is stable
+	inline void network(var* a, int* idx) {
+		for (int p = 1; p < NetworkSize; p <<= 1)
+			for (int k = p; k >= 1; k >>= 1)
+				for (int j = k % p; j + k < NetworkSize; j += 2*k)
+					for (int i = 0; i < k && i + j + k < NetworkSize; i++)
+						if ((i + j)/(2*p) == (i + j + k)/(2*p)) {
+							const var x = a[i+j], y = a[i+j+k];
+							const int ix = idx[i+j], iy = idx[i+j+k];
+							const bool swap = y < x || (y == x && iy < ix);
+							a[i+j] = swap ? y : x;
+							a[i+j+k] = swap ? x : y;
+							idx[i+j] = swap ? iy : ix;
+							idx[i+j+k] = swap ? ix : iy;
+						}
+	}
+
+	// padded with +infinity, which sorts behind all values but NaN
+	inline void sortSmall(var* data, int n) {
+		var a[NetworkSize];
+		for (int i = 0; i < NetworkSize; i++) a[i] = i < n ? data[i] : HUGE_VAL;
+		network(a);
+		for (int i = 0; i < n; i++) data[i] = a[i];
+	}
+	inline void sortSmall(const var* data, int n, int* index) {
+		var a[NetworkSize];
+		int idx[NetworkSize];
+		for (int i = 0; i < NetworkSize; i++) {
+			a[i] = i < n ? data[i] : HUGE_VAL;
+			idx[i] = i;
+		}
+		network(a, idx);
+		for (int i = 0; i < n; i++) index[i] = idx[i];
+	}
+
+	// all digit histograms in one pass; returns the mask of digits that need a pass
+	inline int histograms(const unsigned long long* keys, int n, unsigned* count) {
+		memset(count, 0, Digits*Buckets*sizeof(unsigned));
+		for (int i = 0; i < n; i++) {
+			const unsigned long long k = keys[i];
+			for (int d = 0; d < Digits; d++) count[d*Buckets + ((k >> (8*d)) & 0xFF)]++;
+		}
+		int mask = 0;
+		for (int d = 0; d < Digits; d++)
+			if (count[d*Buckets + ((keys[0] >> (8*d)) & 0xFF)] != static_cast<unsigned>(n)) mask |= 1 << d;
+		return mask;
+	}
+
+	// sorts keys with optional payload; the result ends in keys/payload again
+	template <bool WithIndex>
+	void sortKeys(unsigned long long* keys, unsigned long long* keys2, int* idx, int* idx2, int n) {
+		unsigned count[Digits*Buckets];
+		const int mask = histograms(keys, n, count);
+		unsigned long long *src = keys, *dst = keys2;
+		int *isrc = idx, *idst = idx2;
+		for (int d = 0; d < Digits; d++) {
+			if (!(mask & (1 << d))) continue;
+			unsigned offset[Buckets], sum = 0;
+			for (int b = 0; b < Buckets; b++) { offset[b] = sum; sum += count[d*Buckets + b]; }
+			const int shift = 8*d;
+			for (int i = 0; i < n; i++) {
+				const unsigned long long k = src[i];
+				const unsigned pos = offset[(k >> shift) & 0xFF]++;
+				dst[pos] = k;
+				if (WithIndex) idst[pos] = isrc[i];
+			}
+			std::swap(src, dst);
+			if (WithIndex) std::swap(isrc, idst);
+		}
+		if (src != keys) {
+			memcpy(keys, src, n*sizeof(unsigned long long));
+			if (WithIndex) memcpy(idx, isrc, n*sizeof(int));
+		}
+	}
+
+	// the same with per-block histograms and scatters on the thread pool; the blocks hold other
+	// keys after every pass, so each pass counts its digit per block again
+	template <bool WithIndex>
+	void sortKeysParallel(unsigned long long* keys, unsigned long long* keys2, int* idx, int* idx2, int n) {
+		const int blocks = (std::min)(threadPool().size() + 1, 32)*4;
+		const int blockSize = (n + blocks - 1)/blocks;
+		std::vector<unsigned> count(static_cast<size_t>(blocks)*Digits*Buckets);
+		threadPool().parallelForEach(0, blocks, [&](int b) {
+			const int i0 = (std::min)(n, b*blockSize), i1 = (std::min)(n, i0 + blockSize);
+			unsigned* c = &count[static_cast<size_t>(b)*Digits*Buckets];
+			memset(c, 0, Digits*Buckets*sizeof(unsigned));
+			for (int i = i0; i < i1; i++)
+				for (int d = 0; d < Digits; d++) c[d*Buckets + ((keys[i] >> (8*d)) & 0xFF)]++;
+		});
+		int mask = 0;
+		for (int d = 0; d < Digits; d++) {
+			const int v = static_cast<int>((keys[0] >> (8*d)) & 0xFF);
+			unsigned total = 0;
+			for (int b = 0; b < blocks; b++) total += count[(static_cast<size_t>(b)*Digits + d)*Buckets + v];
+			if (total != static_cast<unsigned>(n)) mask |= 1 << d;
+		}
+		std::vector<unsigned> offset(static_cast<size_t>(blocks)*Buckets);
+		unsigned long long *src = keys, *dst = keys2;
+		int *isrc = idx, *idst = idx2;
+		bool first = true;
+		for (int d = 0; d < Digits; d++) {
+			if (!(mask & (1 << d))) continue;
+			const int shift = 8*d;
+			if (first) {
+				for (int b = 0; b < blocks; b++)
+					memcpy(&offset[static_cast<size_t>(b)*Buckets], &count[(static_cast<size_t>(b)*Digits + d)*Buckets], Buckets*sizeof(unsigned));
+				first = false;
+			} else threadPool().parallelForEach(0, blocks, [&](int b) {
+				const int i0 = (std::min)(n, b*blockSize), i1 = (std::min)(n, i0 + blockSize);
+				unsigned* c = &offset[static_cast<size_t>(b)*Buckets];
+				memset(c, 0, Buckets*sizeof(unsigned));
+				for (int i = i0; i < i1; i++) c[(src[i] >> shift) & 0xFF]++;
+			});
+			// exclusive prefix in bucket, then block order, for a stable scatter
+			unsigned sum = 0;
+			for (int v = 0; v < Buckets; v++)
+				for (int b = 0; b < blocks; b++) {
+					unsigned& o = offset[static_cast<size_t>(b)*Buckets + v];
+					const unsigned c = o;
+					o = sum;
+					sum += c;
+				}
+			threadPool().parallelForEach(0, blocks, [&](int b) {
+				const int i0 = (std::min)(n, b*blockSize), i1 = (std::min)(n, i0 + blockSize);
+				unsigned* o = &offset[static_cast<size_t>(b)*Buckets];
+				for (int i = i0; i < i1; i++) {
+					const unsigned long long k = src[i];
+					const unsigned pos = o[(k >> shift) & 0xFF]++;
+					dst[pos] = k;
+					if (WithIndex) idst[pos] = isrc[i];
+				}
+			});
+			std::swap(src, dst);
+			if (WithIndex) std::swap(isrc, idst);
+		}
+		if (src != keys) {
+			memcpy(keys, src, n*sizeof(unsigned long long));
+			if (WithIndex) memcpy(idx, isrc, n*sizeof(int));
+		}
+	}
+} // namespace radix_detail
+
+// sorts data ascending in place, like sortData()
+inline void radixSort(var* data, int length, bool parallel = true)
+{
+	using namespace radix_detail;
+	if (length <= 1) return;
+	if (length <= NetworkSize) { sortSmall(data, length); return; }
+	if (length < RadixThreshold) { std::sort(data, data + length); return; }
+	CArenaScope scope(threadArena());
+	unsigned long long* keys = static_cast<unsigned long long*>(threadArena().allocate(2*length*sizeof(unsigned long long), 64));
+	for (int i = 0; i < length; i++) keys[i] = toKey(data[i]);
+	if (parallel && length >= ParallelThreshold && threadPool().size() > 0)
+		sortKeysParallel<false>(keys, keys + length, 0, 0, length);
+	else
+		sortKeys<false>(keys, keys + length, 0, 0, length);
+	for (int i = 0; i < length; i++) data[i] = fromKey(keys[i]);
+}
+
+// indices of data in ascending order, equal values in original order, like sortIdx()
+inline void radixSortIdx(const var* data, int length, int* index, bool parallel = true)
+{
+	using namespace radix_detail;
+	if (length <= 0) return;
+	if (length <= NetworkSize) { sortSmall(data, length, index); return; }
+	for (int i = 0; i < length; i++) index[i] = i;
+	if (length < RadixThreshold) {
+		std::stable_sort(index, index + length, [data](int a, int b) { return data[a] < data[b]; });
+		return;
+	}
+	CArenaScope scope(threadArena());
+	unsigned long long* keys = static_cast<unsigned long long*>(threadArena().allocate(2*length*sizeof(unsigned long long), 64));
+	int* idx2 = static_cast<int*>(threadArena().allocate(length*sizeof(int), 64));
+	for (int i = 0; i < length; i++) keys[i] = toKey(data[i]);
+	if (parallel && length >= ParallelThreshold && threadPool().size() > 0)
+		sortKeysParallel<true>(keys, keys + length, index, idx2, length);
+	else
+		sortKeys<true>(keys, keys + length, index, idx2, length);
+}
+
+// index array on the bar arena, valid until the next bar
+inline const int* radixSortIdx(const var* data, int length)
+{
+	int* index = barArena().allocArray<int>(length > 0 ? length : 1);
+	radixSortIdx(data, length, index);
+	return index;
+}
+} // namespace z
+
+#endif // ZORRO_RADIX_SORT_H_
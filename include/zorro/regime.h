@@ -0,0 +1,122 @@
+
+#ifndef ZORRO_REGIME_H_
+#define ZORRO_REGIME_H_
+
+#include <math.h>
+#include "zorro/indicators.h"
+#include "zorro/order_statistic.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Streaming market regime indicators.
+// They give the same values as the host functions on a series of the same data, but update
+// in O(log period) or O(1) per bar instead of rescanning the whole period. All comparisons
+// are exact, so the results do not depend on the update history or the platform.
+// Like the series they replace, the window is preset with the first value.
+
+// Market Meanness Index, MMI(Data,Period)
+// Every pair of adjacent values is kept in one of two order statistic trees, keyed by its older
+// value: one for down moves and one for up moves. The index is then the number of down moves
+// starting above the median plus the number of up moves starting below it.
+class CMMI
+{
+public:
+	explicit CMMI(int period = 300) : m_period(period > 2 ? period : 2), m_window(m_period), m_values(m_period),
+		m_down(m_period), m_up(m_period), m_init(false), m_y(0) {}
+
+	var update(var x) {
+		if (!m_init) {
+			m_window.fill(x);
+			for (int i = 0; i < m_period; i++) m_values.insert(x);
+			m_init = true;
+		}
+		var prev = m_window[0], dropped;
+		m_window.push(x, dropped);
+		erasePair(dropped, m_window[m_period-1]);
+		m_values.erase(dropped);
+		insertPair(prev, x);
+		m_values.insert(x);
+
+		var m = m_values.median();
+		int n = m_down.countGreater(m) + m_up.countLess(m);
+		return m_y = 100.*n/(m_period-1);
+	}
+	inline var value() const { return m_y; }
+	inline var median() const { return m_values.median(); }
+
+private:
+	inline void insertPair(var older, var newer) {
+		if (older > newer) m_down.insert(older);
+		else if (older < newer) m_up.insert(older);
+	}
+	inline void erasePair(var older, var newer) {
+		if (older > newer) m_down.erase(older);
+		else if (older < newer) m_up.erase(older);
+	}
+
+	int m_period;
+	CSlidingWindow m_window;
+	COrderStatistic m_values, m_down, m_up;
+	bool m_init;
+	var m_y;
+};
+
+// fractal dimension, FractalDimension(Data,Period)
+// The ranges of the recent half, the older half and the whole period come from three sliding
+// min/max queues; the older half is fed through a delay line of half the period.
+class CFractalDimension
+{
+public:
+	explicit CFractalDimension(int period = 30) : m_period((period > 2 ? period : 2) & ~1), m_half(m_period/2),
+		m_delay(m_half), m_recent(m_half), m_older(m_half), m_whole(m_period), m_init(false), m_y(1) {}
+
+	var update(var x) {
+		if (!m_init) {
+			m_delay.fill(x);
+			m_init = true;
+		}
+		var dropped;
+		m_delay.push(x, dropped);
+		m_recent.update(x);
+		m_older.update(dropped);
+		m_whole.update(x);
+
+		var n1 = (m_recent.highest() - m_recent.lowest())/m_half;
+		var n2 = (m_older.highest() - m_older.lowest())/m_half;
+		var n3 = (m_whole.highest() - m_whole.lowest())/m_period;
+		if (n1+n2 <= 0. || n3 <= 0.) return m_y = 1.;
+		return m_y = (log(n1+n2) - log(n3))/log(2.);
+	}
+	inline var value() const { return m_y; }
+
+private:
+	int m_period, m_half;
+	CSlidingWindow m_delay;
+	CMinMax m_recent, m_older, m_whole;
+	bool m_init;
+	var m_y;
+};
+
+// Hurst exponent, Hurst(Data,Period): 2 minus the fractal dimension, clipped to 0..1
+class CHurst
+{
+public:
+	explicit CHurst(int period = 30) : m_fd(period), m_y(0.5) {}
+
+	inline var update(var x) {
+		var h = 2. - m_fd.update(x);
+		if (h < 0.) h = 0.;
+		else if (h > 1.) h = 1.;
+		return m_y = h;
+	}
+	inline var value() const { return m_y; }
+	inline var dimension() const { return m_fd.value(); }
+
+private:
+	CFractalDimension m_fd;
+	var m_y;
+};
+} // namespace z
+
+#endif // ZORRO_REGIME_H_
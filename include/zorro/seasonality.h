@@ -0,0 +1,209 @@
+
+#ifndef ZORRO_SEASONALITY_H_
+#define ZORRO_SEASONALITY_H_
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "zorro/calendar.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Seasonality model for season(): the average change of the data over several horizons,
+// collected in hour-of-week or day-of-year buckets of a time zone.
+// Every bar resolves the changes of the bars 'horizon' bars ago and adds them to their buckets,
+// so the profiles grow incrementally; with 'decay' < 1 older seasons fade out per bucket.
+// Lookups of the current bucket are O(1). Profiles can be built offline from .t6 history,
+// saved, and loaded at startup. Feed log(price) for relative changes.
+//
+//   static z::CSeasonality Season(z::CSeasonality::HOUR_OF_WEEK, ETimeZone::ET);
+//   if (is(INITRUN)) { Season.addHorizon(1); Season.addHorizon(4); Season.load("Data\\EURUSD.sea"); }
+//   Season.update(log(priceClose()));
+//   if (Season.strength(1) > 2.) enterLong();           // 4 bars ahead, t-statistic above 2
+//
+//   // offline: z::CSeasonality S(...); S.addHorizon(1); S.build("History\\EURUSD_2023.t6", 60); S.save(...);
+class CSeasonality
+{
+public:
+	enum EProfile { HOUR_OF_WEEK, DAY_OF_YEAR };
+	enum { MaxHorizons = 8 };
+
+	// bucket statistics of one horizon
+	struct SStat
+	{
+		var n, sum, sum2;
+	};
+
+	explicit CSeasonality(EProfile profile = HOUR_OF_WEEK, ETimeZone zone = ETimeZone::UTC, var decay = 1.)
+		: m_profile(profile), m_zone(zone), m_decay(decay > 0. && decay <= 1. ? decay : 1.),
+		m_head(0), m_count(0), m_bucket(0) {
+		m_stats.resize(buckets()*MaxHorizons);
+		clear();
+	}
+
+	// returns the horizon index, -1 when full
+	int addHorizon(int bars) {
+		if (horizons() >= MaxHorizons || bars < 1) return -1;
+		m_horizons.push_back(bars);
+		const int longest = *std::max_element(m_horizons.begin(), m_horizons.end());
+		m_history.assign(longest + 1, SBar());
+		m_head = m_count = 0;
+		return horizons() - 1;
+	}
+	inline int horizons() const { return static_cast<int>(m_horizons.size()); }
+	inline int horizon(int h) const { return m_horizons[h]; }
+	inline int buckets() const { return m_profile == HOUR_OF_WEEK ? 7*24 : 366; }
+
+	// resets the profiles and the bar history
+	void clear() {
+		SStat zero = { 0, 0, 0 };
+		std::fill(m_stats.begin(), m_stats.end(), zero);
+		m_head = m_count = 0;
+	}
+
+	// bucket of a local time; day-of-year buckets keep March 1 at the same index in all years
+	inline int bucket(const SCivilTime& t) const {
+		if (m_profile == HOUR_OF_WEEK) return (t.dow - 1)*24 + t.hour;
+		const bool leap = (t.year % 4 == 0 && t.year % 100 != 0) || t.year % 400 == 0;
+		return t.doy - 1 + (!leap && t.month > 2 ? 1 : 0);
+	}
+	inline int bucket(DATE time) const { return bucket(localTime(time, m_zone)); }
+
+	// adds the value of a new bar
+	void update(DATE time, var value) { add(bucket(time), value); }
+	// current bar, with the local time from the shared bar calendar
+	void update(var value) { add(bucket(barCalendar().local(m_zone)), value); }
+
+	// statistics of a bucket and horizon index
+	inline const SStat& stat(int bucket, int h) const { return m_stats[bucket*MaxHorizons + h]; }
+	inline var count(int h) const { return stat(m_bucket, h).n; }
+
+	// average change over horizon h from the current bucket
+	inline var forecast(int h) const { return mean(m_bucket, h); }
+	inline var mean(int bucket, int h) const {
+		const SStat& s = stat(bucket, h);
+		return s.n > 0. ? s.sum/s.n : 0.;
+	}
+	inline var deviation(int bucket, int h) const {
+		const SStat& s = stat(bucket, h);
+		if (s.n < 2.) return 0.;
+		const var m = s.sum/s.n, v = s.sum2/s.n - m*m;
+		return v > 0. ? sqrt(v*s.n/(s.n - 1.)) : 0.;
+	}
+	// t-statistic of the average change, the significance of the season
+	inline var strength(int h) const {
+		const var d = deviation(m_bucket, h);
+		return d > 0. ? mean(m_bucket, h)/d*sqrt(stat(m_bucket, h).n) : 0.;
+	}
+	// forecasts of all horizons
+	inline void forecasts(var* out) const { for (int h = 0; h < horizons(); h++) out[h] = forecast(h); }
+
+	// builds the profiles from a .t6 file, resampled to bars of 'barMinutes' by their close;
+	// the bar time is the end of its period like in the simulation. Returns the number of bars.
+	int build(const char* filename, int barMinutes, bool useLog = true) {
+		FILE* file = fopen(filename, "rb");
+		if (!file) return 0;
+		std::vector<T6> ticks;
+		T6 block[1024];
+		size_t n;
+		while ((n = fread(block, sizeof(T6), 1024, file)) > 0) ticks.insert(ticks.end(), block, block + n);
+		fclose(file);
+		// .t6 history is stored newest first
+		if (ticks.size() > 1 && ticks.front().time > ticks.back().time) std::reverse(ticks.begin(), ticks.end());
+		const var period = (barMinutes > 0 ? barMinutes : 60)/1440.;
+		int bars = 0;
+		for (size_t i = 0; i < ticks.size(); ) {
+			const var end = (floor(ticks[i].time/period - 1e-9) + 1.)*period;
+			var close = ticks[i].fClose;
+			while (i < ticks.size() && ticks[i].time <= end + 1e-9/86400.) close = ticks[i++].fClose;
+			if (useLog && close <= 0.) continue;
+			update(end, useLog ? log(close) : close);
+			bars++;
+		}
+		return bars;
+	}
+
+	// binary profile file: header, horizons, statistics as doubles
+	bool save(const char* filename) const {
+		FILE* file = fopen(filename, "wb");
+		if (!file) return false;
+		SHeader h = { { 'Z', 'S', 'E', 'A' }, 1, static_cast<unsigned>(m_profile), static_cast<int>(m_zone), static_cast<unsigned>(horizons()), 0 };
+		bool ok = fwrite(&h, sizeof(h), 1, file) == 1;
+		int horizon[MaxHorizons] = { 0 };
+		for (int i = 0; i < horizons(); i++) horizon[i] = m_horizons[i];
+		ok = ok && fwrite(horizon, sizeof(int), MaxHorizons, file) == MaxHorizons;
+		ok = ok && fwrite(&m_stats[0], sizeof(SStat), m_stats.size(), file) == m_stats.size();
+		fclose(file);
+		return ok;
+	}
+
+	bool load(const char* filename) {
+		FILE* file = fopen(filename, "rb");
+		if (!file) return false;
+		SHeader h;
+		bool ok = fread(&h, sizeof(h), 1, file) == 1 && h.magic[0] == 'Z' && h.magic[1] == 'S' && h.magic[2] == 'E' && h.magic[3] == 'A' && h.version == 1
+			&& h.profile <= DAY_OF_YEAR && h.horizons >= 1 && h.horizons <= MaxHorizons;
+		int horizon[MaxHorizons];
+		ok = ok && fread(horizon, sizeof(int), MaxHorizons, file) == MaxHorizons;
+		if (ok) {
+			m_profile = static_cast<EProfile>(h.profile);
+			m_zone = static_cast<ETimeZone>(h.zone);
+			m_horizons.clear();
+			for (unsigned i = 0; i < h.horizons; i++) addHorizon(horizon[i]);
+			m_stats.resize(buckets()*MaxHorizons);
+			ok = fread(&m_stats[0], sizeof(SStat), m_stats.size(), file) == m_stats.size();
+			if (!ok) clear();
+		}
+		fclose(file);
+		return ok;
+	}
+
+private:
+	struct SHeader
+	{
+		char magic[4];
+		unsigned version, profile;
+		int zone;
+		unsigned horizons, reserved;
+	};
+
+	struct SBar
+	{
+		int bucket;
+		var value;
+	};
+
+	// stores the bar, and resolves the changes of the bars one horizon ago
+	void add(int bucket, var value) {
+		m_bucket = bucket;
+		if (m_history.empty()) return;
+		const int size = static_cast<int>(m_history.size());
+		m_head = (m_head + 1) % size;
+		m_history[m_head].bucket = bucket;
+		m_history[m_head].value = value;
+		if (m_count < size) m_count++;
+		for (int h = 0; h < horizons(); h++) {
+			const int bars = m_horizons[h];
+			if (bars >= m_count) continue;
+			const SBar& past = m_history[(m_head - bars + size) % size];
+			const var change = value - past.value;
+			SStat& s = m_stats[past.bucket*MaxHorizons + h];
+			s.n = s.n*m_decay + 1.;
+			s.sum = s.sum*m_decay + change;
+			s.sum2 = s.sum2*m_decay + change*change;
+		}
+	}
+
+	EProfile m_profile;
+	ETimeZone m_zone;
+	var m_decay;
+	std::vector<int> m_horizons;
+	std::vector<SStat> m_stats;
+	std::vector<SBar> m_history;
+	int m_head, m_count, m_bucket;
+};
+} // namespace z
+
+#endif // ZORRO_SEASONALITY_H_
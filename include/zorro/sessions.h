@@ -0,0 +1,284 @@
+
+#ifndef ZORRO_SESSIONS_H_
+#define ZORRO_SESSIONS_H_
+
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include "zorro/calendar.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Precomputed trading session calendar: market(), workday(), minutesWithin() and the weekend
+// rules of StartWeek/EndWeek, StartMarket/EndMarket and holidays, without host calls.
+// The rules are compiled once into a sorted list of UTC minutes where the session state changes,
+// with an index per day; a lookup is an index access plus a step over the few changes of a day.
+// Every segment also stores the open minutes before it and the next open/close switch, so
+// minutes to close or open and the open minutes of any interval are O(1) as well.
+// The calendar covers whole years and grows when a date outside the range is looked up.
+//
+//   z::CSessionCalendar& S = z::assetSessions();   // compiled once per asset from the globals
+//   if (S.open(g->tNow) && S.minutesToClose(g->tNow) > 30) enterLong();
+class CSessionCalendar
+{
+public:
+	// state bits of a session segment
+	enum EState { MARKET = 1, WEEKEND = 2, HOLIDAY = 4, OPEN = 8 };
+
+	struct SRules
+	{
+		int barZone;                   // zone of StartWeek, EndWeek and holidays, like BarZone
+		int startWeek, endWeek;        // dhhmm, d = 1..7 Monday..Sunday
+		int marketZone;                // zone of the market hours, like AssetZone
+		int startMarket, endMarket;    // hhmm
+
+		bool operator==(const SRules& r) const {
+			return barZone == r.barZone && startWeek == r.startWeek && endWeek == r.endWeek &&
+				marketZone == r.marketZone && startMarket == r.startMarket && endMarket == r.endMarket;
+		}
+	};
+
+	// the rules of the current asset from the globals
+	static SRules globalRules() {
+		SRules r;
+		r.barZone = static_cast<int>(g->nBarZone);
+		r.startWeek = g->nStartWeek;
+		r.endWeek = g->nEndWeek;
+		r.marketZone = g->asset ? g->asset->nZone : r.barZone;
+		r.startMarket = g->nStartMarket;
+		r.endMarket = g->nEndMarket;
+		return r;
+	}
+
+	CSessionCalendar() : m_firstDay(0), m_lastDay(0) { m_rules = SRules(); }
+	explicit CSessionCalendar(const SRules& rules) : m_rules(rules), m_firstDay(0), m_lastDay(0) {}
+
+	inline const SRules& rules() const { return m_rules; }
+	void setRules(const SRules& rules) {
+		if (m_rules == rules) return;
+		m_rules = rules;
+		invalidate();
+	}
+
+	// holidays in bar zone local dates: yyyymmdd for a single date, mmdd for every year
+	void addHoliday(int date) {
+		if (date < 10000) m_yearly.push_back(date);
+		else m_holidays.push_back(calendar_detail::daysFromCivil(date/10000, date/100 % 100, date % 100));
+		invalidate();
+	}
+	void clearHolidays() { m_yearly.clear(); m_holidays.clear(); invalidate(); }
+
+	// compiles the years from..to; done automatically on lookup
+	void compile(int fromYear, int toYear) {
+		std::sort(m_holidays.begin(), m_holidays.end());
+		m_firstDay = calendar_detail::daysFromCivil(fromYear, 1, 1);
+		m_lastDay = calendar_detail::daysFromCivil(toYear+1, 1, 1);
+		build();
+	}
+
+	// state bits at a time
+	inline int state(DATE t) { return m_state[find(minutes(t))]; }
+	inline bool open(DATE t) { return (state(t) & OPEN) != 0; }
+	inline bool market(DATE t) { return (state(t) & MARKET) != 0; }
+	inline bool workday(DATE t) { return (state(t) & (WEEKEND|HOLIDAY)) == 0; }
+	inline bool weekend(DATE t) { return (state(t) & WEEKEND) != 0; }
+	inline bool holiday(DATE t) { return (state(t) & HOLIDAY) != 0; }
+
+	// minutes until the session closes, 0 when closed
+	inline int minutesToClose(DATE t) {
+		const int m = minutes(t), i = find(m);
+		return m_state[i] & OPEN ? nextSwitch(m, i) - m : 0;
+	}
+	// minutes until the session opens, 0 when open
+	inline int minutesToOpen(DATE t) {
+		const int m = minutes(t), i = find(m);
+		return m_state[i] & OPEN ? 0 : nextSwitch(m, i) - m;
+	}
+
+	// open minutes between two times, f.i. of a bar period like minutesWithin()
+	inline int openMinutes(DATE from, DATE to) {
+		if (to <= from) return 0;
+		return openBefore(minutes(to)) - openBefore(minutes(from));
+	}
+
+	// bulk lookup of ascending times, f.i. the bars of a history; returns the number of open bars
+	int states(const DATE* times, int n, unsigned char* out) {
+		if (n <= 0) return 0;
+		cover(times[0]);
+		cover(times[n-1]);
+		int count = 0, i = find(minutes(times[0]));
+		const int last = static_cast<int>(m_minute.size()) - 1;
+		for (int k = 0; k < n; k++) {
+			const int m = minutes(times[k]);
+			if (m < m_minute[i]) i = find(m);
+			while (i < last && m_minute[i+1] <= m) i++;
+			out[k] = m_state[i];
+			count += (m_state[i] & OPEN) != 0;
+		}
+		return count;
+	}
+
+	inline int segments() const { return static_cast<int>(m_minute.size()); }
+
+private:
+	enum { MinutesPerDay = 1440 };
+
+	static inline int minutes(DATE t) {
+		const long long s = calendar_detail::seconds(t);
+		return static_cast<int>(s >= 0 ? s/60 : (s - 59)/60);
+	}
+	static inline int hhmm(int t) { return t/100*60 + t % 100; }
+
+	inline void invalidate() { m_minute.clear(); }
+
+	// makes sure the year of t is compiled
+	void cover(DATE t) {
+		const long day = static_cast<long>(floor(t));
+		if (!m_minute.empty() && day >= m_firstDay && day < m_lastDay) return;
+		int y, m, d;
+		calendar_detail::civilFromDays(day, y, m, d);
+		int from = y, to = y;
+		if (!m_minute.empty()) {
+			calendar_detail::civilFromDays(m_firstDay, from, m, d);
+			calendar_detail::civilFromDays(m_lastDay-1, to, m, d);
+			from = std::min(from, y);
+			to = std::max(to, y);
+		}
+		compile(from, to);
+	}
+
+	// segment index of minute m
+	inline int find(int m) {
+		if (m_minute.empty() || m < m_firstDay*MinutesPerDay || m >= m_lastDay*MinutesPerDay) cover(m/static_cast<var>(MinutesPerDay));
+		int i = m_day[m/MinutesPerDay - m_firstDay];
+		const int last = static_cast<int>(m_minute.size()) - 1;
+		while (i < last && m_minute[i+1] <= m) i++;
+		return i;
+	}
+
+	// next open/close switch after minute m in segment i; looks one more year ahead at the range end
+	int nextSwitch(int m, int i) {
+		if (m_switch[i] < m_lastDay*MinutesPerDay) return m_switch[i];
+		cover(m_lastDay + 1.);
+		return m_switch[find(m)];
+	}
+
+	inline int openBefore(int m) {
+		const int i = find(m);
+		return m_open[i] + (m_state[i] & OPEN ? m - m_minute[i] : 0);
+	}
+
+	// state by the rules, for the minute starting at UTC minute m
+	int evaluate(int m) const {
+		const DATE t = (m + 0.5)/MinutesPerDay;
+		const SCivilTime local = localTime(t, static_cast<ETimeZone>(m_rules.barZone));
+		int s = 0;
+		const int tow = local.tow;
+		if (m_rules.endWeek < m_rules.startWeek) {
+			if (tow >= m_rules.endWeek && tow < m_rules.startWeek) s |= WEEKEND;
+		} else if (m_rules.endWeek > m_rules.startWeek) {
+			if (tow >= m_rules.endWeek || tow < m_rules.startWeek) s |= WEEKEND;
+		}
+		if (std::binary_search(m_holidays.begin(), m_holidays.end(), local.days) ||
+			std::find(m_yearly.begin(), m_yearly.end(), local.month*100 + local.day) != m_yearly.end())
+			s |= HOLIDAY;
+		const int tod = m_rules.marketZone == m_rules.barZone ? local.tod :
+			localTime(t, static_cast<ETimeZone>(m_rules.marketZone)).tod;
+		if (m_rules.startMarket < m_rules.endMarket) {
+			if (tod >= m_rules.startMarket && tod < m_rules.endMarket) s |= MARKET;
+		} else if (m_rules.startMarket > m_rules.endMarket) {
+			if (tod >= m_rules.startMarket || tod < m_rules.endMarket) s |= MARKET;
+		} else s |= MARKET;
+		if (s == MARKET) s |= OPEN;
+		return s;
+	}
+
+	// candidate minutes are all full UTC hours, where the daylight saving changes happen,
+	// and the local rule times under standard and daylight offset; the state is evaluated there
+	void build() {
+		const int first = m_firstDay*MinutesPerDay, end = m_lastDay*MinutesPerDay;
+		int local[6] = { hhmm(m_rules.startMarket % 10000), hhmm(m_rules.endMarket % 10000),
+			hhmm(m_rules.startWeek % 10000), hhmm(m_rules.endWeek % 10000), 0, 0 };
+		const int zones[6] = { m_rules.marketZone, m_rules.marketZone, m_rules.barZone, m_rules.barZone, m_rules.barZone, m_rules.marketZone };
+		std::vector<int> candidates;
+		candidates.reserve((m_lastDay - m_firstDay + 2)*(24 + 24));
+		for (long day = m_firstDay - 1; day <= m_lastDay; day++) {
+			const int base = static_cast<int>(day)*MinutesPerDay;
+			for (int h = 0; h < 24; h++) candidates.push_back(base + 60*h);
+			for (int k = 0; k < 6; k++) {
+				const int zone = zones[k] == static_cast<int>(ETimeZone::UTC) ? 0 : zones[k];
+				candidates.push_back(base + local[k] - 60*zone);
+				candidates.push_back(base + local[k] - 60*zone - 60);
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+		m_minute.clear();
+		m_state.clear();
+		m_minute.push_back(first);
+		m_state.push_back(static_cast<unsigned char>(evaluate(first)));
+		for (size_t i = 0; i < candidates.size(); i++) {
+			const int m = candidates[i];
+			if (m <= m_minute.back() || m >= end) continue;
+			const int s = evaluate(m);
+			if (s == m_state.back()) continue;
+			m_minute.push_back(m);
+			m_state.push_back(static_cast<unsigned char>(s));
+		}
+		const int n = static_cast<int>(m_minute.size());
+		// open minutes before each segment, and the next switch between open and closed
+		m_open.resize(n);
+		m_switch.resize(n);
+		int open = 0;
+		for (int i = 0; i < n; i++) {
+			m_open[i] = open;
+			const int next = i+1 < n ? m_minute[i+1] : end;
+			if (m_state[i] & OPEN) open += next - m_minute[i];
+		}
+		for (int i = n-1; i >= 0; i--) {
+			const int next = i+1 < n ? m_minute[i+1] : end;
+			m_switch[i] = i+1 < n && ((m_state[i+1] ^ m_state[i]) & OPEN) == 0 ? m_switch[i+1] : next;
+		}
+		m_day.resize(m_lastDay - m_firstDay);
+		for (int d = 0, i = 0; d < static_cast<int>(m_day.size()); d++) {
+			const int m = first + d*MinutesPerDay;
+			while (i+1 < n && m_minute[i+1] <= m) i++;
+			m_day[d] = i;
+		}
+	}
+
+	SRules m_rules;
+	std::vector<long> m_holidays;
+	std::vector<int> m_yearly;
+	long m_firstDay, m_lastDay;
+	std::vector<int> m_minute, m_open, m_switch, m_day;
+	std::vector<unsigned char> m_state;
+};
+
+// session calendar of the current asset, compiled once from the globals per asset and thread;
+// the reference stays valid when calendars of further assets are added. The calendars are
+// indexed by the ASSET pointer, and the last one is tried first, since consecutive calls
+// mostly come from the same asset; a rule change costs only the comparison of six ints.
+inline CSessionCalendar& assetSessions()
+{
+	struct SEntry { const void* asset; CSessionCalendar sessions; };
+	static thread_local std::deque<SEntry> s_calendars;
+	static thread_local std::unordered_map<const void*, SEntry*> s_index;
+	static thread_local SEntry* s_last = 0;
+	const CSessionCalendar::SRules rules = CSessionCalendar::globalRules();
+	if (!s_last || s_last->asset != g->asset) {
+		std::unordered_map<const void*, SEntry*>::iterator it = s_index.find(g->asset);
+		if (it == s_index.end()) {
+			SEntry entry = { g->asset, CSessionCalendar(rules) };
+			s_calendars.push_back(entry);
+			it = s_index.insert(std::make_pair(entry.asset, &s_calendars.back())).first;
+		}
+		s_last = it->second;
+	}
+	s_last->sessions.setRules(rules);
+	return s_last->sessions;
+}
+} // namespace z
+
+#endif // ZORRO_SESSIONS_H_
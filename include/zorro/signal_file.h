@@ -0,0 +1,411 @@
+
+#ifndef ZORRO_SIGNAL_FILE_H_
+#define ZORRO_SIGNAL_FILE_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Binary columnar export of advise signals, the replacement for the SIGNALS .csv.
+// Rows are collected in blocks; full blocks are written by a background thread, so write()
+// only copies the values. Layout, all little endian:
+//   header   "ZSIG", version, numSignals, blockRows (16 bytes)
+//   blocks   "ZBLK", rows, then the columns, each starting at a 32 byte aligned file offset:
+//            time (double DATE), asset id, algo id, side (int32, 1 long, -1 short),
+//            numSignals signal columns and the objective (float32)
+//   names    number of assets, NUL-terminated asset names, number of algos, algo names
+//   trailer  names offset, total rows (int64), number of blocks (int32), "ZEND"
+// Every column of a block is a plain array that numpy can read with frombuffer() or memmap()
+// at its offset; CSignalReader maps the file and returns the columns without copying.
+//
+//   static z::CSignalWriter Signals;
+//   if (is(INITRUN)) Signals.open("Data\\Signals.zsig", 8);
+//   Signals.write(Sig, 8, TradeResult);    // current asset, algo and bar time
+//   if (is(EXITRUN)) Signals.close();
+class CSignalWriter
+{
+	struct SBlock
+	{
+		int rows;
+		std::vector<double> time;
+		std::vector<int> asset, algo, side;
+		std::vector<float> values;   // column-major: numSignals signals, then the objective
+	};
+
+public:
+	struct SHeader
+	{
+		char magic[4];
+		int version, numSignals, blockRows;
+	};
+	struct STrailer
+	{
+		long long namesOffset, rows;
+		int blocks;
+		char magic[4];
+	};
+	enum { Align = 32, MaxQueued = 4 };
+
+	explicit CSignalWriter(int blockRows = 65536) :
+		m_blockRows(blockRows > 0 ? blockRows : 65536), m_numSignals(0), m_file(0), m_fill(0), m_pos(0), m_rows(0), m_blocks(0),
+		m_stop(false), m_error(false), m_lastAsset(-1), m_lastAlgo(-1) {}
+	~CSignalWriter() { close(); }
+
+	bool open(const char* filename, int numSignals) {
+		close();
+		m_file = fopen(filename, "wb");
+		if (!m_file) return false;
+		m_numSignals = numSignals;
+		m_pos = m_rows = 0;
+		m_blocks = 0;
+		m_error = false;
+		m_stop = false;
+		m_assets.clear();
+		m_algos.clear();
+		m_lastAsset = m_lastAlgo = -1;
+		SHeader h = { { 'Z', 'S', 'I', 'G' }, 1, numSignals, m_blockRows };
+		put(&h, sizeof(h));
+		m_fill = takeBlock();
+		m_thread = std::thread(&CSignalWriter::work, this);
+		return !m_error;
+	}
+
+	inline bool isOpen() const { return m_file != 0; }
+
+	void write(const char* asset, const char* algo, DATE time, int side, const var* signals, int numSignals, var objective) {
+		if (!m_fill || numSignals != m_numSignals) return;
+		SBlock& b = *m_fill;
+		const int r = b.rows++;
+		b.time[r] = time;
+		b.asset[r] = nameId(m_assets, asset, m_lastAsset);
+		b.algo[r] = nameId(m_algos, algo, m_lastAlgo);
+		b.side[r] = side;
+		for (int c = 0; c < numSignals; c++) b.values[static_cast<size_t>(c)*m_blockRows + r] = static_cast<float>(signals[c]);
+		b.values[static_cast<size_t>(numSignals)*m_blockRows + r] = static_cast<float>(objective);
+		m_rows++;
+		if (b.rows == m_blockRows) {
+			queue(m_fill);
+			m_fill = takeBlock();
+		}
+	}
+
+	// row of the current asset and algo at the current bar time
+	inline void write(const var* signals, int numSignals, var objective, int side = 1) {
+		write(g->asset ? g->asset->sName : "", g->sAlgo ? g->sAlgo : "", g->tNow, side, signals, numSignals, objective);
+	}
+
+	// writes the last block, the names and the trailer
+	bool close() {
+		if (!m_file) return false;
+		if (m_fill && m_fill->rows > 0) queue(m_fill);
+		else if (m_fill) recycle(m_fill);
+		m_fill = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		if (m_thread.joinable()) m_thread.join();
+
+		STrailer t;
+		t.namesOffset = m_pos;
+		t.rows = m_rows;
+		t.blocks = m_blocks;
+		memcpy(t.magic, "ZEND", 4);
+		putNames(m_assets);
+		putNames(m_algos);
+		put(&t, sizeof(t));
+		const bool ok = !m_error && fclose(m_file) == 0;
+		m_file = 0;
+		for (size_t i = 0; i < m_free.size(); i++) delete m_free[i];
+		m_free.clear();
+		return ok;
+	}
+
+	inline long long rows() const { return m_rows; }
+	inline int numSignals() const { return m_numSignals; }
+
+	// file offsets of the columns of a block with 'rows' rows, relative to the block start
+	static inline long long alignUp(long long pos) { return (pos + Align - 1) & ~static_cast<long long>(Align - 1); }
+	static void columnOffsets(long long blockStart, int rows, int numSignals, long long* offsets) {
+		long long pos = alignUp(blockStart + 8);
+		offsets[0] = pos;
+		pos = alignUp(pos + 8LL*rows);
+		for (int c = 1; c < 4 + numSignals + 1; c++) {
+			offsets[c] = pos;
+			pos = alignUp(pos + 4LL*rows);
+		}
+		offsets[4 + numSignals + 1] = pos;   // end of the block
+	}
+
+private:
+	CSignalWriter(const CSignalWriter&);
+	CSignalWriter& operator=(const CSignalWriter&);
+
+	// id of a name; consecutive rows mostly have the same asset and algo, so try the last id first.
+	// The host rewrites its name buffers in place, so the contents are compared, not the pointers.
+	static int nameId(std::vector<std::string>& names, const char* name, int& lastId) {
+		if (!name) name = "";
+		if (lastId >= 0 && strcmp(name, names[lastId].c_str()) == 0) return lastId;
+		int id = 0;
+		for (; id < static_cast<int>(names.size()); id++)
+			if (names[id] == name) break;
+		if (id == static_cast<int>(names.size())) names.push_back(name);
+		lastId = id;
+		return id;
+	}
+
+	SBlock* takeBlock() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		// don't let the writer fall behind by more than a few blocks
+		m_done.wait(lock, [this]() { return m_queue.size() < MaxQueued; });
+		SBlock* b;
+		if (!m_free.empty()) {
+			b = m_free.back();
+			m_free.pop_back();
+		} else {
+			b = new SBlock;
+			b->time.resize(m_blockRows);
+			b->asset.resize(m_blockRows);
+			b->algo.resize(m_blockRows);
+			b->side.resize(m_blockRows);
+			b->values.resize(static_cast<size_t>(m_numSignals + 1)*m_blockRows);
+		}
+		b->rows = 0;
+		return b;
+	}
+
+	void queue(SBlock* b) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.push_back(b);
+		}
+		m_wake.notify_all();
+	}
+
+	void recycle(SBlock* b) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free.push_back(b);
+		}
+		m_done.notify_all();
+	}
+
+	void work() {
+		for (;;) {
+			SBlock* b;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+				if (m_queue.empty()) return;
+				b = m_queue.front();
+				m_queue.erase(m_queue.begin());
+			}
+			putBlock(*b);
+			recycle(b);
+		}
+	}
+
+	void putBlock(const SBlock& b) {
+		const int n = m_numSignals;
+		long long offsets[4 + 64 + 2];
+		std::vector<long long> large;
+		long long* off = offsets;
+		if (n > 64) { large.resize(4 + n + 2); off = &large[0]; }
+		columnOffsets(m_pos, b.rows, n, off);
+		const char magic[4] = { 'Z', 'B', 'L', 'K' };
+		put(magic, 4);
+		put(&b.rows, 4);
+		pad(off[0]); put(&b.time[0], 8*b.rows);
+		pad(off[1]); put(&b.asset[0], 4*b.rows);
+		pad(off[2]); put(&b.algo[0], 4*b.rows);
+		pad(off[3]); put(&b.side[0], 4*b.rows);
+		for (int c = 0; c <= n; c++) {
+			pad(off[4 + c]);
+			put(&b.values[static_cast<size_t>(c)*m_blockRows], 4*b.rows);
+		}
+		pad(off[4 + n + 1]);
+		m_blocks++;
+	}
+
+	void putNames(const std::vector<std::string>& names) {
+		int count = static_cast<int>(names.size());
+		put(&count, 4);
+		for (size_t i = 0; i < names.size(); i++) put(names[i].c_str(), names[i].size() + 1);
+	}
+
+	inline void put(const void* data, size_t bytes) {
+		if (bytes && fwrite(data, 1, bytes, m_file) != bytes) m_error = true;
+		m_pos += bytes;
+	}
+	inline void pad(long long to) {
+		static const char zeros[Align] = { 0 };
+		if (to > m_pos) put(zeros, static_cast<size_t>(to - m_pos));
+	}
+
+	int m_blockRows, m_numSignals;
+	FILE* m_file;
+	SBlock* m_fill;
+	long long m_pos, m_rows;
+	int m_blocks;
+	std::vector<SBlock*> m_queue, m_free;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_wake, m_done;
+	bool m_stop, m_error;
+	std::vector<std::string> m_assets, m_algos;
+	int m_lastAsset, m_lastAlgo;
+};
+
+///////////////////////////////////////////////////////
+// Read-only view of a signal file mapped into memory; the column pointers point into the file.
+class CSignalReader
+{
+public:
+	struct SBlockView
+	{
+		int rows;
+		const DATE* time;
+		const int *asset, *algo, *side;
+		const float* objective;
+		std::vector<const float*> signals;
+	};
+
+	CSignalReader() : m_file(INVALID_HANDLE_VALUE), m_map(0), m_data(0), m_size(0), m_numSignals(0), m_rows(0) {}
+	~CSignalReader() { close(); }
+
+	bool open(const char* filename) {
+		close();
+		m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (m_file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(CSignalWriter::SHeader) + sizeof(CSignalWriter::STrailer))) { close(); return false; }
+		m_size = size.QuadPart;
+		m_map = CreateFileMappingA(m_file, 0, PAGE_READONLY, 0, 0, 0);
+		m_data = m_map ? static_cast<const char*>(MapViewOfFile(m_map, FILE_MAP_READ, 0, 0, 0)) : 0;
+		if (!m_data || !parse()) { close(); return false; }
+		return true;
+	}
+
+	void close() {
+		if (m_data) UnmapViewOfFile(m_data);
+		if (m_map && m_map != m_file) CloseHandle(m_map);
+		if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+		m_map = 0;
+		m_data = 0;
+		m_blocks.clear();
+		m_assets.clear();
+		m_algos.clear();
+		m_rows = 0;
+	}
+
+	inline long long rows() const { return m_rows; }
+	inline int numSignals() const { return m_numSignals; }
+	inline int blocks() const { return static_cast<int>(m_blocks.size()); }
+	inline const SBlockView& block(int i) const { return m_blocks[i]; }
+	inline int assets() const { return static_cast<int>(m_assets.size()); }
+	inline int algos() const { return static_cast<int>(m_algos.size()); }
+	inline const char* assetName(int id) const { return id >= 0 && id < assets() ? m_assets[id] : ""; }
+	inline const char* algoName(int id) const { return id >= 0 && id < algos() ? m_algos[id] : ""; }
+
+	// record layout of a DATASET: time as DATE in fields 0 and 1 like in .t6 records, then asset id,
+	// algo id, side, the signals and the objective
+	inline int datasetFields() const { return 5 + m_numSignals + 1; }
+
+	// copies the rows into a DATASET record array of rows() x datasetFields() floats
+	void fillDataset(float* data) const {
+		const int fields = datasetFields();
+		for (size_t b = 0; b < m_blocks.size(); b++) {
+			const SBlockView& v = m_blocks[b];
+			for (int r = 0; r < v.rows; r++, data += fields) {
+				memcpy(data, &v.time[r], sizeof(DATE));
+				data[2] = static_cast<float>(v.asset[r]);
+				data[3] = static_cast<float>(v.algo[r]);
+				data[4] = static_cast<float>(v.side[r]);
+				for (int c = 0; c < m_numSignals; c++) data[5 + c] = v.signals[c][r];
+				data[5 + m_numSignals] = v.objective[r];
+			}
+		}
+	}
+
+	// fills the host dataset 'handle'; returns the number of records
+	int toDataset(int handle) const {
+		float* data = dataNew(handle, static_cast<int>(m_rows), datasetFields());
+		if (!data) return 0;
+		fillDataset(data);
+		return static_cast<int>(m_rows);
+	}
+
+private:
+	CSignalReader(const CSignalReader&);
+	CSignalReader& operator=(const CSignalReader&);
+
+	bool parse() {
+		CSignalWriter::SHeader h;
+		CSignalWriter::STrailer t;
+		memcpy(&h, m_data, sizeof(h));
+		memcpy(&t, m_data + m_size - sizeof(t), sizeof(t));
+		if (memcmp(h.magic, "ZSIG", 4) != 0 || h.version != 1 || memcmp(t.magic, "ZEND", 4) != 0) return false;
+		if (h.numSignals < 0 || t.blocks < 0 || t.namesOffset < static_cast<long long>(sizeof(h)) || t.namesOffset > m_size) return false;
+		m_numSignals = h.numSignals;
+		long long rows = 0;
+		std::vector<long long> off(4 + m_numSignals + 2);
+		long long pos = sizeof(h);
+		for (int i = 0; i < t.blocks; i++) {
+			if (pos + 8 > t.namesOffset || memcmp(m_data + pos, "ZBLK", 4) != 0) return false;
+			SBlockView v;
+			memcpy(&v.rows, m_data + pos + 4, 4);
+			CSignalWriter::columnOffsets(pos, v.rows, m_numSignals, &off[0]);
+			if (v.rows < 0 || off[4 + m_numSignals + 1] > t.namesOffset) return false;
+			v.time = reinterpret_cast<const DATE*>(m_data + off[0]);
+			v.asset = reinterpret_cast<const int*>(m_data + off[1]);
+			v.algo = reinterpret_cast<const int*>(m_data + off[2]);
+			v.side = reinterpret_cast<const int*>(m_data + off[3]);
+			for (int c = 0; c < m_numSignals; c++) v.signals.push_back(reinterpret_cast<const float*>(m_data + off[4 + c]));
+			v.objective = reinterpret_cast<const float*>(m_data + off[4 + m_numSignals]);
+			m_blocks.push_back(v);
+			rows += v.rows;
+			pos = off[4 + m_numSignals + 1];
+		}
+		// the DATASET is sized by the row count, so it must match the blocks
+		if (rows != t.rows || rows > 0x7FFFFFFF) return false;
+		m_rows = rows;
+		const char* p = m_data + t.namesOffset;
+		const char* end = m_data + m_size - sizeof(t);
+		return names(p, end, m_assets) && names(p, end, m_algos);
+	}
+
+	static bool names(const char*& p, const char* end, std::vector<const char*>& out) {
+		int count;
+		if (p + 4 > end) return false;
+		memcpy(&count, p, 4);
+		p += 4;
+		for (int i = 0; i < count; i++) {
+			const char* s = p;
+			while (p < end && *p) p++;
+			if (p == end) return false;
+			out.push_back(s);
+			p++;
+		}
+		return true;
+	}
+
+	HANDLE m_file, m_map;
+	const char* m_data;
+	long long m_size;
+	int m_numSignals;
+	long long m_rows;
+	std::vector<SBlockView> m_blocks;
+	std::vector<const char*> m_assets, m_algos;
+};
+} // namespace z
+
+#endif // ZORRO_SIGNAL_FILE_H_
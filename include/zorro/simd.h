@@ -0,0 +1,71 @@
+
+#ifndef ZORRO_SIMD_H_
+#define ZORRO_SIMD_H_
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+// Instruction sets available at compile time. Define ZORRO_NO_SIMD to force the scalar code paths.
+#ifndef ZORRO_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ZORRO_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define ZORRO_SIMD_AVX2
+#include <immintrin.h>
+#endif
+#endif // ZORRO_NO_SIMD
+
+namespace z
+{
+// STL allocator for SIMD aligned arrays, f.i. std::vector<var, CAlignedAllocator<var> >
+template <typename T, size_t Alignment = 32>
+class CAlignedAllocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+	template <typename U> struct rebind { typedef CAlignedAllocator<U, Alignment> other; };
+
+	CAlignedAllocator() {}
+	template <typename U> CAlignedAllocator(const CAlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t n) {
+		if (n == 0) return 0;
+#ifdef _MSC_VER
+		void* p = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+		void* p = 0;
+		if (posix_memalign(&p, Alignment, n * sizeof(T)) != 0) p = 0;
+#endif
+		if (!p) throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t) {
+#ifdef _MSC_VER
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+
+	template <typename U> bool operator==(const CAlignedAllocator<U, Alignment>&) const { return true; }
+	template <typename U> bool operator!=(const CAlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+typedef std::vector<var, CAlignedAllocator<var> > TAlignedVars;
+} // namespace z
+
+#endif // ZORRO_SIMD_H_
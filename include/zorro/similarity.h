@@ -0,0 +1,319 @@
+
+#ifndef ZORRO_SIMILARITY_H_
+#define ZORRO_SIMILARITY_H_
+
+#include <math.h>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <algorithm>
+#include "zorro/arena.h"
+#include "zorro/thread_pool.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// k nearest historical windows to a pattern, over the full price history of many assets.
+// Query and windows are z-normalized, so only the shape counts. The distance is DTW within a
+// Sakoe-Chiba band of 'band' bars (plain Euclidean for band 0) or the discrete Frechet distance
+// in the same band. Most windows are rejected by the cascade of the UCR suite: LB_Kim on the
+// end points, LB_Keogh against the query envelope with early abandoning, LB_Keogh of the window
+// envelope against the query, and finally the banded distance abandoned against the cumulative
+// bound. The windows are scanned in chunks on the thread pool; the chunks share the best k-th
+// distance found so far, which keeps the result exact. A plain exported run() has to call
+// zorroExitRun() at its end, so that the pool is stopped before the dll is unloaded.
+//
+//   static z::CSimilaritySearch Search;
+//   if (is(INITRUN)) for (each asset) Search.add(History, Bars, false);  // oldest first
+//   Search.append(Asset, priceClose());                                   // every bar
+//   z::SSimilarityMatch Best[10];
+//   int n = Search.search(Pattern, 24, 10, 2, Best);   // Best[i].start: window start in the series
+struct SSimilarityMatch
+{
+	int series;    // number of the series in the order of add()
+	int start;     // first bar of the window, 0 = oldest bar of the series
+	var distance;
+};
+
+class CSimilaritySearch
+{
+	struct SSeries
+	{
+		std::vector<var> x;
+		std::vector<var> upper, lower; // envelope of x for the current band
+		int envelopeValid;             // envelope is valid up to this bar
+	};
+
+public:
+	enum EMetric { DTW, FRECHET };
+	enum { ChunkWindows = 8192 };
+
+	explicit CSimilaritySearch(EMetric metric = DTW) : m_metric(metric), m_band(-1) {}
+
+	inline void setMetric(EMetric metric) { m_metric = metric; }
+	inline EMetric metric() const { return m_metric; }
+
+	// adds a price history; host series are newest first
+	int add(const var* data, int length, bool newestFirst = true) {
+		m_series.push_back(SSeries());
+		SSeries& s = m_series.back();
+		s.envelopeValid = 0;
+		s.x.reserve(length);
+		for (int i = 0; i < length; i++) s.x.push_back(newestFirst ? data[length-1-i] : data[i]);
+		return static_cast<int>(m_series.size()) - 1;
+	}
+
+	// adds the newest bar to a series
+	inline void append(int series, var value) {
+		if (series >= 0 && series < static_cast<int>(m_series.size())) m_series[series].x.push_back(value);
+	}
+
+	inline int series() const { return static_cast<int>(m_series.size()); }
+	inline int length(int series) const { return static_cast<int>(m_series[series].x.size()); }
+	inline const var* data(int series) const { return &m_series[series].x[0]; }
+
+	// finds the k nearest windows to the 'bars' values of 'pattern' (oldest first); returns the
+	// number of matches, sorted by distance
+	int search(const var* pattern, int bars, int k, int band, SSimilarityMatch* matches) {
+		const int m = bars;
+		if (m < 2 || k < 1) return 0;
+		if (band < 0) band = 0;
+		if (band >= m) band = m-1;
+		updateEnvelopes(band);
+
+		// normalized query, its envelope and the order of the largest values first
+		m_q.resize(m); m_qUpper.resize(m); m_qLower.resize(m); m_order.resize(m);
+		var mean = 0, dev = 0;
+		for (int i = 0; i < m; i++) mean += pattern[i];
+		mean /= m;
+		for (int i = 0; i < m; i++) dev += (pattern[i]-mean)*(pattern[i]-mean);
+		dev = dev > 0 ? sqrt(dev/m) : 1.;
+		for (int i = 0; i < m; i++) m_q[i] = (pattern[i]-mean)/dev;
+		envelope(&m_q[0], m, band, &m_qUpper[0], &m_qLower[0]);
+		for (int i = 0; i < m; i++) m_order[i] = i;
+		const std::vector<var>& q = m_q;
+		std::sort(m_order.begin(), m_order.end(), [&q](int a, int b) { return fabs(q[a]) > fabs(q[b]); });
+
+		// chunks of windows
+		m_tasks.clear();
+		for (int s = 0; s < series(); s++)
+			for (int w0 = 0; w0 + m <= length(s); w0 += ChunkWindows) {
+				STask t = { s, w0, std::min(w0 + ChunkWindows, length(s) - m + 1) };
+				m_tasks.push_back(t);
+			}
+		m_results.assign(m_tasks.size()*k, SSimilarityMatch());
+		m_counts.assign(m_tasks.size(), 0);
+		m_bound = 1e300;
+		threadPool().parallelForEach(0, static_cast<int>(m_tasks.size()), [this, m, k, band](int t) {
+			scan(t, m, k, band);
+		});
+
+		// merge the chunk results
+		int n = 0;
+		for (size_t t = 0; t < m_tasks.size(); t++)
+			for (int i = 0; i < m_counts[t]; i++) insert(matches, n, k, m_results[t*k + i]);
+		for (int i = 0; i < n; i++) matches[i].distance = sqrt(matches[i].distance);
+		return n;
+	}
+
+	// distance between the pattern and one window, without pruning; for checks and single windows
+	var distance(const var* pattern, int bars, int band, int series, int start) {
+		const int m = bars;
+		std::vector<var> q(m), c(m), prev(m+1), cur(m+1), cb(m+1, 0.);
+		normalize(pattern, m, &q[0]);
+		normalize(&m_series[series].x[start], m, &c[0]);
+		return sqrt(banded(&q[0], &c[0], m, band < 0 ? 0 : (band >= m ? m-1 : band), &cb[0], 1e300, &prev[0], &cur[0]));
+	}
+
+private:
+	struct STask
+	{
+		int series, begin, end;
+	};
+
+	static void normalize(const var* x, int m, var* out) {
+		var mean = 0, dev = 0;
+		for (int i = 0; i < m; i++) mean += x[i];
+		mean /= m;
+		for (int i = 0; i < m; i++) dev += (x[i]-mean)*(x[i]-mean);
+		dev = dev > 0 ? sqrt(dev/m) : 1.;
+		for (int i = 0; i < m; i++) out[i] = (x[i]-mean)/dev;
+	}
+
+	// running max/min over [i-band, i+band]
+	static void envelope(const var* x, int n, int band, var* upper, var* lower) {
+		std::deque<int> hi, lo;
+		int next = 0;
+		for (int i = 0; i < n; i++) {
+			for (; next < n && next <= i + band; next++) {
+				while (!hi.empty() && x[hi.back()] <= x[next]) hi.pop_back();
+				hi.push_back(next);
+				while (!lo.empty() && x[lo.back()] >= x[next]) lo.pop_back();
+				lo.push_back(next);
+			}
+			while (hi.front() < i - band) hi.pop_front();
+			while (lo.front() < i - band) lo.pop_front();
+			upper[i] = x[hi.front()];
+			lower[i] = x[lo.front()];
+		}
+	}
+
+	// envelopes of the series, recomputed for a new band and extended for appended bars
+	void updateEnvelopes(int band) {
+		const bool all = band != m_band;
+		m_band = band;
+		threadPool().parallelForEach(0, series(), [this, all, band](int i) {
+			SSeries& s = m_series[i];
+			const int n = static_cast<int>(s.x.size());
+			if (!all && s.envelopeValid == n) return;
+			// the last 'band' values of a valid envelope depend on the new bars
+			const int from = all ? 0 : std::max(0, s.envelopeValid - band - band);
+			s.upper.resize(n);
+			s.lower.resize(n);
+			if (n > from) envelope(&s.x[from], n - from, band, &s.upper[from], &s.lower[from]);
+			// the first 'band' recomputed values miss the bars before 'from'
+			for (int j = from; j < std::min(from + band, n) && from > 0; j++)
+				for (int l = std::max(0, j - band); l < from; l++) {
+					if (s.x[l] > s.upper[j]) s.upper[j] = s.x[l];
+					if (s.x[l] < s.lower[j]) s.lower[j] = s.x[l];
+				}
+			s.envelopeValid = n;
+		}, 1);
+	}
+
+	// keeps the k smallest in ascending order
+	static inline void insert(SSimilarityMatch* list, int& n, int k, const SSimilarityMatch& match) {
+		if (n == k && !less(match, list[k-1])) return;
+		int p = n < k ? n++ : k-1;
+		while (p > 0 && less(match, list[p-1])) { list[p] = list[p-1]; p--; }
+		list[p] = match;
+	}
+	static inline bool less(const SSimilarityMatch& a, const SSimilarityMatch& b) {
+		if (a.distance != b.distance) return a.distance < b.distance;
+		if (a.series != b.series) return a.series < b.series;
+		return a.start < b.start;
+	}
+
+	inline var combine(var a, var b) const { return m_metric == FRECHET ? (a > b ? a : b) : a + b; }
+
+	// squared banded DTW or Frechet distance, INF when it exceeds 'bsf'; cb[i] is a lower bound of the
+	// cost of the candidate points from i on
+	var banded(const var* q, const var* c, int m, int band, const var* cb, var bsf, var* prev, var* cur) const {
+		const var INF = 1e300;
+		const bool frechet = m_metric == FRECHET;
+		for (int j = 0; j <= m; j++) prev[j] = INF;
+		prev[0] = 0;
+		for (int i = 0; i < m; i++) {
+			const int lo = i - band > 0 ? i - band : 0;
+			const int hi = i + band < m-1 ? i + band : m-1;
+			cur[lo] = INF;
+			var rowMin = INF;
+			for (int j = lo; j <= hi; j++) {
+				const var d = (q[i]-c[j])*(q[i]-c[j]);
+				var best = prev[j];
+				if (prev[j+1] < best) best = prev[j+1];
+				if (cur[j] < best) best = cur[j];
+				const var v = frechet ? (d > best ? d : best) : d + best;
+				cur[j+1] = v;
+				if (v < rowMin) rowMin = v;
+			}
+			if (hi + 2 <= m) cur[hi+2] = INF;
+			const int rest = i + band + 1;
+			if (combine(rowMin, rest < m ? cb[rest] : 0.) >= bsf) return INF;
+			var* t = prev; prev = cur; cur = t;
+		}
+		return prev[m];
+	}
+
+	void scan(int task, int m, int k, int band) {
+		const STask& t = m_tasks[task];
+		const SSeries& s = m_series[t.series];
+		const bool frechet = m_metric == FRECHET;
+		const var* q = &m_q[0];
+		CArenaScope scope(threadArena());
+		CArena& arena = threadArena();
+		var* c = arena.allocArray<var>(m);
+		var* contrib = arena.allocArray<var>(m);
+		var* cb = arena.allocArray<var>(m+1);
+		var* prev = arena.allocArray<var>(m+1);
+		var* cur = arena.allocArray<var>(m+1);
+		SSimilarityMatch* best = &m_results[static_cast<size_t>(task)*k];
+		int& count = m_counts[task];
+
+		// running window sums, centered on the first value of the chunk against cancellation
+		const var ref = s.x[t.begin];
+		var ex = 0, ex2 = 0;
+		for (int j = 0; j < m-1; j++) { const var v = s.x[t.begin+j] - ref; ex += v; ex2 += v*v; }
+
+		for (int w = t.begin; w < t.end; w++) {
+			if (w > t.begin) { const var v = s.x[w-1] - ref; ex -= v; ex2 -= v*v; }
+			{ const var v = s.x[w+m-1] - ref; ex += v; ex2 += v*v; }
+			var bsf = m_bound.load(std::memory_order_relaxed);
+			if (count == k && best[k-1].distance < bsf) bsf = best[k-1].distance;
+			const var mean = ref + ex/m;
+			var dev = ex2/m - (ex/m)*(ex/m);
+			dev = dev > 1e-20 ? sqrt(dev) : 1.;
+			const var* x = &s.x[w];
+
+			// LB_Kim on the first and last points
+			const var first = (x[0]-mean)/dev - q[0], last = (x[m-1]-mean)/dev - q[m-1];
+			if (combine(first*first, last*last) >= bsf) continue;
+
+			// LB_Keogh of the window against the query envelope, largest query values first
+			var lb = 0;
+			int i = 0;
+			for (; i < m; i++) {
+				const int j = m_order[i];
+				const var cj = (x[j]-mean)/dev;
+				c[j] = cj;
+				var d = 0;
+				if (cj > m_qUpper[j]) d = (cj-m_qUpper[j])*(cj-m_qUpper[j]);
+				else if (cj < m_qLower[j]) d = (cj-m_qLower[j])*(cj-m_qLower[j]);
+				contrib[j] = d;
+				lb = combine(lb, d);
+				if (lb >= bsf) break;
+			}
+			if (i < m) continue;
+
+			// LB_Keogh of the query against the window envelope
+			var lb2 = 0;
+			for (i = 0; i < m; i++) {
+				const int j = m_order[i];
+				const var u = (s.upper[w+j]-mean)/dev, l = (s.lower[w+j]-mean)/dev;
+				var d = 0;
+				if (q[j] > u) d = (q[j]-u)*(q[j]-u);
+				else if (q[j] < l) d = (q[j]-l)*(q[j]-l);
+				lb2 = combine(lb2, d);
+				if (lb2 >= bsf) break;
+			}
+			if (i < m) continue;
+
+			// suffix bounds of the candidate points for abandoning the full distance
+			cb[m] = 0;
+			for (int j = m-1; j >= 0; j--) cb[j] = frechet ? (contrib[j] > cb[j+1] ? contrib[j] : cb[j+1]) : contrib[j] + cb[j+1];
+			const var d = banded(q, c, m, band, cb, bsf, prev, cur);
+			if (d >= bsf) continue;
+
+			SSimilarityMatch match = { t.series, w, d };
+			insert(best, count, k, match);
+			if (count == k) {
+				// share the k-th distance with the other chunks
+				var bound = m_bound.load(std::memory_order_relaxed);
+				while (best[k-1].distance < bound && !m_bound.compare_exchange_weak(bound, best[k-1].distance)) {}
+			}
+		}
+	}
+
+	EMetric m_metric;
+	int m_band;
+	std::vector<SSeries> m_series;
+	std::vector<var> m_q, m_qUpper, m_qLower;
+	std::vector<int> m_order;
+	std::vector<STask> m_tasks;
+	std::vector<SSimilarityMatch> m_results;
+	std::vector<int> m_counts;
+	std::atomic<var> m_bound;
+};
+} // namespace z
+
+#endif // ZORRO_SIMILARITY_H_
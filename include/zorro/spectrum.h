@@ -0,0 +1,223 @@
+
+#ifndef ZORRO_SPECTRUM_H_
+#define ZORRO_SPECTRUM_H_
+
+#include <math.h>
+#include <vector>
+#include "zorro/simd.h"
+#include "zorro/order_statistic.h"
+#include "zorro/thread_pool.h"
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Sliding DFT over a set of cycle periods, the streaming version of
+// Spectrum(Data,TimePeriod,SamplePeriod), DominantPeriod and DominantPhase.
+// Every bin k holds X = sum(x[j]*exp(-i*w*j), j = 0..SamplePeriod-1) over the window, newest
+// first, and is moved by one bar with X = x + exp(-i*w)*(X - x[N]*exp(-i*w*(N-1))), which is
+// exact for any period, so update() costs O(bins) however long the window is. The bins are
+// recomputed from the window every 'resync' windows to stop rounding drift.
+// Amplitudes are taken from the mean-free window, so the price level does not leak into the bins.
+class CSpectrum
+{
+public:
+	// one bin per period in 'periods'
+	CSpectrum(const var* periods, int bins, int samplePeriod, int resync = 256) : m_window(samplePeriod > 1 ? samplePeriod : 2) {
+		init(periods, bins, resync);
+	}
+	// one bin per integer period from minPeriod to maxPeriod
+	CSpectrum(int minPeriod, int maxPeriod, int samplePeriod, int resync = 256) : m_window(samplePeriod > 1 ? samplePeriod : 2) {
+		std::vector<var> periods;
+		for (int p = minPeriod; p <= maxPeriod; p++) periods.push_back(p);
+		init(periods.empty() ? 0 : &periods[0], static_cast<int>(periods.size()), resync);
+	}
+
+	void update(var x) {
+		const int n = m_bins;
+		if (!m_init) {
+			m_window.fill(x);
+			m_sum = x*m_window.capacity();
+			for (int k = 0; k < n; k++) { m_re[k] = x*m_wre[k]; m_im[k] = x*m_wim[k]; }
+			m_init = true;
+			m_count = 0;
+		}
+		var old;
+		m_window.push(x, old);
+		m_sum += x - old;
+		if (++m_count >= m_resync) {
+			resync();
+			return;
+		}
+		const var* c1 = &m_c1[0]; const var* s1 = &m_s1[0];
+		const var* cn = &m_cn[0]; const var* sn = &m_sn[0];
+		var* re = &m_re[0]; var* im = &m_im[0];
+		for (int k = 0; k < n; k++) {
+			var yr = re[k] - old*cn[k];
+			var yi = im[k] + old*sn[k];
+			re[k] = c1[k]*yr + s1[k]*yi + x;
+			im[k] = c1[k]*yi - s1[k]*yr;
+		}
+	}
+
+	inline int bins() const { return m_bins; }
+	inline int samplePeriod() const { return m_window.capacity(); }
+	inline var period(int bin) const { return m_period[bin]; }
+
+	// amplitude of the cycle in the window, about its peak to peak half height
+	inline var amplitude(int bin) const { return 2.*sqrt(power(bin))/samplePeriod(); }
+	inline var power(int bin) const {
+		var re, im;
+		centered(bin, re, im);
+		return re*re + im*im;
+	}
+	// phase of the newest bar in the cycle, 0..2*PI
+	inline var phase(int bin) const {
+		var re, im;
+		centered(bin, re, im);
+		var p = -atan2(im, re);
+		return p < 0 ? p + 2*PI : p;
+	}
+	// amplitude at the bin closest to 'period'
+	var spectrum(var period) const {
+		int best = 0;
+		for (int k = 1; k < m_bins; k++)
+			if (fabs(m_period[k]-period) < fabs(m_period[best]-period)) best = k;
+		return m_bins ? amplitude(best) : 0.;
+	}
+
+	// bin with the highest power
+	int peak() const {
+		int best = 0;
+		var pmax = -1;
+		for (int k = 0; k < m_bins; k++) {
+			var p = power(k);
+			if (p > pmax) { pmax = p; best = k; }
+		}
+		return best;
+	}
+	// period of the strongest cycle, interpolated between the bins around the peak
+	var dominantPeriod() const {
+		if (m_bins == 0) return 0.;
+		int k = peak();
+		if (k == 0 || k == m_bins-1) return m_period[k];
+		var a = power(k-1), b = power(k), c = power(k+1);
+		var d = a - 2*b + c;
+		var delta = d < 0 ? 0.5*(a-c)/d : 0.;
+		if (delta > 0.5) delta = 0.5;
+		else if (delta < -0.5) delta = -0.5;
+		return m_period[k] + delta*(delta > 0 ? m_period[k+1]-m_period[k] : m_period[k]-m_period[k-1]);
+	}
+	inline var dominantPhase() const { return m_bins ? phase(peak()) : 0.; }
+
+private:
+	void init(const var* periods, int bins, int resync) {
+		const int n = m_window.capacity();
+		m_bins = bins;
+		m_resync = (resync > 0 ? resync : 1)*n;
+		m_init = false;
+		m_count = 0;
+		m_sum = 0;
+		m_period.assign(periods, periods + bins);
+		TAlignedVars* arrays[] = { &m_c1, &m_s1, &m_cn, &m_sn, &m_re, &m_im, &m_wre, &m_wim };
+		for (int i = 0; i < 8; i++) arrays[i]->assign(bins, 0.);
+		for (int k = 0; k < bins; k++) {
+			var w = 2*PI/periods[k];
+			m_c1[k] = cos(w); m_s1[k] = sin(w);
+			m_cn[k] = cos(w*(n-1)); m_sn[k] = sin(w*(n-1));
+			for (int j = 0; j < n; j++) { m_wre[k] += cos(w*j); m_wim[k] -= sin(w*j); }
+		}
+	}
+
+	// bins and mean recomputed from the window
+	void resync() {
+		const int n = m_window.capacity();
+		m_count = 0;
+		m_sum = 0;
+		for (int j = 0; j < n; j++) m_sum += m_window[j];
+		for (int k = 0; k < m_bins; k++) {
+			var w = 2*PI/m_period[k], re = 0, im = 0;
+			for (int j = 0; j < n; j++) { re += m_window[j]*cos(w*j); im -= m_window[j]*sin(w*j); }
+			m_re[k] = re; m_im[k] = im;
+		}
+	}
+
+	// bin of the mean-free window: X - mean*sum(exp(-i*w*j))
+	inline void centered(int bin, var& re, var& im) const {
+		var mean = m_sum/samplePeriod();
+		re = m_re[bin] - mean*m_wre[bin];
+		im = m_im[bin] - mean*m_wim[bin];
+	}
+
+	CSlidingWindow m_window;
+	int m_bins, m_resync, m_count;
+	bool m_init;
+	var m_sum;
+	std::vector<var> m_period;
+	TAlignedVars m_c1, m_s1, m_cn, m_sn, m_re, m_im, m_wre, m_wim;
+};
+
+///////////////////////////////////////////////////////
+// Batch mode for research over whole histories
+
+// spectrum amplitudes of every bar of a history, oldest bar first; out[bar*bins + bin].
+// The bins are spread over the thread pool; each bin runs its own sliding DFT, so the result
+// does not depend on the number of threads. End a plain exported run() with zorroExitRun().
+inline void spectrumHistory(const var* data, int length, const var* periods, int bins, int samplePeriod, var* out)
+{
+	threadPool().parallelFor(0, bins, [=](int b0, int b1) {
+		CSpectrum spectrum(periods + b0, b1 - b0, samplePeriod);
+		for (int t = 0; t < length; t++) {
+			spectrum.update(data[t]);
+			for (int k = 0; k < b1 - b0; k++) out[t*bins + b0 + k] = spectrum.amplitude(k);
+		}
+	}, 4);
+}
+
+// in-place radix-2 complex FFT; n must be a power of 2
+inline void fft(var* re, var* im, int n, bool inverse = false)
+{
+	for (int i = 1, j = 0; i < n; i++) {
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1) j ^= bit;
+		j ^= bit;
+		if (i < j) {
+			var t = re[i]; re[i] = re[j]; re[j] = t;
+			t = im[i]; im[i] = im[j]; im[j] = t;
+		}
+	}
+	for (int len = 2; len <= n; len <<= 1) {
+		var w = (inverse ? 2 : -2)*PI/len;
+		for (int j = 0; j < len/2; j++) {
+			var cr = cos(w*j), ci = sin(w*j);
+			for (int i = j; i < n; i += len) {
+				int k = i + len/2;
+				var tr = re[k]*cr - im[k]*ci;
+				var ti = re[k]*ci + im[k]*cr;
+				re[k] = re[i] - tr; im[k] = im[i] - ti;
+				re[i] += tr; im[i] += ti;
+			}
+		}
+	}
+	if (inverse)
+		for (int i = 0; i < n; i++) { re[i] /= n; im[i] /= n; }
+}
+
+// power spectrum of a whole mean-free history, zero padded to a power of 2.
+// power[k] belongs to the cycle period nfft/k, k = 1..nfft/2; returns nfft.
+inline int periodogram(const var* data, int length, std::vector<var>& power)
+{
+	int nfft = 1;
+	while (nfft < length) nfft <<= 1;
+	TAlignedVars re(nfft, 0.), im(nfft, 0.);
+	var mean = 0;
+	for (int i = 0; i < length; i++) mean += data[i];
+	mean /= length > 0 ? length : 1;
+	for (int i = 0; i < length; i++) re[i] = data[i] - mean;
+	fft(&re[0], &im[0], nfft);
+	power.assign(nfft/2 + 1, 0.);
+	for (int k = 0; k <= nfft/2; k++) power[k] = (re[k]*re[k] + im[k]*im[k])/(length > 0 ? length : 1);
+	return nfft;
+}
+} // namespace z
+
+#endif // ZORRO_SPECTRUM_H_
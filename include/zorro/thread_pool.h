@@ -0,0 +1,170 @@
+
+#ifndef ZORRO_THREAD_POOL_H_
+#define ZORRO_THREAD_POOL_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+
+namespace z
+{
+// Small work-sharing pool for data parallel loops inside one strategy process.
+// Threads are started lazily on the first parallel call, so nothing is created while the host loads the dll.
+// The calling thread always takes part in its own loop, which makes nested parallelFor calls safe.
+// Workers must be stopped before the dll is unloaded, otherwise they are left parked in unmapped
+// code and every reload adds more of them: call zorroExitRun() from zorro_impl.h at the end of
+// every exported run(). The CZorroEvents run() and ZORRO_RUN() do it; the default DllMain
+// asserts on unload that no worker is left.
+class CThreadPool
+{
+	struct SJob
+	{
+		std::function<void(int, int)> func;
+		int end, grain;
+		std::atomic<int> next;
+		std::atomic<int> pending; // number of items not yet processed
+	};
+	typedef std::shared_ptr<SJob> TJobPtr;
+
+	CThreadPool(const CThreadPool&);
+	CThreadPool& operator=(const CThreadPool&);
+
+public:
+	explicit CThreadPool(int numThreads = -1) : m_numThreads(numThreads), m_stop(false) {}
+	~CThreadPool() { stop(); }
+
+	// number of worker threads, not counting the calling thread
+	int size() const {
+		if (m_numThreads >= 0) return m_numThreads;
+		int n = static_cast<int>(std::thread::hardware_concurrency());
+		return n > 1 ? n-1 : 0;
+	}
+
+	// true while workers are started
+	bool running() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return !m_workers.empty();
+	}
+
+	// changes the number of workers; running workers are stopped and restarted on demand
+	void resize(int numThreads) {
+		stop();
+		m_numThreads = numThreads;
+	}
+
+	// joins all workers; they are started again by the next parallel call
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (size_t i = 0; i < m_workers.size(); i++)
+			m_workers[i].join();
+		m_workers.clear();
+		m_stop = false;
+	}
+
+	// calls functor(i0,i1) for consecutive ranges of at most 'grain' items covering [begin,end)
+	template <typename Functor>
+	void parallelFor(int begin, int end, Functor functor, int grain = 1) {
+		if (grain < 1) grain = 1;
+		if (end - begin <= grain || size() == 0) {
+			for (int i = begin; i < end; i += grain)
+				functor(i, (std::min)(i + grain, end));
+			return;
+		}
+		start();
+		TJobPtr job = std::make_shared<SJob>();
+		job->func = functor;
+		job->end = end;
+		job->grain = grain;
+		job->next = begin;
+		job->pending = end - begin;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(job);
+		}
+		m_wake.notify_all();
+		while (runChunk(*job)) {}
+		std::unique_lock<std::mutex> lock(m_mutex);
+		remove(job);
+		m_done.wait(lock, [&job]() { return job->pending == 0; });
+	}
+
+	// calls functor(i) for every i in [begin,end)
+	template <typename Functor>
+	void parallelForEach(int begin, int end, Functor functor, int grain = 1) {
+		parallelFor(begin, end, [&functor](int i0, int i1) {
+			for (int i = i0; i < i1; i++)
+				functor(i);
+		}, grain);
+	}
+
+private:
+	void start() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_workers.empty()) return;
+		int n = size();
+		for (int i = 0; i < n; i++)
+			m_workers.push_back(std::thread(&CThreadPool::work, this));
+	}
+
+	bool runChunk(SJob& job) {
+		int i0 = job.next.fetch_add(job.grain);
+		if (i0 >= job.end) return false;
+		int i1 = (std::min)(i0 + job.grain, job.end);
+		job.func(i0, i1);
+		if (job.pending.fetch_sub(i1 - i0) == i1 - i0) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_done.notify_all();
+		}
+		return true;
+	}
+
+	void remove(const TJobPtr& job) {
+		typename std::deque<TJobPtr>::iterator it = std::find(m_jobs.begin(), m_jobs.end(), job);
+		if (it != m_jobs.end()) m_jobs.erase(it);
+	}
+
+	void work() {
+		for (;;) {
+			TJobPtr job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+				if (m_stop) return;
+				job = m_jobs.front();
+			}
+			if (!runChunk(*job)) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				remove(job);
+			}
+		}
+	}
+
+	int m_numThreads;
+	bool m_stop;
+	std::vector<std::thread> m_workers;
+	std::deque<TJobPtr> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+};
+
+// shared pool used by the z:: helpers; never destroyed, since joining threads from a static
+// destructor would run under the loader lock at DLL_PROCESS_DETACH and can deadlock FreeLibrary
+inline CThreadPool& threadPool()
+{
+	static CThreadPool* pool = new CThreadPool;
+	return *pool;
+}
+} // namespace z
+
+#endif // ZORRO_THREAD_POOL_H_
@@ -0,0 +1,240 @@
+
+#ifndef ZORRO_TRADES_H_
+#define ZORRO_TRADES_H_
+
+#include "zorro/thread_pool.h"
+#include <string.h>
+#include <vector>
+#include <memory>
+
+namespace z
+{
+///////////////////////////////////////////////////////
+// Native trade ranges. Needs C++11 and is not included by zorro.h; include "zorro/trades.h".
+// The TRADE structs are collected with one forTrade() walk into a snapshot that is reused until
+// the bar, cycle, time or trade counts change. Entering a trade changes the open, pending or
+// phantom count, closing one also the win or loss count, so only a phantom trade entered and
+// closed within the same call goes unnoticed; call tradeIndex().invalidate() after that.
+// A snapshot that a range still iterates over is never refilled, nested trades() calls after
+// a change get their own one.
+// Don't call trades() from inside a host for(trades) loop, that would break the outer loop.
+class CTradeIndex
+{
+	CTradeIndex(const CTradeIndex&);
+	CTradeIndex& operator=(const CTradeIndex&);
+
+	struct SKey
+	{
+		int bar, cycle, trades, pending, phantom, closed;
+		DATE time;
+
+		inline bool operator==(const SKey& k) const {
+			return bar == k.bar && cycle == k.cycle && trades == k.trades && pending == k.pending
+				&& phantom == k.phantom && closed == k.closed && time == k.time;
+		}
+	};
+
+public:
+	typedef std::shared_ptr<const std::vector<TRADE*> > TSnapshot;
+
+	CTradeIndex() { invalidate(); }
+
+	inline void invalidate() { m_key.bar = -1; }
+
+	TSnapshot collect() {
+		const SKey key = state();
+		if (m_trades && m_key == key) return m_trades;
+		if (!m_trades || m_trades.use_count() > 1)
+			m_trades = std::make_shared<std::vector<TRADE*> >();
+		std::vector<TRADE*>& trades = *m_trades;
+		trades.clear();
+		TRADE* current = g->tr;
+		for (forTrade(2); g->bFor; forTrade(3)) // all_trades
+			trades.push_back(g->tr);
+		g->tr = current;
+		m_key = key;
+		return m_trades;
+	}
+
+private:
+	static inline SKey state() {
+		SKey k = { g->nBar, g->nTotalCycle, g->numTrades, g->numPending, g->numPhantom, g->w.numWin + g->w.numLoss, g->tNow };
+		return k;
+	}
+
+	std::shared_ptr<std::vector<TRADE*> > m_trades;
+	SKey m_key;
+};
+
+inline CTradeIndex& tradeIndex()
+{
+	static CTradeIndex index;
+	return index;
+}
+
+///////////////////////////////////////////////////////
+// Trade filter, evaluated natively on the snapshot
+struct STradeFilter
+{
+	typedef ZORRO_ENUM_UNDERLYING_TYPE(ETradeFlag) TFlags;
+
+	TFlags all;       // all of these flags must be set
+	TFlags any;       // at least one of these flags must be set, unless 0
+	TFlags none;      // none of these flags may be set
+	bool   component; // only trades of the current asset/algo component
+	string asset;     // asset name, or 0 for all
+	string algo;      // algo name, or 0 for all
+
+	STradeFilter() : all(0), any(0), none(0), component(false), asset(0), algo(0) {}
+
+	inline bool operator()(const TRADE* tr) const {
+		TFlags flags = static_cast<TFlags>(tr->flags);
+		if ((flags & all) != all) return false;
+		if (any && !(flags & any)) return false;
+		if (flags & none) return false;
+		const STATUS* status = tr->status;
+		if (component && status != g->statLong && status != g->statShort) return false;
+		if (asset && strncmp(status->asset->sName, asset, NAMESIZE) != 0) return false;
+		if (algo && strncmp(status->sAlgo, algo, NAMESIZE) != 0) return false;
+		return true;
+	}
+};
+
+///////////////////////////////////////////////////////
+// Filtered trade range, f.i. for (TRADE* tr : z::trades().open().longs().asset("EUR/USD"))
+// Dereferencing an iterator also sets ThisTrade, so the Trade... variables work inside the loop;
+// after a range-for loop ThisTrade stays at the last trade, forEach() and find() restore it.
+// Leaving the loop early with break or return is safe, unlike in a host for(trades) loop.
+class CTradeRange
+{
+public:
+	typedef STradeFilter::TFlags TFlags;
+	typedef CTradeIndex::TSnapshot TSnapshot;
+	typedef std::vector<TRADE*>::const_iterator TBaseIterator;
+
+	class CIterator
+	{
+	public:
+		CIterator(TBaseIterator it, TBaseIterator end, const STradeFilter* filter) : m_it(it), m_end(end), m_filter(filter) { skip(); }
+
+		inline TRADE* operator*() const { g->tr = *m_it; return *m_it; }
+		inline CIterator& operator++() { ++m_it; skip(); return *this; }
+		inline bool operator==(const CIterator& other) const { return m_it == other.m_it; }
+		inline bool operator!=(const CIterator& other) const { return m_it != other.m_it; }
+
+	private:
+		inline void skip() { while (m_it != m_end && !(*m_filter)(*m_it)) ++m_it; }
+
+		TBaseIterator m_it, m_end;
+		const STradeFilter* m_filter;
+	};
+
+	explicit CTradeRange(const TSnapshot& trades) : m_trades(trades) {}
+
+	// flag filters
+	inline CTradeRange with(ETradeFlag flags) const    { CTradeRange r(*this); r.m_filter.all |= static_cast<TFlags>(flags); return r; }
+	inline CTradeRange withAny(ETradeFlag flags) const { CTradeRange r(*this); r.m_filter.any |= static_cast<TFlags>(flags); return r; }
+	inline CTradeRange without(ETradeFlag flags) const { CTradeRange r(*this); r.m_filter.none |= static_cast<TFlags>(flags); return r; }
+
+	inline CTradeRange open() const    { return with(ETradeFlag::OPEN); }
+	inline CTradeRange pending() const { return with(ETradeFlag::WAITBUY).without(ETradeFlag::OPEN); }
+	inline CTradeRange active() const  { return withAny(ETradeFlag::OPEN|ETradeFlag::WAITBUY); }  // open or pending
+	inline CTradeRange closed() const  { return without(ETradeFlag::OPEN|ETradeFlag::WAITBUY); }
+	inline CTradeRange longs() const   { return without(ETradeFlag::BID); }
+	inline CTradeRange shorts() const  { return with(ETradeFlag::BID); }
+	inline CTradeRange phantom() const { return with(ETradeFlag::PHANTOM); }
+	inline CTradeRange real() const    { return without(ETradeFlag::PHANTOM); }
+
+	// component filters; the names must stay valid while the range is used
+	inline CTradeRange current() const           { CTradeRange r(*this); r.m_filter.component = true; return r; }
+	inline CTradeRange asset(string name) const  { CTradeRange r(*this); r.m_filter.asset = name; return r; }
+	inline CTradeRange algo(string name) const   { CTradeRange r(*this); r.m_filter.algo = name; return r; }
+
+	inline CIterator begin() const { return CIterator(m_trades->begin(), m_trades->end(), &m_filter); }
+	inline CIterator end() const   { return CIterator(m_trades->end(), m_trades->end(), &m_filter); }
+
+	inline bool matches(const TRADE* tr) const { return m_filter(tr); }
+
+	// calls functor() for each trade with ThisTrade set, like the forTrade loops
+	template <typename Functor>
+	void forEach(Functor functor) const {
+		TRADE* current = g->tr;
+		for (CIterator it = begin(); it != end(); ++it) {
+			(void)*it;
+			functor();
+		}
+		g->tr = current;
+	}
+
+	// first trade for which predicate(TRADE*) is true, or 0; stops at the first match
+	template <typename Predicate>
+	TRADE* find(Predicate predicate) const {
+		TRADE* current = g->tr;
+		TRADE* found = 0;
+		for (CIterator it = begin(); it != end() && !found; ++it)
+			if (predicate(*it)) found = *it;
+		g->tr = current;
+		return found;
+	}
+
+	// doesn't touch ThisTrade
+	inline TRADE* first() const {
+		for (TBaseIterator it = m_trades->begin(); it != m_trades->end(); ++it)
+			if (m_filter(*it)) return *it;
+		return 0;
+	}
+
+	inline int count() const {
+		int n = 0;
+		for (TBaseIterator it = m_trades->begin(); it != m_trades->end(); ++it)
+			if (m_filter(*it)) n++;
+		return n;
+	}
+
+	// folds op(accumulator,TRADE*) over the range; doesn't touch ThisTrade
+	template <typename T, typename Operation>
+	T reduce(T init, Operation op) const {
+		for (TBaseIterator it = m_trades->begin(); it != m_trades->end(); ++it)
+			if (m_filter(*it)) init = op(init, *it);
+		return init;
+	}
+
+	// sum of a TRADE member, f.i. sum(&TRADE::fResult)
+	template <typename Member>
+	var sum(Member TRADE::* member) const {
+		return reduce(0.0, [member](var s, const TRADE* tr) { return s + static_cast<var>(tr->*member); });
+	}
+
+	// same as sum(), but split over the thread pool for large trade lists; a plain exported
+	// run() that uses it must end with zorroExitRun()
+	template <typename Member>
+	var parallelSum(Member TRADE::* member, int grain = 4096) const {
+		const int n = static_cast<int>(m_trades->size());
+		if (n <= grain) return sum(member);
+		std::vector<var> partial((n + grain - 1) / grain, 0.0);
+		const std::vector<TRADE*>& trades = *m_trades;
+		const STradeFilter& filter = m_filter;
+		threadPool().parallelFor(0, n, [&](int i0, int i1) {
+			var s = 0;
+			for (int i = i0; i < i1; i++)
+				if (filter(trades[i])) s += static_cast<var>(trades[i]->*member);
+			partial[i0 / grain] = s;
+		}, grain);
+		var s = 0;
+		for (size_t i = 0; i < partial.size(); i++) s += partial[i]; // fixed order for reproducible results
+		return s;
+	}
+
+private:
+	TSnapshot m_trades;
+	STradeFilter m_filter;
+};
+
+// all trades of the session at the time of the call; chain filters to narrow the range
+inline CTradeRange trades()
+{
+	return CTradeRange(tradeIndex().collect());
+}
+} // namespace z
+
+#endif // ZORRO_TRADES_H_
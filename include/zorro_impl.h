@@ -9,6 +9,9 @@
 #define ZORRO_IMPL
 #include "zorro.h"
 #include <assert.h>
+#if ZORRO_CPP >= 11
+#include "zorro/thread_pool.h"
+#endif
 
 ////////////////////////////////////////////////////////
 // Default DllMain
@@ -23,10 +26,138 @@ BOOL WINAPI DllMain(
 	(void)hinstDLL;
 	(void)fdwReason;
 	(void)lpvReserved;
+#if ZORRO_CPP >= 11
+	// FreeLibrary with pool workers still parked in the dll; call zorroExitRun() in run()
+	assert(fdwReason != DLL_PROCESS_DETACH || lpvReserved != 0 || !z::threadPool().running());
+#endif
+
+	return TRUE;
+}
+#endif
+
+////////////////////////////////////////////////////////
+// Allocation hooks for the hot path check, see zorro/hot_path.h
+
+#ifdef ZORRO_HOT_PATH_CHECK
+#include <new>
+#include <stdlib.h>
+#if defined(_MSC_VER) && defined(_DEBUG)
+#include <crtdbg.h>
+#endif
+
+void* operator new(size_t size)
+{
+	z::hotPathMonitor().note(size);
+	z::CHotPathMonitor::muted()++; // don't count the malloc below twice
+	void* p = malloc(size ? size : 1);
+	z::CHotPathMonitor::muted()--;
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	z::hotPathMonitor().note(size);
+	z::CHotPathMonitor::muted()++;
+	void* p = malloc(size ? size : 1);
+	z::CHotPathMonitor::muted()--;
+	return p;
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+#ifdef __cpp_aligned_new
+// over-aligned types, f.i. SIMD members, go through the aligned forms since C++17
+static void* zorroAlignedAlloc(size_t size, std::align_val_t align)
+{
+	z::hotPathMonitor().note(size);
+	z::CHotPathMonitor::muted()++;
+	const size_t alignment = static_cast<size_t>(align);
+#ifdef _MSC_VER
+	void* p = _aligned_malloc(size ? size : 1, alignment);
+#else
+	void* p = aligned_alloc(alignment, (size + alignment - 1)/alignment*alignment + (size ? 0 : alignment));
+#endif
+	z::CHotPathMonitor::muted()--;
+	return p;
+}
+
+static void zorroAlignedFree(void* p)
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t align)
+{
+	void* p = zorroAlignedAlloc(size, align);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size, std::align_val_t align)
+{
+	return operator new(size, align);
+}
+
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+	return zorroAlignedAlloc(size, align);
+}
+
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+	return zorroAlignedAlloc(size, align);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept { zorroAlignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { zorroAlignedFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { zorroAlignedFree(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { zorroAlignedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { zorroAlignedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { zorroAlignedFree(p); }
+#endif // __cpp_aligned_new
 
+#if defined(_MSC_VER) && defined(_DEBUG)
+static int __cdecl zorroAllocHook(int type, void*, size_t size, int blockType, long, const unsigned char*, int)
+{
+	if (type != _HOOK_FREE && blockType != _CRT_BLOCK) z::hotPathMonitor().note(size);
 	return TRUE;
 }
 #endif
+#endif // ZORRO_HOT_PATH_CHECK
+
+////////////////////////////////////////////////////////
+// Stops the z::threadPool() workers in the EXITRUN, so that none of them is left
+// running when the host unloads the dll. Exported run() functions that don't use ZORRO_RUN()
+// call it themselves at their end.
+
+inline void zorroExitRun()
+{
+#if ZORRO_CPP >= 11
+#ifdef ZORRO_CPP_PURE
+	if (is(EStatusFlag::EXITRUN)) z::threadPool().stop();
+#else
+	if (is(EXITRUN)) z::threadPool().stop();
+#endif
+#endif
+}
 
 ////////////////////////////////////////////////////////
 
@@ -38,6 +169,10 @@ ZORRO_EXPORT int ZORRO_CALL zorro(GLOBALS* pGlobals)
 	g = pGlobals;
 	unsigned int n = 0;
 
+#if defined(ZORRO_HOT_PATH_CHECK) && defined(_MSC_VER) && defined(_DEBUG)
+	_CrtSetAllocHook(zorroAllocHook);
+#endif
+
 // Populate the list of function pointers
 #define F(x)  assert(g->Functions[n] != 0); (DWORD&) ZORRO_NAMESPACE x    = g->Functions[n++];
 #define F0(x) assert(g->Functions[n] != 0); (DWORD&) ZORRO_NAMESPACE x##0 = g->Functions[n++];
@@ -71,16 +206,22 @@ ZORRO_EXPORT void ZORRO_CALL main()
 
 ZORRO_EXPORT void ZORRO_CALL run()
 {
-	ZORRO_NAMESPACE g_zevents.run();
+	{
+		ZORRO_HOT_PATH_SCOPE("run");
+		ZORRO_NAMESPACE g_zevents.run();
+	}
+	zorroExitRun();
 }
 
 ZORRO_EXPORT void ZORRO_CALL tick()
 {
+	ZORRO_HOT_PATH_SCOPE("tick");
 	ZORRO_NAMESPACE g_zevents.tick();
 }
 
 ZORRO_EXPORT void ZORRO_CALL tock()
 {
+	ZORRO_HOT_PATH_SCOPE("tock");
 	ZORRO_NAMESPACE g_zevents.tock();
 }
 
@@ -116,6 +257,30 @@ ZORRO_EXPORT EBarAction ZORRO_CALL bar(cvars open, cvars high, cvars low, cvars
 
 #endif // ZORRO_USE_EVENT_CLASS
 
+#ifndef ZORRO_USE_EVENT_CLASS
+////////////////////////////////////////////////////////
+// Exported run() for strategies without the event class. The body that follows the macro
+// runs inside the hot path scope, and the thread pool is stopped in the EXITRUN:
+//
+//   ZORRO_RUN()
+//   {
+//     vars Price = series(price());
+//     ...
+//   }
+
+#define ZORRO_RUN() \
+	static void zorroRun(); \
+	ZORRO_EXPORT void ZORRO_CALL run() \
+	{ \
+		{ \
+			ZORRO_HOT_PATH_SCOPE("run"); \
+			zorroRun(); \
+		} \
+		zorroExitRun(); \
+	} \
+	static void zorroRun()
+#endif // ZORRO_USE_EVENT_CLASS
+
 #undef ZORRO_IMPL
 
 #endif // ZORRO_IMPL_H_
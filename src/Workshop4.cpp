@@ -3,7 +3,7 @@
 #define ZORRO_DLLMAIN
 #include "zorro_impl.h"
 
-ZORRO_EXPORT void ZORRO_CALL run()
+ZORRO_RUN()
 {
 	vars Price = series(price());
 	vars Trend = series(LowPass(Price,500));
@@ -3,7 +3,7 @@
 #define ZORRO_DLLMAIN
 #include "zorro_impl.h"
 
-ZORRO_EXPORT void ZORRO_CALL run()
+ZORRO_RUN()
 {
 	set(EZorroFlag::PARAMETERS);  // generate and use optimized parameters
 	BarPeriod = PERIOD_H4; // 4 hour bars
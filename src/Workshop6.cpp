@@ -40,7 +40,7 @@ void tradeTrend()
 	}
 }
 
-ZORRO_EXPORT void ZORRO_CALL run()
+ZORRO_RUN()
 {
 	set(EZorroFlag(EZorroFlag::PARAMETERS|EZorroFlag::FACTORS)); // generate and use optimized parameters and factors
 	NumCores = -2;         // use multiple cores (Zorro S only)
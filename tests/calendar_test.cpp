@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////
+// Calendar decomposition against known dates and daylight saving transitions
+///////////////////////////////////////////////////////
+
+#include "test.h"
+#include "zorro/calendar.h"
+
+namespace
+{
+const var Minute = 1./(24*60);
+
+bool isDate(const z::SCivilTime& c, int year, int month, int day, int hour, int minute)
+{
+	return c.year == year && c.month == month && c.day == day && c.hour == hour && c.minute == minute;
+}
+
+// local time a minute before and at a transition given in UTC
+void checkTransition(ETimeZone zone, DATE utc, int dstAfter, int hourBefore, int hourAfter)
+{
+	const z::SCivilTime before = z::localTime(utc - Minute, zone), after = z::localTime(utc, zone);
+	const int standard = static_cast<int>(zone)*60;
+	CHECK(before.dst == 1 - dstAfter && after.dst == dstAfter);
+	CHECK(before.offset == standard + 60*before.dst && after.offset == standard + 60*after.dst);
+	CHECK(before.hour == hourBefore && before.minute == 59);
+	CHECK(after.hour == hourAfter && after.minute == 0);
+}
+} // namespace
+
+ZORRO_TEST(calendarMatchesKnownDates)
+{
+	CHECK(z::civilDate(1970, 1, 1) == 25569.);
+	CHECK(z::civilDate(2000, 1, 1) == 36526.);
+	const z::SCivilTime epoch = z::civilTime(25569.);
+	CHECK(isDate(epoch, 1970, 1, 1, 0, 0) && epoch.dow == 4 && epoch.doy == 1 && epoch.week == 1);
+	const z::SCivilTime y2k = z::civilTime(z::civilDate(2000, 1, 1, 12, 30));
+	CHECK(isDate(y2k, 2000, 1, 1, 12, 30) && y2k.dow == 6 && y2k.tod == 1230 && y2k.tow == 61230);
+	CHECK(y2k.week == 52 && y2k.dst == 0 && y2k.offset == 0);
+	const z::SCivilTime leap = z::civilTime(z::civilDate(2024, 2, 29, 23, 59, 59));
+	CHECK(isDate(leap, 2024, 2, 29, 23, 59) && leap.second == 59 && leap.dow == 4 && leap.doy == 60);
+	CHECK(z::civilTime(z::civilDate(2024, 12, 31)).doy == 366);
+	CHECK(z::civilTime(z::civilDate(2100, 3, 1)).doy == 60);
+	// every day of a range maps back to its date
+	int mismatches = 0;
+	for (long d = 25569; d < 25569 + 50*366; d++) {
+		const z::SCivilTime c = z::civilTime(d + 0.5);
+		if (z::civilDate(c.year, c.month, c.day) != d || c.hour != 12) mismatches++;
+		if (c.dow != (d - 25569 + 3) % 7 + 1) mismatches++;
+	}
+	CHECK(mismatches == 0);
+}
+
+ZORRO_TEST(calendarIsoWeeks)
+{
+	struct { int year, month, day, week; } dates[] = {
+		{ 2015, 12, 31, 53 }, { 2016, 1, 3, 53 }, { 2016, 1, 4, 1 },
+		{ 2019, 12, 29, 52 }, { 2019, 12, 30, 1 }, { 2020, 1, 1, 1 },
+		{ 2020, 12, 31, 53 }, { 2021, 1, 1, 53 }, { 2021, 1, 3, 53 }, { 2021, 1, 4, 1 },
+		{ 2008, 12, 29, 1 }, { 2010, 1, 3, 53 }, { 2024, 12, 30, 1 }, { 2026, 12, 31, 53 },
+		{ 2027, 1, 1, 53 }, { 2027, 1, 4, 1 }, { 2023, 1, 1, 52 }, { 2023, 1, 2, 1 },
+	};
+	for (int i = 0; i < static_cast<int>(sizeof(dates)/sizeof(dates[0])); i++)
+		CHECK(z::civilTime(z::civilDate(dates[i].year, dates[i].month, dates[i].day, 8)).week == dates[i].week);
+}
+
+ZORRO_TEST(calendarDaylightSavingTransitions)
+{
+	// EU: last Sunday of March and October at 01:00 UTC
+	checkTransition(ETimeZone::WET, z::civilDate(2021, 3, 28, 1), 1, 0, 2);
+	checkTransition(ETimeZone::WET, z::civilDate(2021, 10, 31, 1), 0, 1, 1);
+	checkTransition(ETimeZone::CET, z::civilDate(2024, 3, 31, 1), 1, 1, 3);
+	checkTransition(ETimeZone::CET, z::civilDate(2024, 10, 27, 1), 0, 2, 2);
+	// US since 2007: second Sunday of March and first of November at 02:00 local
+	checkTransition(ETimeZone::ET, z::civilDate(2021, 3, 14, 7), 1, 1, 3);
+	checkTransition(ETimeZone::ET, z::civilDate(2021, 11, 7, 6), 0, 1, 1);
+	checkTransition(ETimeZone::ET, z::civilDate(2024, 3, 10, 7), 1, 1, 3);
+	checkTransition(ETimeZone::ET, z::civilDate(2024, 11, 3, 6), 0, 1, 1);
+	// US before 2007: first Sunday of April and last of October
+	checkTransition(ETimeZone::ET, z::civilDate(2006, 4, 2, 7), 1, 1, 3);
+	checkTransition(ETimeZone::ET, z::civilDate(2006, 10, 29, 6), 0, 1, 1);
+	// Sydney: first Sunday of April and October at 02:00 standard time, 16:00 UTC the day before
+	checkTransition(ETimeZone::AEST, z::civilDate(2021, 4, 3, 16), 0, 2, 2);
+	checkTransition(ETimeZone::AEST, z::civilDate(2021, 10, 2, 16), 1, 1, 3);
+	// summer in the north is winter in Sydney
+	CHECK(z::localTime(z::civilDate(2021, 7, 1, 12), ETimeZone::AEST).dst == 0);
+	CHECK(z::localTime(z::civilDate(2022, 1, 1, 12), ETimeZone::AEST).dst == 1);
+	const z::SCivilTime ny = z::localTime(z::civilDate(2021, 7, 1, 13, 30), ETimeZone::ET);
+	CHECK(isDate(ny, 2021, 7, 1, 9, 30) && ny.offset == -240 && ny.tow == 40930);
+	// no daylight saving in Tokyo, and the local date changes with the offset
+	const z::SCivilTime tokyo = z::localTime(z::civilDate(2021, 7, 1, 20), ETimeZone::JST);
+	CHECK(isDate(tokyo, 2021, 7, 2, 5, 0) && tokyo.dst == 0 && tokyo.offset == 540 && tokyo.dow == 5);
+	const z::SCivilTime utc = z::localTime(z::civilDate(2021, 7, 1, 20), ETimeZone::UTC);
+	CHECK(isDate(utc, 2021, 7, 1, 20, 0) && utc.dst == 0 && utc.offset == 0);
+}
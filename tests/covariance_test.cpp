@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////
+// Streaming covariance matrix against the two-pass formula on the window
+///////////////////////////////////////////////////////
+
+#include "test.h"
+#include "zorro/covariance.h"
+#include <vector>
+
+namespace
+{
+// correlated returns with different means and volatilities
+var sample(int t, int i)
+{
+	return 0.01*sin(t*0.3 + i) + 0.002*((t*31 + i*7) % 11) + 0.001*i + 0.003*sin(t*0.05)*(i % 3);
+}
+
+// mean first, then the products of the deviations, over the bars from..to-1
+var twoPass(const std::vector<std::vector<var> >& r, int from, int to, int i, int j)
+{
+	var mi = 0, mj = 0;
+	for (int t = from; t < to; t++) { mi += r[t][i]; mj += r[t][j]; }
+	mi /= to - from;
+	mj /= to - from;
+	var c = 0;
+	for (int t = from; t < to; t++) c += (r[t][i] - mi)*(r[t][j] - mj);
+	return c/(to - from - 1);
+}
+
+void checkRolling(int n)
+{
+	const int period = 20, bars = 400;
+	std::vector<std::vector<var> > r(bars, std::vector<var>(n));
+	for (int t = 0; t < bars; t++)
+		for (int i = 0; i < n; i++) r[t][i] = sample(t, i);
+	// a small resync interval so that both the update and the resync paths are checked
+	z::CCovarianceMatrix C(n, period, z::CCovarianceMatrix::ROLLING, 3);
+	std::vector<var> M(n*n), means(n);
+	var error = 0, meanError = 0;
+	for (int t = 0; t < bars; t++) {
+		C.update(&r[t][0]);
+		const int from = t + 1 > period ? t + 1 - period : 0;
+		CHECK(C.count() == t + 1 - from);
+		if (t < 1 || (t > 2*period && t % 17 != 0)) continue;
+		C.exportTo(&M[0], &means[0]);
+		for (int i = 0; i < n; i++) {
+			var m = 0;
+			for (int k = from; k <= t; k++) m += r[k][i];
+			meanError = (std::max)(meanError, fabs(means[i] - m/(t + 1 - from)));
+			for (int j = 0; j < n; j++) {
+				error = (std::max)(error, fabs(M[i*n + j] - twoPass(r, from, t + 1, i, j)));
+				CHECK(M[i*n + j] == M[j*n + i]);
+			}
+		}
+	}
+	CHECK_NEAR(error, 0., 1e-14);
+	CHECK_NEAR(meanError, 0., 1e-15);
+}
+} // namespace
+
+ZORRO_TEST(rollingCovarianceMatchesTwoPass)
+{
+	checkRolling(5);
+	// above the threshold for the thread pool
+	checkRolling(130);
+}
+
+ZORRO_TEST(exponentialCovarianceMatchesRecurrence)
+{
+	const int n = 7, period = 20, bars = 500;
+	const var a = 2./(period + 1);
+	z::CCovarianceMatrix C(n, period, z::CCovarianceMatrix::EXPONENTIAL);
+	std::vector<var> mean(n), cov(n*n, 0.), d(n), r(n);
+	var error = 0;
+	for (int t = 0; t < bars; t++) {
+		for (int i = 0; i < n; i++) r[i] = sample(t, i);
+		C.update(&r[0]);
+		if (t == 0) {
+			mean = r;
+			continue;
+		}
+		for (int i = 0; i < n; i++) {
+			d[i] = r[i] - mean[i];
+			mean[i] += a*d[i];
+		}
+		for (int i = 0; i < n; i++)
+			for (int j = 0; j < n; j++) cov[i*n + j] = (1. - a)*(cov[i*n + j] + a*d[i]*d[j]);
+		for (int i = 0; i < n; i++)
+			for (int j = 0; j < n; j++) error = (std::max)(error, fabs(C.covariance(i, j) - cov[i*n + j]));
+	}
+	CHECK_NEAR(error, 0., 1e-16);
+	for (int i = 0; i < n; i++) CHECK_NEAR(C.mean(i), mean[i], 1e-16);
+	CHECK_NEAR(C.correlation(2, 2), 1., 1e-15);
+	CHECK_NEAR(C.beta(3, 3), 1., 1e-15);
+}
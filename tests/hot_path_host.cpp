@@ -0,0 +1,206 @@
+///////////////////////////////////////////////////////
+// Stand-in host for the hot path check, see zorro/hot_path.h
+// Link it with a strategy source built with ZORRO_HOT_PATH_CHECK, f.i. src/Workshop4.cpp.
+// Every host function is replaced by a stub that returns 0; the price functions return a random
+// walk, series() returns ring buffers, loop() walks its arguments and optimize() returns its
+// default, so the strategy takes its usual branches. run() is called once per bar like in a
+// simulation. The exit code is the number of allocation sites found inside the checked scopes.
+// Only strategies in the C++ mode can be driven, not ZORRO_FORCE_LITEC ones.
+//
+// vs2017/HotPathHost.vcxproj builds it, with the strategy selected by the Strategy property:
+//
+//   msbuild vs2017\HotPathHost.vcxproj /p:Strategy=Workshop6
+//   HotPathHost.exe 5000                                 // number of bars, default 2000
+///////////////////////////////////////////////////////
+
+#include "zorro.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef ZORRO_HOT_PATH_CHECK
+#error "build the host and the strategy with ZORRO_HOT_PATH_CHECK"
+#endif
+
+ZORRO_EXPORT void ZORRO_CALL run();
+
+namespace
+{
+enum { MaxSeries = 64, MaxLength = 4096, MaxLoops = 8, DefaultLength = 80 };
+
+GLOBALS s_globals;
+ASSET s_asset;
+STATUS s_statLong, s_statShort;
+char s_algo[NAMESIZE];
+int s_bars, s_status;
+var s_price = 1.;
+unsigned s_seed = 1;
+
+// series in call order, newest first like the host's
+var s_series[MaxSeries][MaxLength];
+int s_numSeries;
+
+struct SLoop
+{
+	const void* key;
+	int next;
+};
+SLoop s_loops[MaxLoops];
+
+var random1()
+{
+	s_seed = s_seed*1103515245u + 12345u;
+	return static_cast<var>((s_seed >> 8) & 0xFFFF)/0x10000 - 0.5;
+}
+
+// returns the default value of its return type for any signature
+template <typename T> struct SStub;
+template <typename R, typename... A>
+struct SStub<R (ZORRO_CALL*)(A...)>
+{
+	static R ZORRO_CALL call(A...) { return R(); }
+};
+template <typename R, typename... A>
+struct SStub<R (ZORRO_CALL*)(A..., ...)>
+{
+	static R ZORRO_CALL call(A..., ...) { return R(); }
+};
+
+// loop() gets its arguments as a fixed list of pointers, the first one identifies the loop
+template <typename T> struct SLoopStub;
+template <typename... A>
+struct SLoopStub<string (ZORRO_CALL*)(A..., ...)>
+{
+	static string ZORRO_CALL call(A... args, ...) {
+		const void* p[] = { args... };
+		const int n = static_cast<int>(sizeof...(A));
+		int i = 0;
+		while (i < MaxLoops - 1 && s_loops[i].key && s_loops[i].key != p[0]) i++;
+		SLoop& l = s_loops[i];
+		l.key = p[0];
+		if (l.next < n && p[l.next]) return static_cast<string>(const_cast<void*>(p[l.next++]));
+		l.next = 0;
+		return 0;
+	}
+};
+
+int ZORRO_CALL hostPrint(EPrintMode, string format, ...)
+{
+#ifdef _MSC_VER
+	// the z::print() wrapper passes its own va_list as the only variable argument
+	va_list args;
+	va_start(args, format);
+	const int n = vprintf(format, va_arg(args, va_list));
+	va_end(args);
+	return n;
+#else
+	return printf("%s", format);
+#endif
+}
+
+int ZORRO_CALL hostIs(EStatusFlag flag)
+{
+	return (s_status & static_cast<int>(flag)) != 0;
+}
+
+var ZORRO_CALL hostPrice(int offset, ...)
+{
+	return s_price*(1. + 0.001*offset);
+}
+
+vars ZORRO_CALL hostSeries(var value, int length, ...)
+{
+	if (length <= 0) length = DefaultLength;
+	if (length > MaxLength) length = MaxLength;
+	if (s_numSeries >= MaxSeries) {
+		fprintf(stderr, "more than %d series\n", MaxSeries);
+		exit(-1);
+	}
+	var* s = s_series[s_numSeries++];
+	memmove(s + 1, s, (length - 1)*sizeof(var));
+	s[0] = value;
+	return s;
+}
+
+var ZORRO_CALL hostOptimize(var value, var, var, var, var)
+{
+	return value;
+}
+
+int ZORRO_CALL hostAsset(string name)
+{
+	if (!name) return 0;
+	strncpy(s_asset.sName, name, NAMESIZE - 1);
+	return 1;
+}
+
+int ZORRO_CALL hostAlgo(string name)
+{
+	if (!name) return 0;
+	strncpy(s_algo, name, NAMESIZE - 1);
+	return 1;
+}
+
+void installStubs()
+{
+#define F(x)  ZORRO_NAMESPACE x    = &SStub<ZORRO_NAMESPACE x##_t>::call;
+#define F0(x) ZORRO_NAMESPACE x##0 = &SStub<ZORRO_NAMESPACE x##0_t>::call;
+#define F1(x) ZORRO_NAMESPACE x##1 = &SStub<ZORRO_NAMESPACE x##1_t>::call;
+#define F2(x) ZORRO_NAMESPACE x##2 = &SStub<ZORRO_NAMESPACE x##2_t>::call;
+#define F3(x) ZORRO_NAMESPACE x##3 = &SStub<ZORRO_NAMESPACE x##3_t>::call;
+#define C
+#define R(x)
+#define A(x)
+#define D(x)
+#define I(param,value)
+#define VA
+#include "zorro/litec/functions_list.h"
+
+	ZORRO_NAMESPACE print = hostPrint;
+	ZORRO_NAMESPACE is0 = hostIs;
+	ZORRO_NAMESPACE price = hostPrice;
+	ZORRO_NAMESPACE priceOpen = hostPrice;
+	ZORRO_NAMESPACE priceClose = hostPrice;
+	ZORRO_NAMESPACE priceHigh = hostPrice;
+	ZORRO_NAMESPACE priceLow = hostPrice;
+	ZORRO_NAMESPACE series0 = hostSeries;
+	ZORRO_NAMESPACE optimize = hostOptimize;
+	ZORRO_NAMESPACE asset = hostAsset;
+	ZORRO_NAMESPACE algo = hostAlgo;
+	ZORRO_NAMESPACE loop0 = &SLoopStub<ZORRO_NAMESPACE loop0_t>::call;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	s_bars = argc > 1 ? atoi(argv[1]) : 2000;
+	if (s_bars < 2) s_bars = 2;
+	strcpy(s_asset.sName, "EUR/USD");
+	s_globals.asset = &s_asset;
+	s_globals.statLong = &s_statLong;
+	s_globals.statShort = &s_statShort;
+	s_globals.sAlgo = s_algo;
+	g = &s_globals;
+	installStubs();
+
+	for (int bar = 0; bar < s_bars; bar++) {
+		s_status = 0;
+		if (bar == 0) s_status |= static_cast<int>(EStatusFlag::INITRUN) | static_cast<int>(EStatusFlag::FIRSTINITRUN);
+		if (bar == s_bars - 1) s_status |= static_cast<int>(EStatusFlag::EXITRUN);
+		s_status |= static_cast<int>(EStatusFlag::RUNNING) | static_cast<int>(EStatusFlag::TESTMODE);
+		g->nBar = bar;
+		g->tNow = 40179. + bar/24.; // 2010-01-01, hourly
+		s_price *= 1. + 0.002*random1();
+		s_numSeries = 0;
+		run();
+	}
+
+	const z::CHotPathMonitor& monitor = z::hotPathMonitor();
+	printf("\n%d bars, %ld heap allocations at %d sites\n", s_bars, monitor.total(), monitor.sites());
+	for (int i = 0; i < monitor.sites(); i++) {
+		const z::SHotPathSite& site = monitor.site(i);
+		printf("%s at bar %d: %d allocations, %u bytes\n", site.scope, site.bar, site.count, static_cast<unsigned>(site.bytes));
+		for (int k = 0; k < site.numFrames; k++) printf("  %p\n", site.frames[k]);
+	}
+	return monitor.sites();
+}
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////
+// Streaming FisherN and its pipeline against a rescan of the window
+///////////////////////////////////////////////////////
+
+#include "test.h"
+#include "zorro/pipeline.h"
+#include <vector>
+
+namespace
+{
+// cycles on a slow trend, with a flat stretch that empties the range
+var sample(int t)
+{
+	if (t >= 400 && t < 460) return 100.;
+	return 100. + 0.002*t + 1.5*sin(t*0.21) + 0.4*sin(t*0.057 + 1.);
+}
+
+// FisherN as the host computes it, with the range rescanned on the series
+struct SFisherN
+{
+	std::vector<var> data;
+	int period;
+	var value;
+
+	explicit SFisherN(int p) : period(p), value(0) {}
+	var update(var x) {
+		data.push_back(x);
+		var lo = x, hi = x;
+		for (int i = 0; i < period; i++) {
+			const int k = static_cast<int>(data.size()) - 1 - i;
+			const var y = data[k >= 0 ? k : 0];
+			lo = (std::min)(lo, y);
+			hi = (std::max)(hi, y);
+		}
+		if (hi > lo) value = 0.33*2*((x-lo)/(hi-lo) - 0.5) + 0.67*value;
+		const var v = (std::max)(-0.998, (std::min)(0.998, value));
+		return 0.5*log((1.+v)/(1.-v));
+	}
+};
+} // namespace
+
+ZORRO_TEST(fisherNMatchesRescan)
+{
+	const int periods[] = { 1, 2, 20, 50 };
+	for (int p = 0; p < 4; p++) {
+		z::CFisherN F(periods[p]);
+		SFisherN R(periods[p]);
+		var error = 0;
+		for (int t = 0; t < 1500; t++) {
+			const var y = F.update(sample(t));
+			error = (std::max)(error, fabs(y - R.update(sample(t))));
+			CHECK(y == F.value());
+		}
+		CHECK_NEAR(error, 0., 1e-12);
+	}
+}
+
+ZORRO_TEST(fisherNPipelineMatchesStages)
+{
+	// the Workshop5 chain FisherN(BandPass(Price,30,0.5),500)
+	auto Signal = z::pipeline(z::input() | z::CBandPass(30, 0.5) | z::CFisherN(500));
+	z::CBandPass B(30, 0.5);
+	SFisherN R(500);
+	var error = 0, tapError = 0;
+	for (int t = 0; t < 3000; t++) {
+		const var x = sample(t);
+		const var filtered = B.update(x);
+		error = (std::max)(error, fabs(Signal.update(x) - R.update(filtered)));
+		tapError = (std::max)(tapError, fabs(Signal.tap<1>() - filtered));
+	}
+	CHECK_NEAR(error, 0., 1e-12);
+	CHECK(tapError == 0.);
+}
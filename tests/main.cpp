@@ -0,0 +1,31 @@
+///////////////////////////////////////////////////////
+// Test runner for the native z:: components
+// Runs all registered tests, or those whose name contains the first argument.
+// The exit code is the number of failed checks.
+///////////////////////////////////////////////////////
+
+#include "test.h"
+#include <string.h>
+
+static GLOBALS s_globals;
+
+int main(int argc, char* argv[])
+{
+	g = &s_globals;
+	const char* filter = argc > 1 ? argv[1] : 0;
+	int count = 0, failed = 0;
+	for (z::test::STest* t = z::test::first(); t; t = t->next) {
+		if (filter && !strstr(t->name, filter)) continue;
+		printf("%s", t->name);
+		const int before = z::test::failures();
+		t->function();
+		count++;
+		if (z::test::failures() != before) {
+			failed++;
+			printf("\n%s FAILED\n", t->name);
+		} else
+			printf(" ok\n");
+	}
+	printf("%d tests, %d failed\n", count, failed);
+	return z::test::failures();
+}
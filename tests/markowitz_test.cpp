@@ -0,0 +1,158 @@
+///////////////////////////////////////////////////////
+// CMarkowitz against a projected gradient solver and a grid search
+///////////////////////////////////////////////////////
+
+#include "test.h"
+#include "zorro/markowitz.h"
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+enum { N = 4 };
+
+// 4 assets with volatilities 10..25% and fixed correlations
+struct SData
+{
+	var cov[N*N], means[N], caps[N];
+
+	SData() {
+		const var vol[N] = { 0.10, 0.15, 0.20, 0.25 };
+		const var corr[N*N] = {
+			1.0, 0.3, 0.2, 0.1,
+			0.3, 1.0, 0.4, 0.2,
+			0.2, 0.4, 1.0, 0.5,
+			0.1, 0.2, 0.5, 1.0 };
+		const var ret[N] = { 0.04, 0.06, 0.09, 0.10 };
+		for (int i = 0; i < N; i++) {
+			for (int j = 0; j < N; j++) cov[i*N + j] = corr[i*N + j]*vol[i]*vol[j];
+			means[i] = ret[i];
+			caps[i] = 0.6;
+		}
+	}
+};
+
+var variance(const SData& d, const var* w)
+{
+	var v = 0;
+	for (int i = 0; i < N; i++)
+		for (int j = 0; j < N; j++) v += w[i]*d.cov[i*N + j]*w[j];
+	return v;
+}
+
+var mean(const SData& d, const var* w)
+{
+	var r = 0;
+	for (int i = 0; i < N; i++) r += w[i]*d.means[i];
+	return r;
+}
+
+// projection onto sum(w) = 1, 0 <= w <= cap by bisection on the shift
+void project(var* w, const var* caps)
+{
+	var lo = -10, hi = 10;
+	for (int it = 0; it < 200; it++) {
+		const var t = 0.5*(lo + hi);
+		var s = 0;
+		for (int i = 0; i < N; i++) s += (std::min)(caps[i], (std::max)(0., w[i] - t));
+		if (s > 1.) lo = t; else hi = t;
+	}
+	const var t = 0.5*(lo + hi);
+	for (int i = 0; i < N; i++) w[i] = (std::min)(caps[i], (std::max)(0., w[i] - t));
+}
+
+// minimizes 0.5*w'Cw - lambda*m'w by projected gradient steps
+void projectedGradient(const SData& d, var lambda, var* w)
+{
+	for (int i = 0; i < N; i++) w[i] = 1./N;
+	project(w, d.caps);
+	for (int it = 0; it < 20000; it++) {
+		var grad[N];
+		for (int i = 0; i < N; i++) {
+			grad[i] = -lambda*d.means[i];
+			for (int j = 0; j < N; j++) grad[i] += d.cov[i*N + j]*w[j];
+		}
+		for (int i = 0; i < N; i++) w[i] -= 2.*grad[i];
+		project(w, d.caps);
+	}
+}
+} // namespace
+
+ZORRO_TEST(markowitzFrontierIsValid)
+{
+	SData d;
+	z::CMarkowitz M;
+	M.frontier(d.cov, d.means, N, d.caps);
+	CHECK(M.points() >= 2);
+	for (int k = 0; k < M.points(); k++) {
+		const z::CMarkowitz::SPoint& p = M.point(k);
+		var sum = 0;
+		for (int i = 0; i < N; i++) {
+			CHECK(p.weights[i] >= -1e-12 && p.weights[i] <= d.caps[i] + 1e-12);
+			sum += p.weights[i];
+		}
+		CHECK_NEAR(sum, 1., 1e-12);
+		CHECK_NEAR(p.variance, variance(d, &p.weights[0]), 1e-12);
+		CHECK_NEAR(p.ret, mean(d, &p.weights[0]), 1e-12);
+		if (k > 0) {
+			CHECK(p.ret <= M.point(k-1).ret + 1e-12);
+			CHECK(p.variance <= M.point(k-1).variance + 1e-12);
+		}
+	}
+	// maximum return: the two best assets up to their caps
+	const z::CMarkowitz::SPoint& top = M.point(0);
+	CHECK_NEAR(top.weights[3], 0.6, 1e-12);
+	CHECK_NEAR(top.weights[2], 0.4, 1e-12);
+}
+
+ZORRO_TEST(markowitzMatchesProjectedGradient)
+{
+	SData d;
+	z::CMarkowitz M;
+	M.frontier(d.cov, d.means, N, d.caps);
+	// minimum variance end of the frontier
+	var w[N];
+	projectedGradient(d, 0., w);
+	const z::CMarkowitz::SPoint& low = M.point(M.points() - 1);
+	for (int i = 0; i < N; i++) CHECK_NEAR(low.weights[i], w[i], 1e-7);
+	CHECK_NEAR(low.variance, variance(d, w), 1e-10);
+
+	// single lambda solutions, warm started from each other
+	const var lambdas[] = { 0.05, 0.2, 0.5 };
+	z::CMarkowitz W;
+	for (int k = 0; k < 3; k++) {
+		var wo[N];
+		const var v = W.optimize(wo, d.cov, d.means, N, d.caps, lambdas[k]);
+		projectedGradient(d, lambdas[k], w);
+		for (int i = 0; i < N; i++) CHECK_NEAR(wo[i], w[i], 1e-7);
+		CHECK_NEAR(v, variance(d, w), 1e-10);
+	}
+}
+
+ZORRO_TEST(markowitzBestRatioMatchesGrid)
+{
+	SData d;
+	z::CMarkowitz M;
+	const var v = M.frontier(d.cov, d.means, N, d.caps);
+	var best[N];
+	CHECK_NEAR(M.best(best), v, 1e-15);
+	CHECK_NEAR(variance(d, best), v, 1e-12);
+	const var ratio = mean(d, best)/sqrt(v);
+
+	// all portfolios on a 0.5% grid within the caps
+	const int steps = 200;
+	var gridRatio = 0, grid[N] = { 0 };
+	for (int a = 0; a <= steps; a++)
+		for (int b = 0; a + b <= steps; b++)
+			for (int c = 0; a + b + c <= steps; c++) {
+				const var w[N] = { a/(var)steps, b/(var)steps, c/(var)steps, (steps - a - b - c)/(var)steps };
+				bool ok = true;
+				for (int i = 0; i < N; i++) ok = ok && w[i] <= d.caps[i] + 1e-12;
+				if (!ok) continue;
+				const var r = mean(d, w)/sqrt(variance(d, w));
+				if (r > gridRatio) { gridRatio = r; for (int i = 0; i < N; i++) grid[i] = w[i]; }
+			}
+	CHECK(ratio >= gridRatio - 1e-12);
+	CHECK_NEAR(ratio, gridRatio, 1e-4);
+	for (int i = 0; i < N; i++) CHECK_NEAR(best[i], grid[i], 0.01);
+}
@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////
+// Order statistic treap, sliding ranks and Spearman against sorted copies
+///////////////////////////////////////////////////////
+
+#include "test.h"
+#include "zorro/order_statistic.h"
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+// history preset with the first value like a series, offset 0 is the newest
+struct SHistory
+{
+	std::vector<var> data;
+
+	inline var operator[](int offset) const {
+		const int k = static_cast<int>(data.size()) - 1 - offset;
+		return k >= 0 ? data[k] : data[0];
+	}
+	std::vector<var> sorted(int period) const {
+		std::vector<var> v;
+		for (int i = 0; i < period; i++) v.push_back((*this)[i]);
+		std::sort(v.begin(), v.end());
+		return v;
+	}
+};
+
+var sample(int t)
+{
+	return floor(100. + 3.*sin(t*0.05) + 0.3*((t*7919) % 13));
+}
+
+var percentile(const std::vector<var>& v, var percent)
+{
+	const int n = static_cast<int>(v.size());
+	const var pos = percent/100.*(n-1);
+	if (pos <= 0) return v[0];
+	if (pos >= n-1) return v[n-1];
+	const int k = static_cast<int>(pos);
+	return v[k] + (pos-k)*(v[k+1] - v[k]);
+}
+
+// ranks 1..n by value, equal values by age, against the ages 1..n (oldest 1)
+var spearman(const SHistory& h, int period)
+{
+	std::vector<std::pair<var, int> > v;
+	for (int i = 0; i < period; i++) v.push_back(std::make_pair(h[i], period - i));
+	std::sort(v.begin(), v.end());
+	var d2 = 0;
+	for (int k = 0; k < period; k++) {
+		const var d = (k+1) - v[k].second;
+		d2 += d*d;
+	}
+	return 1. - 6.*d2/(static_cast<var>(period)*(static_cast<var>(period)*period - 1));
+}
+} // namespace
+
+ZORRO_TEST(orderStatisticMatchesSortedArray)
+{
+	z::COrderStatistic T;
+	std::vector<var> ref;
+	unsigned seed = 1;
+	for (int i = 0; i < 5000; i++) {
+		seed = seed*1103515245u + 12345u;
+		const var x = static_cast<var>((seed >> 16) % 200);
+		// insert twice as often as erase, erase only existing values
+		if ((seed >> 8) % 3 != 0 || ref.empty()) {
+			T.insert(x);
+			ref.insert(std::upper_bound(ref.begin(), ref.end(), x), x);
+		} else {
+			const var y = ref[(seed >> 4) % ref.size()];
+			CHECK(T.erase(y));
+			ref.erase(std::lower_bound(ref.begin(), ref.end(), y));
+		}
+		CHECK(!T.erase(-1.));
+		CHECK(T.size() == static_cast<int>(ref.size()));
+		if (i % 50 != 0) continue;
+		for (int k = 0; k < static_cast<int>(ref.size()); k++) CHECK(T.select(k) == ref[k]);
+		const int less = static_cast<int>(std::lower_bound(ref.begin(), ref.end(), x) - ref.begin());
+		const int lessEqual = static_cast<int>(std::upper_bound(ref.begin(), ref.end(), x) - ref.begin());
+		CHECK(T.countLess(x) == less);
+		CHECK(T.countLess(x, true) == lessEqual);
+		CHECK(T.countGreater(x) == static_cast<int>(ref.size()) - lessEqual);
+		CHECK(T.countGreater(x, true) == static_cast<int>(ref.size()) - less);
+	}
+}
+
+ZORRO_TEST(slidingRankMatchesSort)
+{
+	const int periods[] = { 2, 3, 10, 11, 300 };
+	for (int p = 0; p < 5; p++) {
+		const int period = periods[p];
+		z::CSlidingRank R(period);
+		SHistory h;
+		int mismatches = 0;
+		for (int t = 0; t < 2000; t++) {
+			const var x = sample(t);
+			h.data.push_back(x);
+			R.update(x);
+			const std::vector<var> v = h.sorted(period);
+			const var median = period & 1 ? v[period/2] : 0.5*(v[period/2-1] + v[period/2]);
+			if (R.median() != median) mismatches++;
+			if (R.percentile(25.) != percentile(v, 25.) || R.percentile(90.) != percentile(v, 90.)) mismatches++;
+			if (R.lowest() != v[0] || R.highest() != v[period-1]) mismatches++;
+			const var probe = x + 0.5;
+			const var rank = 100.*(std::lower_bound(v.begin(), v.end(), probe) - v.begin())/period;
+			if (R.percentRank(probe) != rank) mismatches++;
+		}
+		CHECK(mismatches == 0);
+	}
+}
+
+ZORRO_TEST(spearmanMatchesRankSum)
+{
+	const int periods[] = { 3, 10, 11, 300 };
+	for (int p = 0; p < 4; p++) {
+		z::CSpearman S(periods[p]);
+		SHistory h;
+		var error = 0;
+		for (int t = 0; t < 3000; t++) {
+			const var x = sample(t);
+			h.data.push_back(x);
+			error = (std::max)(error, fabs(S.update(x) - spearman(h, periods[p])));
+		}
+		CHECK_NEAR(error, 0., 1e-12);
+	}
+	// steady trends
+	z::CSpearman Up(20), Down(20);
+	for (int t = 0; t < 50; t++) {
+		Up.update(t);
+		Down.update(-t);
+	}
+	CHECK_NEAR(Up.value(), 1., 1e-15);
+	CHECK_NEAR(Down.value(), -1., 1e-15);
+}
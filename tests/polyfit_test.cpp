@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////
+// Streaming polyfit against a direct least squares solution
+///////////////////////////////////////////////////////
+
+#include "test.h"
+#include "zorro/polyfit.h"
+#include <vector>
+
+namespace
+{
+enum { MaxTerms = z::CPolyFit::MaxOrder + 1 };
+
+// random walk with a slow swing
+struct SWalk
+{
+	unsigned seed;
+	var price;
+
+	SWalk() : seed(1), price(100.) {}
+	var next(int t) {
+		seed = seed*1103515245u + 12345u;
+		price += static_cast<var>((seed >> 8) & 0xFFFF)/0x8000 - 1. + 0.5*sin(t*0.001);
+		return price;
+	}
+};
+
+// weighted least squares in x = bar offset over the history, newest last, preset with the
+// first value like a series; the weight is forget^x, or 1 within 'period' bars without forgetting
+void directFit(const std::vector<var>& history, int order, int period, var forget, var* c)
+{
+	const int m = order + 1;
+	const int n = static_cast<int>(history.size());
+	const int count = forget > 0. ? n : period;
+	long double a[MaxTerms][MaxTerms] = { { 0 } }, b[MaxTerms] = { 0 };
+	for (int x = 0; x < count; x++) {
+		const long double y = history[n - 1 - x >= 0 ? n - 1 - x : 0];
+		const long double w = forget > 0. ? powl(forget, x) : 1.;
+		long double p[MaxTerms];
+		p[0] = 1.;
+		for (int k = 1; k < m; k++) p[k] = p[k-1]*x;
+		for (int i = 0; i < m; i++) {
+			b[i] += w*p[i]*y;
+			for (int j = 0; j < m; j++) a[i][j] += w*p[i]*p[j];
+		}
+	}
+	// Gaussian elimination with partial pivoting
+	for (int i = 0; i < m; i++) {
+		int pivot = i;
+		for (int r = i+1; r < m; r++) if (fabsl(a[r][i]) > fabsl(a[pivot][i])) pivot = r;
+		for (int k = 0; k < m; k++) { long double t = a[i][k]; a[i][k] = a[pivot][k]; a[pivot][k] = t; }
+		long double t = b[i]; b[i] = b[pivot]; b[pivot] = t;
+		for (int r = i+1; r < m; r++) {
+			const long double f = a[r][i]/a[i][i];
+			for (int k = i; k < m; k++) a[r][k] -= f*a[i][k];
+			b[r] -= f*b[i];
+		}
+	}
+	for (int i = m-1; i >= 0; i--) {
+		long double s = b[i];
+		for (int k = i+1; k < m; k++) s -= a[i][k]*c[k];
+		c[i] = static_cast<var>(s/a[i][i]);
+	}
+}
+
+var polynom(const var* c, int order, var x)
+{
+	var y = 0;
+	for (int k = order; k >= 0; k--) y = y*x + c[k];
+	return y;
+}
+
+// largest difference of fitted value and 10 bar forecast over a run
+var fitError(int order, int period, var forget, int bars)
+{
+	z::CPolyFit F(order, period, forget);
+	SWalk walk;
+	std::vector<var> history;
+	var error = 0;
+	for (int t = 0; t < bars; t++) {
+		history.push_back(walk.next(t));
+		const var y = F.update(history.back());
+		if (t % 331 != 0 && t != 5) continue;
+		var c[MaxTerms];
+		directFit(history, order, period, forget, c);
+		error = (std::max)(error, fabs(y - c[0]));
+		error = (std::max)(error, fabs(F.forecast(10) - polynom(c, order, -10.)));
+	}
+	return error;
+}
+} // namespace
+
+ZORRO_TEST(polyFitWindowMatchesLeastSquares)
+{
+	// past several resyncs, and a partly preset window at bar 5
+	CHECK_NEAR(fitError(1, 50, 0., 5000), 0., 1e-8);
+	CHECK_NEAR(fitError(2, 300, 0., 5000), 0., 1e-8);
+	CHECK_NEAR(fitError(3, 1000, 0., 5000), 0., 1e-7);
+}
+
+ZORRO_TEST(polyFitForgettingMatchesLeastSquares)
+{
+	CHECK_NEAR(fitError(1, 0, 0.99, 3000), 0., 1e-8);
+	CHECK_NEAR(fitError(2, 0, 0.995, 3000), 0., 1e-7);
+}
+
+ZORRO_TEST(polyFitRecoversPolynomial)
+{
+	// y = 5 - 0.2x - 0.01x^2 in bar offsets x, x = 0 at the last bar
+	z::CPolyFit F(2, 200);
+	const int bars = 500;
+	for (int t = 0; t < bars; t++) {
+		const var x = bars - 1. - t;
+		F.update(5. - 0.2*x - 0.01*x*x);
+	}
+	CHECK_NEAR(F.coeff(0), 5., 1e-9);
+	CHECK_NEAR(F.coeff(1), -0.2, 1e-10);
+	CHECK_NEAR(F.coeff(2), -0.01, 1e-12);
+	CHECK(F.coeff(3) == 0.);
+	// the forecast 5 + 0.2b - 0.01b^2 peaks 10 bars ahead and falls below 0 after 34.5 bars
+	CHECK(F.predict(EPredictionType::PEAK, 40) == 10);
+	CHECK(F.predict(EPredictionType::PEAK, 40, 2.) == 0);
+	CHECK(F.predict(EPredictionType::VALLEY, 40) == 0);
+	CHECK(F.predict(EPredictionType::CROSSOVER, 40) == 35);
+}
@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////
+// Radix sort against std::sort and std::stable_sort
+///////////////////////////////////////////////////////
+
+#include "test.h"
+#include "zorro/radix_sort.h"
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+// prices with duplicates, negative values, both zeros and infinities mixed in
+std::vector<var> sample(unsigned seed, int n)
+{
+	std::vector<var> x(n);
+	for (int i = 0; i < n; i++) {
+		seed = seed*1103515245u + 12345u;
+		const unsigned r = seed >> 8;
+		switch (r % 16) {
+		case 0: x[i] = 0.; break;
+		case 1: x[i] = -0.; break;
+		case 2: x[i] = r % 32 < 16 ? HUGE_VAL : -HUGE_VAL; break;
+		case 3: x[i] = -static_cast<var>(r % 1000)/8; break;
+		case 4: x[i] = 1e-300*(r % 7); break;
+		default: x[i] = 100. + static_cast<var>(r % 5000)/64; break;
+		}
+	}
+	return x;
+}
+
+bool sameBits(var a, var b)
+{
+	return memcmp(&a, &b, sizeof(var)) == 0;
+}
+
+// std::sort sees -0 and +0 as equal, so only the values are compared; the radix passes
+// must put the negative zeros first
+void checkSort(const std::vector<var>& data, bool parallel)
+{
+	const bool radix = static_cast<int>(data.size()) >= z::radix_detail::RadixThreshold;
+	std::vector<var> x(data), ref(data);
+	z::radixSort(&x[0], static_cast<int>(x.size()), parallel);
+	std::sort(ref.begin(), ref.end());
+	int mismatches = 0;
+	for (size_t i = 0; i < x.size(); i++) {
+		if (x[i] != ref[i]) mismatches++;
+		if (radix && i > 0 && x[i] == 0. && x[i-1] == 0. && signbit(x[i]) && !signbit(x[i-1])) mismatches++;
+	}
+	CHECK(mismatches == 0);
+}
+
+// same order of values as stable_sort, each index once, equal values in original order
+void checkSortIdx(const std::vector<var>& data, bool parallel)
+{
+	const int n = static_cast<int>(data.size());
+	std::vector<int> index(n, -1), ref(n);
+	z::radixSortIdx(&data[0], n, &index[0], parallel);
+	for (int i = 0; i < n; i++) ref[i] = i;
+	std::stable_sort(ref.begin(), ref.end(), [&data](int a, int b) { return data[a] < data[b]; });
+	std::vector<bool> seen(n, false);
+	int mismatches = 0;
+	for (int i = 0; i < n; i++) {
+		if (index[i] < 0 || index[i] >= n || seen[index[i]]) { mismatches++; continue; }
+		seen[index[i]] = true;
+		if (data[index[i]] != data[ref[i]]) mismatches++;
+		// radix keys order -0 before +0, the comparison sorts don't
+		if (i > 0 && sameBits(data[index[i]], data[index[i-1]]) && index[i] < index[i-1]) mismatches++;
+	}
+	CHECK(mismatches == 0);
+}
+} // namespace
+
+ZORRO_TEST(radixSortMatchesStdSort)
+{
+	using namespace z::radix_detail;
+	// around the merge network, the std::sort range and the radix passes
+	const int sizes[] = { 1, 2, 3, 15, NetworkSize, NetworkSize + 1, 100, RadixThreshold - 1, RadixThreshold, 5000, 100000 };
+	for (int s = 0; s < 11; s++) {
+		const std::vector<var> data = sample(s + 1, sizes[s]);
+		checkSort(data, false);
+		checkSortIdx(data, false);
+	}
+	// all equal, so every digit pass is skipped
+	const std::vector<var> flat(3000, 101.25);
+	checkSort(flat, false);
+	checkSortIdx(flat, false);
+}
+
+ZORRO_TEST(radixSortParallelMatchesStdSort)
+{
+	using namespace z::radix_detail;
+	const std::vector<var> data = sample(99, ParallelThreshold + 12345);
+	checkSort(data, true);
+	checkSortIdx(data, true);
+}
+
+ZORRO_TEST(radixSortKeysKeepOrder)
+{
+	using namespace z::radix_detail;
+	const var x[] = { -HUGE_VAL, -1e300, -1., -1e-300, -0., 0., 1e-300, 1., 1e300, HUGE_VAL };
+	for (int i = 0; i < 10; i++) {
+		CHECK(sameBits(fromKey(toKey(x[i])), x[i]));
+		if (i > 0) CHECK(toKey(x[i-1]) < toKey(x[i]));
+	}
+}
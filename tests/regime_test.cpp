@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////
+// Streaming MMI and FractalDimension against a rescan of the whole period
+///////////////////////////////////////////////////////
+
+#include "test.h"
+#include "zorro/regime.h"
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+// history preset with the first value like a series, offset 0 is the newest
+struct SHistory
+{
+	std::vector<var> data;
+
+	inline var operator[](int offset) const {
+		const int k = static_cast<int>(data.size()) - 1 - offset;
+		return k >= 0 ? data[k] : data[0];
+	}
+	var highest(int from, int n) const {
+		var r = (*this)[from];
+		for (int i = from; i < from + n; i++) r = (std::max)(r, (*this)[i]);
+		return r;
+	}
+	var lowest(int from, int n) const {
+		var r = (*this)[from];
+		for (int i = from; i < from + n; i++) r = (std::min)(r, (*this)[i]);
+		return r;
+	}
+};
+
+// price like data in whole steps, so that equal values and equal neighbours occur
+var sample(int t)
+{
+	return floor(100. + 3.*sin(t*0.05) + 0.3*((t*7919) % 13));
+}
+
+var median(const SHistory& h, int period)
+{
+	std::vector<var> v;
+	for (int i = 0; i < period; i++) v.push_back(h[i]);
+	std::sort(v.begin(), v.end());
+	return period & 1 ? v[period/2] : 0.5*(v[period/2-1] + v[period/2]);
+}
+
+// the host's MMI loop
+var mmi(const SHistory& h, int period)
+{
+	const var m = median(h, period);
+	int n = 0;
+	for (int i = 1; i < period; i++) {
+		if (h[i] > m && h[i] > h[i-1]) n++;
+		else if (h[i] < m && h[i] < h[i-1]) n++;
+	}
+	return 100.*n/(period-1);
+}
+
+var fractalDimension(const SHistory& h, int period)
+{
+	period &= ~1;
+	const int half = period/2;
+	const var n1 = (h.highest(0, half) - h.lowest(0, half))/half;
+	const var n2 = (h.highest(half, half) - h.lowest(half, half))/half;
+	const var n3 = (h.highest(0, period) - h.lowest(0, period))/period;
+	if (n1+n2 <= 0. || n3 <= 0.) return 1.;
+	return (log(n1+n2) - log(n3))/log(2.);
+}
+} // namespace
+
+ZORRO_TEST(mmiMatchesRescan)
+{
+	const int periods[] = { 2, 3, 10, 11, 300 };
+	for (int p = 0; p < 5; p++) {
+		z::CMMI M(periods[p]);
+		SHistory h;
+		int mismatches = 0;
+		for (int t = 0; t < 3000; t++) {
+			const var x = sample(t);
+			h.data.push_back(x);
+			if (M.update(x) != mmi(h, periods[p])) mismatches++;
+		}
+		CHECK(mismatches == 0);
+		CHECK(M.median() == median(h, periods[p]));
+	}
+}
+
+ZORRO_TEST(fractalDimensionMatchesRescan)
+{
+	const int periods[] = { 4, 11, 30, 301 };
+	for (int p = 0; p < 4; p++) {
+		z::CFractalDimension F(periods[p]);
+		z::CHurst H(periods[p]);
+		SHistory h;
+		int mismatches = 0;
+		for (int t = 0; t < 3000; t++) {
+			const var x = sample(t);
+			h.data.push_back(x);
+			const var fd = fractalDimension(h, periods[p]);
+			if (F.update(x) != fd) mismatches++;
+			CHECK_NEAR(H.update(x), (std::min)(1., (std::max)(0., 2. - fd)), 0.);
+		}
+		CHECK(mismatches == 0);
+	}
+	// shorter periods are raised to 2
+	z::CFractalDimension F0(0), F1(1);
+	SHistory h;
+	int mismatches = 0;
+	for (int t = 0; t < 200; t++) {
+		const var x = sample(t);
+		h.data.push_back(x);
+		const var fd = fractalDimension(h, 2);
+		if (F0.update(x) != fd || F1.update(x) != fd) mismatches++;
+	}
+	CHECK(mismatches == 0);
+}
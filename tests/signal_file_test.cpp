@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////
+// Signal file writer and reader round trip
+///////////////////////////////////////////////////////
+
+#include "test.h"
+#include "zorro/signal_file.h"
+#include <vector>
+
+namespace
+{
+const char* const FileName = "signal_file_test.zsig";
+const char* const AssetNames[] = { "EUR/USD", "GBP/USD", "SPX500" };
+const char* const AlgoNames[] = { "TRND", "CNTR" };
+enum { NumSignals = 3, BlockRows = 7, Rows = 100 };
+
+var signal(int r, int c) { return 0.25*r - 3.*c + 0.125; }
+
+// rows over several blocks and a partial last block, assets and algos in changing order
+bool writeFile(int rows)
+{
+	z::CSignalWriter W(BlockRows);
+	if (!W.open(FileName, NumSignals)) return false;
+	for (int r = 0; r < rows; r++) {
+		var s[NumSignals];
+		for (int c = 0; c < NumSignals; c++) s[c] = signal(r, c);
+		W.write(AssetNames[r % 3], AlgoNames[r/5 % 2], 40000. + r/24., r % 4 ? 1 : -1, s, NumSignals, r*0.5 - 10.);
+	}
+	return W.close();
+}
+} // namespace
+
+ZORRO_TEST(signalFileRoundTrip)
+{
+	CHECK(writeFile(Rows));
+	z::CSignalReader R;
+	CHECK(R.open(FileName));
+	CHECK(R.rows() == Rows && R.numSignals() == NumSignals);
+	CHECK(R.blocks() == (Rows + BlockRows - 1)/BlockRows);
+	CHECK(R.assets() == 3 && R.algos() == 2);
+	for (int i = 0; i < 3; i++) CHECK(strcmp(R.assetName(i), AssetNames[i]) == 0);
+	for (int i = 0; i < 2; i++) CHECK(strcmp(R.algoName(i), AlgoNames[i]) == 0);
+	CHECK(strcmp(R.assetName(3), "") == 0 && strcmp(R.algoName(-1), "") == 0);
+
+	int r = 0, mismatches = 0;
+	for (int b = 0; b < R.blocks(); b++) {
+		const z::CSignalReader::SBlockView& v = R.block(b);
+		// every column is aligned for memory mapped access
+		if (reinterpret_cast<size_t>(v.time) % z::CSignalWriter::Align != 0) mismatches++;
+		for (int i = 0; i < v.rows; i++, r++) {
+			if (v.time[i] != 40000. + r/24. || v.side[i] != (r % 4 ? 1 : -1)) mismatches++;
+			if (v.asset[i] != r % 3 || v.algo[i] != r/5 % 2) mismatches++;
+			for (int c = 0; c < NumSignals; c++)
+				if (v.signals[c][i] != static_cast<float>(signal(r, c))) mismatches++;
+			if (v.objective[i] != static_cast<float>(r*0.5 - 10.)) mismatches++;
+		}
+	}
+	CHECK(r == Rows && mismatches == 0);
+
+	// DATASET records: time in the first two fields, then ids, side, signals and objective
+	const int fields = R.datasetFields();
+	CHECK(fields == 5 + NumSignals + 1);
+	std::vector<float> data(Rows*fields);
+	R.fillDataset(&data[0]);
+	for (r = 0; r < Rows; r++) {
+		const float* record = &data[r*fields];
+		DATE time;
+		memcpy(&time, record, sizeof(DATE));
+		if (time != 40000. + r/24. || record[2] != r % 3 || record[3] != r/5 % 2 || record[4] != (r % 4 ? 1 : -1)) mismatches++;
+		if (record[5 + 1] != static_cast<float>(signal(r, 1)) || record[5 + NumSignals] != static_cast<float>(r*0.5 - 10.)) mismatches++;
+	}
+	CHECK(mismatches == 0);
+	R.close();
+	remove(FileName);
+}
+
+ZORRO_TEST(signalFileRejectsDamage)
+{
+	// empty file with header and trailer only
+	CHECK(writeFile(0));
+	z::CSignalReader R;
+	CHECK(R.open(FileName) && R.rows() == 0 && R.blocks() == 0);
+	R.close();
+
+	// a trailer row count that does not match the blocks
+	CHECK(writeFile(20));
+	FILE* f = fopen(FileName, "r+b");
+	CHECK(f != 0);
+	if (f) {
+		fseek(f, -static_cast<long>(sizeof(z::CSignalWriter::STrailer)) + 8, SEEK_END);
+		const long long rows = 99;
+		fwrite(&rows, sizeof(rows), 1, f);
+		fclose(f);
+	}
+	CHECK(!R.open(FileName));
+	CHECK(R.rows() == 0 && R.blocks() == 0);
+	CHECK(!R.open("signal_file_test_missing.zsig"));
+	remove(FileName);
+}
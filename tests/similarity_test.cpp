@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////
+// Pruned similarity search against a scan of every window
+///////////////////////////////////////////////////////
+
+#include "test.h"
+#include "zorro/similarity.h"
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+enum { Bars = 24, K = 10 };
+
+// random walks with a few repeated stretches, so that close matches exist
+std::vector<var> history(unsigned seed, int length)
+{
+	std::vector<var> x(length);
+	var price = 100.;
+	for (int i = 0; i < length; i++) {
+		seed = seed*1103515245u + 12345u;
+		price += static_cast<var>((seed >> 8) & 0xFFFF)/0x8000 - 1.;
+		x[i] = i >= 1000 && i < 1100 ? x[i - 700] + 5. : price;
+	}
+	return x;
+}
+
+void normalize(const var* x, int m, var* out)
+{
+	var mean = 0, dev = 0;
+	for (int i = 0; i < m; i++) mean += x[i];
+	mean /= m;
+	for (int i = 0; i < m; i++) dev += (x[i]-mean)*(x[i]-mean);
+	dev = dev > 0 ? sqrt(dev/m) : 1.;
+	for (int i = 0; i < m; i++) out[i] = (x[i]-mean)/dev;
+}
+
+// full dynamic programming table within the band
+var bandedDistance(const var* q, const var* c, int m, int band, bool frechet)
+{
+	const var INF = 1e300;
+	std::vector<var> d((m+1)*(m+1), INF);
+	d[0] = 0;
+	for (int i = 1; i <= m; i++)
+		for (int j = 1; j <= m; j++) {
+			if (j < i - band || j > i + band) continue;
+			const var cost = (q[i-1]-c[j-1])*(q[i-1]-c[j-1]);
+			const var best = (std::min)(d[(i-1)*(m+1) + j-1], (std::min)(d[(i-1)*(m+1) + j], d[i*(m+1) + j-1]));
+			d[i*(m+1) + j] = frechet ? (std::max)(cost, best) : cost + best;
+		}
+	return sqrt(d[m*(m+1) + m]);
+}
+
+var windowDistance(const std::vector<std::vector<var> >& series, const var* pattern, const z::SSimilarityMatch& match, int band, bool frechet)
+{
+	var q[Bars], c[Bars];
+	normalize(pattern, Bars, q);
+	normalize(&series[match.series][match.start], Bars, c);
+	return bandedDistance(q, c, Bars, band, frechet);
+}
+
+// same distances, and every window only once; windows at equal distances may come in any order
+void checkMatches(const std::vector<std::vector<var> >& series, const var* pattern, int band, bool frechet,
+	const z::SSimilarityMatch* found, const z::SSimilarityMatch* expected, int n)
+{
+	for (int i = 0; i < n; i++) {
+		CHECK_NEAR(found[i].distance, expected[i].distance, 1e-9);
+		CHECK_NEAR(windowDistance(series, pattern, found[i], band, frechet), found[i].distance, 1e-9);
+		for (int j = 0; j < i; j++) CHECK(found[i].series != found[j].series || found[i].start != found[j].start);
+	}
+}
+
+bool less(const z::SSimilarityMatch& a, const z::SSimilarityMatch& b)
+{
+	if (a.distance != b.distance) return a.distance < b.distance;
+	if (a.series != b.series) return a.series < b.series;
+	return a.start < b.start;
+}
+
+// k nearest windows by scanning all of them
+int scanAll(const std::vector<std::vector<var> >& series, const var* pattern, int band, bool frechet, z::SSimilarityMatch* out)
+{
+	std::vector<var> q(Bars), c(Bars);
+	normalize(pattern, Bars, &q[0]);
+	std::vector<z::SSimilarityMatch> all;
+	for (size_t s = 0; s < series.size(); s++)
+		for (int w = 0; w + Bars <= static_cast<int>(series[s].size()); w++) {
+			normalize(&series[s][w], Bars, &c[0]);
+			z::SSimilarityMatch match = { static_cast<int>(s), w, bandedDistance(&q[0], &c[0], Bars, band, frechet) };
+			all.push_back(match);
+		}
+	std::sort(all.begin(), all.end(), less);
+	const int n = (std::min)(static_cast<int>(all.size()), static_cast<int>(K));
+	for (int i = 0; i < n; i++) out[i] = all[i];
+	return n;
+}
+
+void checkSearch(z::CSimilaritySearch::EMetric metric)
+{
+	std::vector<std::vector<var> > series;
+	series.push_back(history(1, 3000));
+	series.push_back(history(2, 10000));   // more than one chunk of windows
+	series.push_back(history(3, 500));
+	const bool frechet = metric == z::CSimilaritySearch::FRECHET;
+	z::CSimilaritySearch S(metric);
+	for (size_t s = 0; s < series.size(); s++) S.add(&series[s][0], static_cast<int>(series[s].size()), false);
+
+	const var* patterns[] = { &series[0][310], &series[1][5000] };
+	const int bands[] = { 0, 2, 5 };
+	for (int p = 0; p < 2; p++)
+		for (int b = 0; b < 3; b++) {
+			z::SSimilarityMatch found[K], expected[K];
+			const int n = S.search(patterns[p], Bars, K, bands[b], found);
+			CHECK(n == scanAll(series, patterns[p], bands[b], frechet, expected));
+			checkMatches(series, patterns[p], bands[b], frechet, found, expected, n);
+			for (int i = 0; i < n; i++)
+				CHECK_NEAR(S.distance(patterns[p], Bars, bands[b], found[i].series, found[i].start), found[i].distance, 1e-9);
+		}
+
+	// appended bars extend the envelopes
+	for (int i = 0; i < 40; i++) {
+		const var x = series[0][2000 + i];
+		series[2].push_back(x);
+		S.append(2, x);
+	}
+	z::SSimilarityMatch found[K], expected[K];
+	const int n = S.search(&series[0][2010], Bars, K, 2, found);
+	CHECK(n == scanAll(series, &series[0][2010], 2, frechet, expected));
+	checkMatches(series, &series[0][2010], 2, frechet, found, expected, n);
+	// the copy in the appended bars is an exact match
+	CHECK(found[0].distance < 1e-6 && found[1].distance < 1e-6);
+}
+} // namespace
+
+ZORRO_TEST(similarityDtwMatchesFullScan)
+{
+	checkSearch(z::CSimilaritySearch::DTW);
+}
+
+ZORRO_TEST(similarityFrechetMatchesFullScan)
+{
+	checkSearch(z::CSimilaritySearch::FRECHET);
+}
@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////
+// Sliding DFT and FFT against a direct DFT of the window
+///////////////////////////////////////////////////////
+
+#include "test.h"
+#include "zorro/spectrum.h"
+#include <vector>
+
+namespace
+{
+// trend, a 23.4 bar cycle and a fast disturbance
+var sample(int t)
+{
+	return 100. + 0.01*t + 2.*cos(2*PI*t/23.4 + 0.3) + 0.3*sin(t*0.7);
+}
+
+// DFT bin of the mean-free window, newest value first like CSpectrum
+void directBin(const std::vector<var>& data, int samplePeriod, var period, var& re, var& im)
+{
+	const int last = static_cast<int>(data.size()) - 1;
+	var mean = 0;
+	for (int j = 0; j < samplePeriod; j++) mean += data[last - j];
+	mean /= samplePeriod;
+	re = im = 0;
+	const var w = 2*PI/period;
+	for (int j = 0; j < samplePeriod; j++) {
+		re += (data[last - j] - mean)*cos(w*j);
+		im -= (data[last - j] - mean)*sin(w*j);
+	}
+}
+} // namespace
+
+ZORRO_TEST(slidingDftMatchesDirectDft)
+{
+	const var periods[] = { 6., 10., 17.5, 23.4, 40. };
+	const int samplePeriod = 100;
+	// without resync the sliding update has to stay exact on its own
+	z::CSpectrum S(periods, 5, samplePeriod, 100000), R(periods, 5, samplePeriod, 4);
+	std::vector<var> data;
+	var error = 0, phaseError = 0;
+	for (int t = 0; t < 20000; t++) {
+		data.push_back(sample(t));
+		S.update(data.back());
+		R.update(data.back());
+		if (t < samplePeriod || t % 97 != 0) continue;
+		for (int k = 0; k < 5; k++) {
+			var re, im;
+			directBin(data, samplePeriod, periods[k], re, im);
+			const var amplitude = 2.*sqrt(re*re + im*im)/samplePeriod;
+			error = (std::max)(error, fabs(S.amplitude(k) - amplitude));
+			error = (std::max)(error, fabs(R.amplitude(k) - amplitude));
+			var phase = -atan2(im, re);
+			if (phase < 0) phase += 2*PI;
+			var d = fabs(S.phase(k) - phase);
+			phaseError = (std::max)(phaseError, (std::min)(d, 2*PI - d));
+		}
+	}
+	CHECK_NEAR(error, 0., 1e-9);
+	CHECK_NEAR(phaseError, 0., 1e-9);
+	// the cycle is found at its period and phase
+	CHECK_NEAR(S.dominantPeriod(), 23.4, 0.5);
+	var d = fabs(S.dominantPhase() - fmod(2*PI*19999/23.4 + 0.3, 2*PI));
+	CHECK((std::min)(d, 2*PI - d) < 0.2);
+}
+
+ZORRO_TEST(spectrumHistoryMatchesStreaming)
+{
+	const var periods[] = { 10., 23.4, 40. };
+	const int length = 3000, samplePeriod = 60;
+	std::vector<var> data(length), out(3*length);
+	for (int t = 0; t < length; t++) data[t] = sample(t);
+	z::spectrumHistory(&data[0], length, periods, 3, samplePeriod, &out[0]);
+	z::CSpectrum S(periods, 3, samplePeriod);
+	var error = 0;
+	for (int t = 0; t < length; t++) {
+		S.update(data[t]);
+		for (int k = 0; k < 3; k++) error = (std::max)(error, fabs(out[t*3 + k] - S.amplitude(k)));
+	}
+	CHECK_NEAR(error, 0., 1e-9);
+}
+
+ZORRO_TEST(fftMatchesDirectDft)
+{
+	const int sizes[] = { 1, 2, 8, 64, 1024 };
+	for (int s = 0; s < 5; s++) {
+		const int n = sizes[s];
+		std::vector<var> re(n), im(n), x(n), y(n);
+		for (int j = 0; j < n; j++) {
+			x[j] = re[j] = sin(j*0.3) + j % 5;
+			y[j] = im[j] = cos(j*0.11);
+		}
+		z::fft(&re[0], &im[0], n);
+		var error = 0;
+		for (int k = 0; k < n; k++) {
+			var a = 0, b = 0;
+			for (int j = 0; j < n; j++) {
+				const var w = 2*PI*k*j/n;
+				a += x[j]*cos(w) + y[j]*sin(w);
+				b += y[j]*cos(w) - x[j]*sin(w);
+			}
+			error = (std::max)(error, fabs(re[k] - a) + fabs(im[k] - b));
+		}
+		CHECK_NEAR(error, 0., 1e-9*n);
+		// the inverse transform scales back
+		z::fft(&re[0], &im[0], n, true);
+		error = 0;
+		for (int j = 0; j < n; j++) error = (std::max)(error, fabs(re[j] - x[j]) + fabs(im[j] - y[j]));
+		CHECK_NEAR(error, 0., 1e-12*n);
+	}
+}
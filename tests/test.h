@@ -0,0 +1,84 @@
+
+#ifndef ZORRO_TESTS_TEST_H_
+#define ZORRO_TESTS_TEST_H_
+
+#include "zorro.h"
+#include <stdio.h>
+#include <math.h>
+
+///////////////////////////////////////////////////////
+// Minimal test registry for the native z:: components.
+// Every ZORRO_TEST registers itself; tests/main.cpp runs them with a zeroed GLOBALS struct and
+// without host functions, so tests must stay on the native code paths.
+//
+//   ZORRO_TEST(medianMatchesSort) {
+//     CHECK(x == y);
+//     CHECK_NEAR(a, b, 1e-12);
+//   }
+namespace z
+{
+namespace test
+{
+typedef void (*TFunction)();
+
+struct STest
+{
+	const char* name;
+	TFunction function;
+	STest* next;
+};
+
+inline STest*& first()
+{
+	static STest* s_first = 0;
+	return s_first;
+}
+
+inline int& failures()
+{
+	static int s_failures = 0;
+	return s_failures;
+}
+
+class CRegistrar
+{
+public:
+	explicit CRegistrar(STest& test) {
+		STest** p = &first();
+		while (*p) p = &(*p)->next;
+		*p = &test;
+	}
+};
+
+inline bool check(bool ok, const char* expression, const char* file, int line)
+{
+	if (!ok) {
+		failures()++;
+		printf("\n%s(%d): failed: %s", file, line, expression);
+	}
+	return ok;
+}
+
+inline bool checkNear(var a, var b, var tolerance, const char* ea, const char* eb, const char* file, int line)
+{
+	// NaN never passes
+	const bool ok = fabs(a - b) <= tolerance;
+	if (!ok) {
+		failures()++;
+		printf("\n%s(%d): failed: %s = %.17g, %s = %.17g, tolerance %g", file, line, ea, a, eb, b, tolerance);
+	}
+	return ok;
+}
+} // namespace test
+} // namespace z
+
+#define ZORRO_TEST(name) \
+	static void name(); \
+	static ::z::test::STest name##Test = { #name, name, 0 }; \
+	static ::z::test::CRegistrar name##Registrar(name##Test); \
+	static void name()
+
+#define CHECK(condition) ::z::test::check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tolerance) ::z::test::checkNear((a), (b), (tolerance), #a, #b, __FILE__, __LINE__)
+
+#endif // ZORRO_TESTS_TEST_H_